@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <dectris/neggia/data/H5Path.h>
+#include <dectris/neggia/data/H5Superblock.h>
+#include <dectris/neggia/user/H5File.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <string>
+
+namespace {
+
+std::atomic<size_t> numberOfAllocations(0);
+
+/// Resolves path repeatedly and prints the time and the number of
+/// allocations per resolve
+void measureResolve(const char* name, H5Superblock& root, const H5Path& path) {
+    constexpr size_t N_RESOLVES = 10000;
+    size_t allocationsBefore = numberOfAllocations;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < N_RESOLVES; ++i)
+        root.resolve(path);
+    auto end = std::chrono::steady_clock::now();
+    size_t allocations = numberOfAllocations - allocationsBefore;
+    std::cout << std::string(path) << " (" << name << "): "
+              << std::chrono::duration<double, std::nano>(end - start)
+                                 .count() /
+                         N_RESOLVES
+              << " ns, " << (double)allocations / N_RESOLVES
+              << " allocations per resolve\n";
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    ++numberOfAllocations;
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " file.h5 path...\n"
+                  << "Measures how long resolving the paths takes, with and "
+                     "without the metadata cache\n";
+        return -1;
+    }
+    try {
+        H5File h5File(argv[1]);
+        for (int i = 2; i < argc; ++i) {
+            H5Path path(argv[i]);
+            H5Superblock uncachedRoot(h5File.fileAddress());
+            measureResolve("uncached", uncachedRoot, path);
+            H5Superblock root(h5File.fileAddress(), h5File.metadataCache());
+            root.resolve(path);
+            measureResolve("cached", root, path);
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return -1;
+    }
+    return 0;
+}
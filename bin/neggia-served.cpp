@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/plugin/FrameServerConnection.h>
+#include <dectris/neggia/plugin/PluginConfig.h>
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/FrameRange.h>
+#include <dectris/neggia/user/FrameScheduler.h>
+#include <dectris/neggia/user/H5File.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+volatile sig_atomic_t STOP_REQUESTED = 0;
+
+void requestStop(int) {
+    STOP_REQUESTED = 1;
+}
+
+/// A master file and the datasets of its data files, shared by all clients
+/// that have opened it
+struct ServedFile {
+    /// identifies the file to the scheduler
+    size_t id;
+    H5File masterFile;
+    std::vector<Dataset> datasets;
+    /// the number of the first frame of each dataset
+    std::vector<size_t> firstFrames;
+    FrameServerConnection::Header header;
+};
+
+/// The files opened by the clients. A file is opened once by the first
+/// client asking for it and closed once the last one has disconnected.
+class ServedFiles {
+public:
+    explicit ServedFiles(Dataset::PageCachePolicy pageCachePolicy)
+          : _pageCachePolicy(pageCachePolicy), _nextId(0) {}
+
+    /// Throws std::exception if filename is not a master file whose frames
+    /// can be served
+    std::shared_ptr<const ServedFile> open(const std::string& filename) {
+        // clients opening another file at the same time wait, opening is
+        // short compared to reading the frames
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto file = _files[filename].lock();
+        if (!file) {
+            file = openFile(filename, getId(filename));
+            _files[filename] = file;
+        }
+        return file;
+    }
+
+private:
+    struct Identity {
+        dev_t device;
+        ino_t inode;
+        time_t modificationTime;
+        size_t id;
+    };
+
+    /// A master file opened again keeps its id unless it has changed, so
+    /// that the frames kept from earlier clients are served again
+    size_t getId(const std::string& filename) {
+        struct stat fileStatus;
+        if (stat(filename.c_str(), &fileStatus) != 0)
+            return _nextId++;
+        auto identity = _identities.find(filename);
+        if (identity == _identities.end() ||
+            identity->second.device != fileStatus.st_dev ||
+            identity->second.inode != fileStatus.st_ino ||
+            identity->second.modificationTime != fileStatus.st_mtime)
+        {
+            _identities[filename] =
+                    Identity{fileStatus.st_dev, fileStatus.st_ino,
+                             fileStatus.st_mtime, _nextId++};
+        }
+        return _identities[filename].id;
+    }
+
+    std::shared_ptr<const ServedFile> openFile(const std::string& filename,
+                                               size_t id) const {
+        std::shared_ptr<ServedFile> file(new ServedFile());
+        file->id = id;
+        file->masterFile = H5File(filename);
+        // clients may ask for any file, the reader expects HDF5 files
+        if (file->masterFile.fileSize() < 8 ||
+            std::string(file->masterFile.fileAddress(), 8) !=
+                    "\211HDF\r\n\032\n")
+        {
+            throw std::runtime_error(filename + " is not an HDF5 file");
+        }
+        file->datasets = openDataFiles(file->masterFile);
+        const Dataset& first = file->datasets.front();
+        auto frameShape = first.dim();
+        uint64_t numberOfFrames = 0;
+        for (auto& dataset : file->datasets) {
+            auto dim = dataset.dim();
+            if (dim.size() != 3 || dataset.dataTypeId() != 0 ||
+                !dataset.isChunkedByFrame() || dim[1] != frameShape[1] ||
+                dim[2] != frameShape[2] ||
+                dataset.dataSize() != first.dataSize() ||
+                dataset.isSigned() != first.isSigned())
+            {
+                throw std::runtime_error("data files of " + filename +
+                                         " are not integer frames of the "
+                                         "same shape and type");
+            }
+            dataset.setPageCachePolicy(_pageCachePolicy);
+            dataset.indexChunks();
+            file->firstFrames.push_back(numberOfFrames);
+            numberOfFrames += dim[0];
+        }
+        file->header.nx = frameShape[2];
+        file->header.ny = frameShape[1];
+        file->header.dataSize = first.dataSize();
+        file->header.isSigned = first.isSigned();
+        file->header.numberOfFrames = numberOfFrames;
+        return file;
+    }
+
+    const Dataset::PageCachePolicy _pageCachePolicy;
+    std::mutex _mutex;
+    std::map<std::string, std::weak_ptr<const ServedFile>> _files;
+    std::map<std::string, Identity> _identities;
+    size_t _nextId;
+};
+
+struct Client {
+    std::unique_ptr<FrameServerConnection> connection;
+    std::thread thread;
+    std::atomic<bool> done{false};
+};
+
+std::string canonicalPath(const std::string& path) {
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+}
+
+size_t getFrameBytes(const FrameServerConnection::Header& header) {
+    return (size_t)header.nx * header.ny * header.dataSize;
+}
+
+/// Creates an anonymous shared memory buffer of size bytes, mapped at frame
+int createFrameBuffer(size_t size, char*& frame) {
+    static std::atomic<uint64_t> counter(0);
+    std::string name = "/neggia-served-" + std::to_string(getpid()) + "-" +
+                       std::to_string(++counter);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        throw std::runtime_error("cannot create shared memory " + name);
+    shm_unlink(name.c_str());
+    void* address = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        address =
+                mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (address == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("cannot map shared memory " + name);
+    }
+    frame = (char*)address;
+    return fd;
+}
+
+/// Returns CANNOT_READ if the frame does not exist or cannot be read
+FrameServerConnection::Status readFrame(const ServedFile& file,
+                                        uint64_t frameNumber,
+                                        char* frame,
+                                        FrameScheduler& scheduler) {
+    if (frameNumber >= file.header.numberOfFrames)
+        return FrameServerConnection::CANNOT_READ;
+    size_t datasetNumber = std::upper_bound(file.firstFrames.begin(),
+                                            file.firstFrames.end(),
+                                            frameNumber) -
+                           file.firstFrames.begin() - 1;
+    const Dataset& dataset = file.datasets[datasetNumber];
+    std::vector<size_t> chunkOffset(
+            {frameNumber - file.firstFrames[datasetNumber], 0, 0});
+    try {
+        scheduler.read(file.id, frameNumber, getFrameBytes(file.header),
+                       frame, [&dataset, &chunkOffset](void* data) {
+                           dataset.read(data, chunkOffset);
+                       });
+    } catch (const std::exception& error) {
+        std::cerr << "neggia-served: cannot read frame " << frameNumber
+                  << ", " << error.what() << "\n";
+        return FrameServerConnection::CANNOT_READ;
+    }
+    return FrameServerConnection::OK;
+}
+
+/// Reads the frames the client asks for into the buffer shared with it
+void serveClient(FrameServerConnection& connection,
+                 ServedFiles& servedFiles,
+                 FrameScheduler& scheduler) {
+    std::shared_ptr<const ServedFile> file;
+    char* frame = nullptr;
+    try {
+        FrameServerConnection::Request request;
+        std::string filename;
+        while (connection.receiveRequest(request, filename)) {
+            FrameServerConnection::Response response =
+                    FrameServerConnection::Response();
+            response.status = FrameServerConnection::INVALID_REQUEST;
+            if (request.protocolVersion !=
+                FrameServerConnection::PROTOCOL_VERSION)
+            {
+                connection.sendResponse(response);
+                break;
+            }
+            if (request.type == FrameServerConnection::OPEN && !file) {
+                try {
+                    file = servedFiles.open(canonicalPath(filename));
+                } catch (const std::exception& error) {
+                    std::cerr << "neggia-served: cannot serve " << filename
+                              << ", " << error.what() << "\n";
+                    response.status = FrameServerConnection::CANNOT_OPEN;
+                    connection.sendResponse(response);
+                    continue;
+                }
+                int fd = createFrameBuffer(getFrameBytes(file->header),
+                                           frame);
+                response.status = FrameServerConnection::OK;
+                response.header = file->header;
+                connection.sendResponse(response, fd);
+                close(fd);
+            } else if (request.type == FrameServerConnection::READ && file) {
+                response.status = readFrame(*file, request.frameNumber,
+                                            frame, scheduler);
+                connection.sendResponse(response);
+            } else {
+                connection.sendResponse(response);
+            }
+        }
+    } catch (const std::runtime_error& error) {
+        std::cerr << "neggia-served: client disconnected, " << error.what()
+                  << "\n";
+    }
+    if (frame)
+        munmap(frame, getFrameBytes(file->header));
+}
+
+int listenOn(const std::string& socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + socketPath);
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    // a socket left behind by a server that has been killed
+    struct stat socketStatus;
+    if (stat(socketPath.c_str(), &socketStatus) == 0 &&
+        S_ISSOCK(socketStatus.st_mode))
+    {
+        unlink(socketPath.c_str());
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("cannot create socket");
+    mode_t previousMask = umask(0077);
+    bool bound = bind(fd, (const struct sockaddr*)&address,
+                      sizeof(address)) == 0;
+    umask(previousMask);
+    if (!bound || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot listen on " + socketPath);
+    }
+    return fd;
+}
+
+/// Joins the threads of clients that have disconnected
+void reapClients(std::list<Client>& clients) {
+    for (auto client = clients.begin(); client != clients.end();) {
+        if (client->done) {
+            client->thread.join();
+            client = clients.erase(client);
+        } else {
+            ++client;
+        }
+    }
+}
+
+void serve(int listeningSocket,
+           ServedFiles& servedFiles,
+           FrameScheduler& scheduler) {
+    std::list<Client> clients;
+    while (!STOP_REQUESTED) {
+        struct pollfd request = {listeningSocket, POLLIN, 0};
+        reapClients(clients);
+        if (poll(&request, 1, 200) <= 0)
+            continue;
+        int fd = accept(listeningSocket, NULL, NULL);
+        if (fd < 0)
+            continue;
+        clients.emplace_back();
+        Client& client = clients.back();
+        client.connection.reset(new FrameServerConnection(fd));
+        client.thread = std::thread([&client, &servedFiles, &scheduler]() {
+            serveClient(*client.connection, servedFiles, scheduler);
+            client.done = true;
+        });
+    }
+    for (auto& client : clients)
+        client.connection->shutdown();
+    for (auto& client : clients)
+        client.thread.join();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: neggia-served <socket> [<master file>...]\n\n"
+                     "Serves the frames of the master files local clients "
+                     "open, e.g. the XDS plugin,\nto all clients that "
+                     "connect to the socket. Set NEGGIA_SERVER to the "
+                     "socket to\nmake the plugin read from the server. The "
+                     "master files given are opened at\nonce and kept "
+                     "open, others are opened when a client asks for "
+                     "them.\n";
+        return -1;
+    }
+    std::string socketPath = argv[1];
+    // frames asked for by several clients are read only once
+    setenv("NEGGIA_FRAME_CACHE", "1G", 0);
+    PluginConfig config = PluginConfig::fromEnvironment();
+    ServedFiles servedFiles(config.dropConsumedPages
+                                    ? Dataset::DROP_CONSUMED_PAGES
+                                    : Dataset::KEEP_PAGES);
+    std::vector<std::shared_ptr<const ServedFile>> keptOpen;
+    for (int i = 2; i < argc; ++i) {
+        try {
+            keptOpen.push_back(servedFiles.open(canonicalPath(argv[i])));
+        } catch (const std::exception& error) {
+            std::cerr << "neggia-served: cannot serve " << argv[i] << ", "
+                      << error.what() << "\n";
+            return -1;
+        }
+    }
+    FrameScheduler scheduler(config.frameCacheBudget);
+
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    signal(SIGPIPE, SIG_IGN);
+    int listeningSocket;
+    try {
+        listeningSocket = listenOn(socketPath);
+    } catch (const std::runtime_error& error) {
+        std::cerr << "neggia-served: " << error.what() << "\n";
+        return -1;
+    }
+    std::cerr << "neggia-served: serving on " << socketPath << "\n";
+    serve(listeningSocket, servedFiles, scheduler);
+    close(listeningSocket);
+    unlink(socketPath.c_str());
+    FrameScheduler::Statistics statistics = scheduler.statistics();
+    std::cerr << "neggia-served: " << statistics.requests
+              << " frames requested, " << statistics.reads << " read, "
+              << statistics.hits << " served from memory\n";
+    return 0;
+}
@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: MIT
+
+#include "neggia.h"
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/H5File.h>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct neggia_file {
+    H5File h5File;
+};
+
+struct neggia_dataset {
+    Dataset dataset;
+    neggia_type_class typeClass;
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+class ApiError : public std::runtime_error {
+public:
+    ApiError(neggia_status status, const std::string& message)
+          : std::runtime_error(message), _status(status) {}
+    neggia_status status() const { return _status; }
+
+private:
+    neggia_status _status;
+};
+
+neggia_status fail(neggia_status status, const std::string& message) {
+    lastError = message;
+    return status;
+}
+
+/// Runs function and turns the exceptions it throws into a status.
+/// std::out_of_range is reported as statusOfOutOfRange, because it means
+/// "not found" when opening and "cannot read" when reading.
+template <class FUNCTION>
+neggia_status guard(neggia_status statusOfOutOfRange, FUNCTION function) {
+    try {
+        function();
+        return NEGGIA_OK;
+    } catch (const ApiError& error) {
+        return fail(error.status(), error.what());
+    } catch (const std::out_of_range& exc) {
+        return fail(statusOfOutOfRange, exc.what());
+    } catch (const std::bad_alloc&) {
+        return fail(NEGGIA_ERROR_READ, "out of memory");
+    } catch (const std::exception& exc) {
+        return fail(NEGGIA_ERROR_READ, exc.what());
+    } catch (...) {
+        return fail(NEGGIA_ERROR_READ, "unknown error");
+    }
+}
+
+void checkArgument(const void* pointer, const char* name) {
+    if (!pointer)
+        throw ApiError(NEGGIA_ERROR_INVALID_ARGUMENT,
+                       std::string(name) + " is NULL");
+}
+
+neggia_type_class getTypeClass(const Dataset& dataset) {
+    switch (dataset.dataTypeId()) {
+        case 0:
+            return dataset.isSigned() ? NEGGIA_TYPE_INT : NEGGIA_TYPE_UINT;
+        case 1:
+            return NEGGIA_TYPE_FLOAT;
+        case 3:
+            return NEGGIA_TYPE_STRING;
+        default:
+            throw ApiError(NEGGIA_ERROR_UNSUPPORTED,
+                           "datatype class " +
+                                   std::to_string(dataset.dataTypeId()) +
+                                   " not supported");
+    }
+}
+
+size_t getFrameSize(const Dataset& dataset) {
+    auto dim = dataset.dim();
+    size_t size = dataset.dataSize();
+    for (size_t i = 1; i < dim.size(); ++i)
+        size *= dim[i];
+    return size;
+}
+
+size_t getSize(const Dataset& dataset) {
+    auto dim = dataset.dim();
+    return dim.empty() ? getFrameSize(dataset) : getFrameSize(dataset) * dim[0];
+}
+
+void checkSize(size_t size, size_t expectedSize) {
+    if (size != expectedSize) {
+        throw ApiError(NEGGIA_ERROR_INVALID_ARGUMENT,
+                       "buffer of " + std::to_string(size) +
+                               " bytes, expected " +
+                               std::to_string(expectedSize));
+    }
+}
+
+}  // namespace
+
+int neggia_api_version(void) {
+    return NEGGIA_API_VERSION;
+}
+
+const char* neggia_version(void) {
+    return VERSION;
+}
+
+const char* neggia_last_error(void) {
+    return lastError.c_str();
+}
+
+neggia_status neggia_file_open(const char* path, neggia_file** file) {
+    return guard(NEGGIA_ERROR_NOT_FOUND, [&] {
+        checkArgument(file, "file");
+        *file = nullptr;
+        checkArgument(path, "path");
+        *file = new neggia_file{H5File(path)};
+    });
+}
+
+void neggia_file_close(neggia_file* file) {
+    delete file;
+}
+
+neggia_status neggia_dataset_open(const neggia_file* file,
+                                  const char* path,
+                                  neggia_dataset** dataset) {
+    return guard(NEGGIA_ERROR_NOT_FOUND, [&] {
+        checkArgument(dataset, "dataset");
+        *dataset = nullptr;
+        checkArgument(file, "file");
+        checkArgument(path, "path");
+        Dataset opened(file->h5File, path);
+        neggia_type_class typeClass = getTypeClass(opened);
+        opened.indexChunks();
+        *dataset = new neggia_dataset{opened, typeClass};
+    });
+}
+
+void neggia_dataset_close(neggia_dataset* dataset) {
+    delete dataset;
+}
+
+neggia_status neggia_dataset_type(const neggia_dataset* dataset,
+                                  neggia_type_class* type_class,
+                                  size_t* element_size) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        if (type_class)
+            *type_class = dataset->typeClass;
+        if (element_size)
+            *element_size = dataset->dataset.dataSize();
+    });
+}
+
+neggia_status neggia_dataset_rank(const neggia_dataset* dataset,
+                                  size_t* rank) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        checkArgument(rank, "rank");
+        *rank = dataset->dataset.dim().size();
+    });
+}
+
+neggia_status neggia_dataset_dims(const neggia_dataset* dataset,
+                                  size_t* dims,
+                                  size_t rank) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        auto dim = dataset->dataset.dim();
+        if (rank != dim.size()) {
+            throw ApiError(NEGGIA_ERROR_INVALID_ARGUMENT,
+                           "rank " + std::to_string(rank) + ", expected " +
+                                   std::to_string(dim.size()));
+        }
+        if (rank > 0)
+            checkArgument(dims, "dims");
+        std::copy(dim.begin(), dim.end(), dims);
+    });
+}
+
+neggia_status neggia_dataset_size(const neggia_dataset* dataset,
+                                  size_t* size,
+                                  size_t* frame_size) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        if (size)
+            *size = getSize(dataset->dataset);
+        if (frame_size)
+            *frame_size = getFrameSize(dataset->dataset);
+    });
+}
+
+neggia_status neggia_dataset_read(const neggia_dataset* dataset,
+                                  void* data,
+                                  size_t size) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        const Dataset& source = dataset->dataset;
+        checkSize(size, getSize(source));
+        if (size == 0)
+            return;
+        checkArgument(data, "data");
+        if (source.isChunkedByFrame()) {
+            source.readFrames(0, source.dim()[0], data);
+        } else if (!source.isChunked()) {
+            source.read(data);
+        } else {
+            throw ApiError(NEGGIA_ERROR_UNSUPPORTED,
+                           "chunks of more than one frame not supported");
+        }
+    });
+}
+
+neggia_status neggia_dataset_read_frames(const neggia_dataset* dataset,
+                                         size_t first,
+                                         size_t count,
+                                         void* data,
+                                         size_t size,
+                                         size_t number_of_threads) {
+    return guard(NEGGIA_ERROR_READ, [&] {
+        checkArgument(dataset, "dataset");
+        const Dataset& source = dataset->dataset;
+        if (!source.isChunkedByFrame()) {
+            throw ApiError(NEGGIA_ERROR_UNSUPPORTED,
+                           "dataset is not chunked by frame");
+        }
+        size_t nFrames = source.dim()[0];
+        if (first > nFrames || count > nFrames - first) {
+            throw ApiError(NEGGIA_ERROR_OUT_OF_RANGE,
+                           "frames " + std::to_string(first) + " to " +
+                                   std::to_string(first + count) +
+                                   " of a dataset of " +
+                                   std::to_string(nFrames));
+        }
+        checkSize(size, getFrameSize(source) * count);
+        if (count == 0)
+            return;
+        checkArgument(data, "data");
+        source.readFrames(first, count, data, number_of_threads);
+    });
+}
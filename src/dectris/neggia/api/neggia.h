@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef NEGGIA_H
+#define NEGGIA_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Version of this interface. Functions are only ever added within a
+/// version; the version (and the soname of libneggia) changes if an
+/// existing function changes.
+#define NEGGIA_API_VERSION 1
+
+/// Status returned by all functions that can fail. The message of the last
+/// error on the calling thread is returned by neggia_last_error().
+typedef enum neggia_status {
+    NEGGIA_OK = 0,
+    /// a handle or pointer is NULL or a buffer has the wrong size
+    NEGGIA_ERROR_INVALID_ARGUMENT = -1,
+    /// the file cannot be opened or the dataset does not exist
+    NEGGIA_ERROR_NOT_FOUND = -2,
+    /// the frames or the chunk are not within the dataset
+    NEGGIA_ERROR_OUT_OF_RANGE = -3,
+    /// the dataset cannot be read this way, e.g. its layout or filter
+    NEGGIA_ERROR_UNSUPPORTED = -4,
+    /// the data cannot be read or decoded
+    NEGGIA_ERROR_READ = -5
+} neggia_status;
+
+typedef enum neggia_type_class {
+    NEGGIA_TYPE_UINT = 0,
+    NEGGIA_TYPE_INT = 1,
+    NEGGIA_TYPE_FLOAT = 2,
+    NEGGIA_TYPE_STRING = 3
+} neggia_type_class;
+
+typedef struct neggia_file neggia_file;
+typedef struct neggia_dataset neggia_dataset;
+
+/// NEGGIA_API_VERSION of the library that has been loaded
+int neggia_api_version(void);
+/// Version of neggia, e.g. "1.1.1"
+const char* neggia_version(void);
+/// Message of the last error on the calling thread. Successful calls do not
+/// reset it.
+const char* neggia_last_error(void);
+
+/// Opens the HDF5 file at path. The file is closed once it and all datasets
+/// opened from it have been closed.
+neggia_status neggia_file_open(const char* path, neggia_file** file);
+void neggia_file_close(neggia_file* file);
+
+/// Opens the dataset at path in file, following external links, e.g. to
+/// /entry/data/data_000001 of a master file. Any number of datasets may be
+/// open at the same time.
+neggia_status neggia_dataset_open(const neggia_file* file,
+                                  const char* path,
+                                  neggia_dataset** dataset);
+void neggia_dataset_close(neggia_dataset* dataset);
+
+/// Class and size in bytes of the elements. Reads return the elements in
+/// this type, without conversion.
+neggia_status neggia_dataset_type(const neggia_dataset* dataset,
+                                  neggia_type_class* type_class,
+                                  size_t* element_size);
+neggia_status neggia_dataset_rank(const neggia_dataset* dataset,
+                                  size_t* rank);
+/// Writes the rank dimensions of the dataset to dims
+neggia_status neggia_dataset_dims(const neggia_dataset* dataset,
+                                  size_t* dims,
+                                  size_t rank);
+/// Size in bytes of the whole dataset and of one frame, the data at one
+/// index of the first dimension. The frame size of a scalar is its size.
+neggia_status neggia_dataset_size(const neggia_dataset* dataset,
+                                  size_t* size,
+                                  size_t* frame_size);
+
+/// Reads the whole dataset into data, which must be size bytes large
+neggia_status neggia_dataset_read(const neggia_dataset* dataset,
+                                  void* data,
+                                  size_t size);
+/// Reads count frames starting at frame first into data, which must be
+/// count frames large. Only applies to datasets stored in chunks of one
+/// frame, such as the images of Eiger detectors. The frames are decoded in
+/// parallel on the calling thread and a pool of threads shared by all
+/// reads, on up to number_of_threads threads at a time, the calling thread
+/// and all threads of the pool if 0. The pool has one thread per hardware
+/// thread. A dataset may be read from several threads at the same time.
+neggia_status neggia_dataset_read_frames(const neggia_dataset* dataset,
+                                         size_t first,
+                                         size_t count,
+                                         void* data,
+                                         size_t size,
+                                         size_t number_of_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // NEGGIA_H
@@ -2,9 +2,8 @@
 
 #include "H5BTreeVersion2.h"
 #include <assert.h>
-#include <cmath>
 #include <iostream>
-#include <map>
+#include <stdexcept>
 #include "JenkinsLookup3Checksum.h"
 
 H5BTreeVersion2::H5BTreeVersion2() {
@@ -32,11 +31,67 @@ H5BTreeVersion2::Node H5BTreeVersion2::getRootNode() const {
 }
 
 size_t H5BTreeVersion2::getLinkAddressByName(
-        const std::string& linkName) const {
+        const StringView& linkName,
+        const LinkNameComparison& compareName) const {
+    size_t recordAddress;
+    if (!findLinkAddressByName(linkName, compareName, recordAddress))
+        throw std::out_of_range("link not found");
+    return recordAddress;
+}
+
+bool H5BTreeVersion2::findLinkAddressByName(
+        const StringView& linkName,
+        const LinkNameComparison& compareName,
+        size_t& recordAddress) const {
     assert(_btreeType == 5);
-    Node rootNode = getRootNode();
     uint32_t hash = JenkinsLookup3Checksum(linkName);
-    return getRecordAddressWithinInternalNodeFromLinkHash(hash, rootNode);
+    // compares the link looked up with a record, records with equal hashes
+    // are ordered by name
+    auto compare = [&](const Node& node, size_t record) {
+        size_t recordOffset = 6 + record * _recordSize;
+        uint32_t recordHash = node.read_u32(recordOffset);
+        if (hash != recordHash)
+            return hash < recordHash ? -1 : 1;
+        return compareName(node.offset() + recordOffset);
+    };
+    Node node = getRootNode();
+    while (true) {
+        // find the first record that is not less than the link
+        size_t first = 0;
+        size_t last = node.numberOfRecords;
+        while (first < last) {
+            size_t middle = first + (last - first) / 2;
+            if (compare(node, middle) > 0)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        if (first < node.numberOfRecords && compare(node, first) == 0) {
+            recordAddress = node.offset() + 6 + first * _recordSize;
+            return true;
+        }
+        if (node.depth == 0)
+            return false;
+        node = getChildNode(node, first);
+    }
+}
+
+std::vector<size_t> H5BTreeVersion2::getRecordAddresses() const {
+    std::vector<size_t> addresses;
+    addresses.reserve(_totalNumberOfRecords);
+    addRecordAddresses(getRootNode(), addresses);
+    return addresses;
+}
+
+void H5BTreeVersion2::addRecordAddresses(
+        const Node& node,
+        std::vector<size_t>& addresses) const {
+    for (size_t record = 0; record <= node.numberOfRecords; ++record) {
+        if (node.depth > 0)
+            addRecordAddresses(getChildNode(node, record), addresses);
+        if (record < node.numberOfRecords)
+            addresses.push_back(node.offset() + 6 + record * _recordSize);
+    }
 }
 
 void H5BTreeVersion2::init() {
@@ -58,6 +113,12 @@ void H5BTreeVersion2::init() {
             _maximumNumberOfRecordsOfLeaveNodes);
     _sizeOfTotalNumberOfRecordsForChild =
             getSizeOfTotalNumberOfRecordsForChildNode();
+    _sizeOfChildPointerMultiplet.resize(_depth + 1);
+    for (size_t d = 0; d <= _depth; ++d) {
+        _sizeOfChildPointerMultiplet[d] =
+                8 + _sizeOfNumberOfRecordsForChildNode +
+                _sizeOfTotalNumberOfRecordsForChild[d];
+    }
 }
 
 std::vector<size_t> H5BTreeVersion2::getSizeOfTotalNumberOfRecordsForChildNode()
@@ -88,12 +149,6 @@ std::vector<size_t> H5BTreeVersion2::getSizeOfTotalNumberOfRecordsForChildNode()
     return sizeOfTotalNumberOfRecordsForChild;
 }
 
-size_t H5BTreeVersion2::getSizeOfChildPointerMultiplet(size_t depth) const {
-    size_t returnValue = 8 + _sizeOfNumberOfRecordsForChildNode +
-                         _sizeOfTotalNumberOfRecordsForChild[depth];
-    return returnValue;
-}
-
 size_t H5BTreeVersion2::getRecordAddressWithinInternalNode(
         size_t record,
         const Node& node) const {
@@ -118,29 +173,6 @@ size_t H5BTreeVersion2::getRecordAddressWithinInternalNode(
     }
 }
 
-size_t H5BTreeVersion2::getRecordAddressWithinInternalNodeFromLinkHash(
-        uint32_t linkHash,
-        const Node& node) const {
-    for (size_t record = 0; record < node.numberOfRecords; ++record) {
-        size_t recordOffset = 6 + record * _recordSize;
-        uint32_t recordHash = node.read_u32(recordOffset);
-        if (linkHash < recordHash) {
-            if (node.depth == 0)
-                throw std::out_of_range("hash not found");
-            return getRecordAddressWithinInternalNodeFromLinkHash(
-                    linkHash, getChildNode(node, record));
-        } else if (linkHash == recordHash) {
-            return node.offset() + recordOffset;
-        } else {
-            continue;
-        }
-    }
-    if (node.depth == 0)
-        throw std::out_of_range("hash not found");
-    return getRecordAddressWithinInternalNodeFromLinkHash(
-            linkHash, getChildNode(node, node.numberOfRecords));
-}
-
 H5BTreeVersion2::Node H5BTreeVersion2::getChildNode(
         const H5BTreeVersion2::Node& parentNode,
         size_t childNodeNumber) const {
@@ -152,23 +184,23 @@ H5BTreeVersion2::Node H5BTreeVersion2::getChildNode(
     return childNode;
 }
 
+size_t H5BTreeVersion2::getChildPointerOffset(const Node& parentNode,
+                                              size_t childNodeNumber) const {
+    assert(parentNode.depth > 0);
+    return 6 + _recordSize * parentNode.numberOfRecords +
+           childNodeNumber * getSizeOfChildPointerMultiplet(parentNode.depth);
+}
+
 size_t H5BTreeVersion2::getChildNodeAddress(const Node& parentNode,
                                             size_t childNodeNumber) const {
-    assert(parentNode.depth > 0);
-    size_t address =
-            6 + _recordSize * parentNode.numberOfRecords +
-            childNodeNumber * getSizeOfChildPointerMultiplet(parentNode.depth);
-    return parentNode.read_u64(address);
+    return parentNode.read_u64(
+            getChildPointerOffset(parentNode, childNodeNumber));
 }
 
 size_t H5BTreeVersion2::getNumberOfRecordsForChildNode(
         const Node& parentNode,
         size_t childNodeNumber) const {
-    assert(parentNode.depth > 0);
-    size_t address =
-            6 + _recordSize * parentNode.numberOfRecords +
-            childNodeNumber * getSizeOfChildPointerMultiplet(parentNode.depth) +
-            8;
+    size_t address = getChildPointerOffset(parentNode, childNodeNumber) + 8;
     return parentNode.readIntegerAt(address,
                                     _sizeOfNumberOfRecordsForChildNode);
 }
@@ -180,17 +212,18 @@ size_t H5BTreeVersion2::getTotalNumberOfRecordsForChildNode(
     if (parentNode.depth == 1) {
         return getNumberOfRecordsForChildNode(parentNode, childNodeNumber);
     } else {
-        size_t address = 6 + _recordSize * parentNode.numberOfRecords +
-                         childNodeNumber * getSizeOfChildPointerMultiplet(
-                                                   parentNode.depth) +
+        size_t address = getChildPointerOffset(parentNode, childNodeNumber) +
                          8 + _sizeOfNumberOfRecordsForChildNode;
         return parentNode.readIntegerAt(
                 address, _sizeOfTotalNumberOfRecordsForChild[parentNode.depth]);
     }
 }
 
-size_t H5BTreeVersion2::getNumberOfBytesNeededToStoreValue(size_t value) const {
-    return (size_t)((std::log2(value) / 8) + 1);
+size_t H5BTreeVersion2::getNumberOfBytesNeededToStoreValue(size_t value) {
+    size_t numberOfBytes = 1;
+    while (value >>= 8)
+        ++numberOfBytes;
+    return numberOfBytes;
 }
 
 H5BTreeVersion2::Node::Node(const H5Object& obj) : H5Object(obj) {}
@@ -3,16 +3,34 @@
 #ifndef BTREEVERSION2_H
 #define BTREEVERSION2_H
 #include <dectris/neggia/data/H5Object.h>
-#include <string>
+#include <functional>
 #include <vector>
+#include "StringView.h"
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#V2Btrees
 
 class H5BTreeVersion2 : public H5Object {
 public:
+    /// Compares the name looked up with the name of the link the record at
+    /// the given address refers to, like std::string::compare.
+    typedef std::function<int(size_t recordAddress)> LinkNameComparison;
+
     H5BTreeVersion2();
     H5BTreeVersion2(const char* fileAddress, size_t offset);
     H5BTreeVersion2(const H5Object& obj);
     size_t getNumberOfRecords() const;
-    size_t getLinkAddressByName(const std::string& linkName) const;
+    /// Returns the address of the record of the link named linkName, throws
+    /// std::out_of_range if there is none. Records are ordered by the hash
+    /// of the link name and, for equal hashes, by the name itself, which is
+    /// compared with compareName for records whose hash matches only.
+    size_t getLinkAddressByName(const StringView& linkName,
+                                const LinkNameComparison& compareName) const;
+    /// Like getLinkAddressByName, returns false if there is no such link
+    bool findLinkAddressByName(const StringView& linkName,
+                               const LinkNameComparison& compareName,
+                               size_t& recordAddress) const;
+    /// Addresses of all records in the order of the tree
+    std::vector<size_t> getRecordAddresses() const;
 
 private:
     struct Node : public H5Object {
@@ -22,14 +40,17 @@ private:
     };
 
     void init();
-    size_t getNumberOfBytesNeededToStoreValue(size_t value) const;
+    void addRecordAddresses(const Node& node,
+                            std::vector<size_t>& addresses) const;
+    static size_t getNumberOfBytesNeededToStoreValue(size_t value);
     std::vector<size_t> getSizeOfTotalNumberOfRecordsForChildNode() const;
-    size_t getSizeOfChildPointerMultiplet(size_t depth) const;
+    size_t getSizeOfChildPointerMultiplet(size_t depth) const {
+        return _sizeOfChildPointerMultiplet[depth];
+    }
+    size_t getChildPointerOffset(const Node& parentNode,
+                                 size_t childNodeNumber) const;
     size_t getRecordAddressWithinInternalNode(size_t record,
                                               const Node& node) const;
-    size_t getRecordAddressWithinInternalNodeFromLinkHash(
-            uint32_t linkHash,
-            const Node& node) const;
     Node getChildNode(const Node& parentNode, size_t childNodeNumber) const;
     size_t getChildNodeAddress(const Node& parentNode,
                                size_t childNodeNumber) const;
@@ -50,6 +71,7 @@ private:
     size_t _maximumNumberOfRecordsOfLeaveNodes;
     size_t _sizeOfNumberOfRecordsForChildNode;
     std::vector<size_t> _sizeOfTotalNumberOfRecordsForChild;
+    std::vector<size_t> _sizeOfChildPointerMultiplet;
 };
 
 #endif  // BTREEVERSION2_H
@@ -5,6 +5,9 @@
 #include <string.h>
 #include <iostream>
 #include <stdexcept>
+#include "H5ExtensibleArray.h"
+#include "H5FixedArray.h"
+#include "constants.h"
 
 #define DEBUG_OFFSET 0
 
@@ -17,6 +20,12 @@ H5DataLayoutMsg::H5DataLayoutMsg(const H5Object& obj) : H5Object(obj) {
     this->_init();
 }
 
+H5DataLayoutMsg::H5DataLayoutMsg(const H5Object& obj,
+                                 const std::vector<size_t>& maxDim)
+      : H5Object(obj), _maxDim(maxDim) {
+    this->_init();
+}
+
 uint8_t H5DataLayoutMsg::version() const {
     return this->read_u8(0);
 }
@@ -41,6 +50,9 @@ const char* H5DataLayoutMsg::dataAddress() const {
         case 0:
             return address() + 2 + 2;
         case 1:
+            // the storage of contiguous data is allocated when it is written
+            if (read_u64(2) == H5_INVALID_ADDRESS)
+                throw std::runtime_error("data has not been written");
             return fileAddress() + read_u64(2);
         default:
             throw std::runtime_error("wrong layout class");
@@ -49,22 +61,70 @@ const char* H5DataLayoutMsg::dataAddress() const {
 
 uint8_t H5DataLayoutMsg::chunkDims() const {
     assert(layoutClass() == 2);
-    return this->read_u8(DEBUG_OFFSET + 2);
+    if (version() == 3)
+        return this->read_u8(DEBUG_OFFSET + 2);
+    return this->read_u8(3);
 }
 
-H5BLinkNode H5DataLayoutMsg::chunkBTree() const {
+uint64_t H5DataLayoutMsg::chunkIndexAddress() const {
     assert(layoutClass() == 2);
-    uint64_t linkOffset = this->read_u64(DEBUG_OFFSET + 3);
-    return H5BLinkNode(fileAddress(), linkOffset);
+    if (version() == 3)
+        return this->read_u64(DEBUG_OFFSET + 3);
+    // the address of the index follows the indexing type information
+    size_t infoSize = 0;
+    switch (chunkIndexingType()) {
+        case SINGLE_CHUNK:
+            // size and filter mask of a filtered chunk
+            if (flags() & 0x2)
+                infoSize = 8 + 4;
+            break;
+        case FIXED_ARRAY:
+            infoSize = 1;
+            break;
+        case EXTENSIBLE_ARRAY:
+            infoSize = 5;
+            break;
+    }
+    return this->read_u64(chunkIndexingInfoOffset() + infoSize);
+}
+
+bool H5DataLayoutMsg::hasChunkIndex() const {
+    return chunkIndexAddress() != H5_INVALID_ADDRESS;
 }
 
-uint32_t H5DataLayoutMsg::chunkDim(int i) const {
+uint64_t H5DataLayoutMsg::chunkDim(int i) const {
     assert(layoutClass() == 2);
-    return this->read_u32(DEBUG_OFFSET + 11 + 4 * i);
+    if (version() == 3)
+        return this->read_u32(DEBUG_OFFSET + 11 + 4 * i);
+    return readIntegerAt(5 + i * dimensionSize(), dimensionSize());
+}
+
+uint8_t H5DataLayoutMsg::flags() const {
+    assert(version() == 4 && layoutClass() == 2);
+    return this->read_u8(2);
+}
+
+size_t H5DataLayoutMsg::dimensionSize() const {
+    assert(version() == 4 && layoutClass() == 2);
+    return this->read_u8(4);
+}
+
+uint8_t H5DataLayoutMsg::chunkIndexingType() const {
+    assert(version() == 4 && layoutClass() == 2);
+    return this->read_u8(5 + chunkDims() * dimensionSize());
+}
+
+size_t H5DataLayoutMsg::chunkIndexingInfoOffset() const {
+    assert(version() == 4 && layoutClass() == 2);
+    return 5 + chunkDims() * dimensionSize() + 1;
 }
 
 void H5DataLayoutMsg::_init() {
-    assert(version() == 3);
+    if (version() != 3 && version() != 4) {
+        throw std::runtime_error("Data Layout Message version " +
+                                 std::to_string((int)version()) +
+                                 " not supported.");
+    }
     switch (layoutClass()) {
         case 0:
         case 1:
@@ -76,6 +136,18 @@ void H5DataLayoutMsg::_init() {
             for (size_t i = 0; i < chunkDims() - 1; ++i) {
                 _chunkShape.push_back(chunkDim(i));
             }
+            // the last chunk dimension is the size of an element
+            _chunkSize = chunkDim(chunkDims() - 1);
+            for (auto d : _chunkShape)
+                _chunkSize *= d;
+            if (version() == 4 && (chunkIndexingType() < SINGLE_CHUNK ||
+                                   chunkIndexingType() > EXTENSIBLE_ARRAY))
+            {
+                throw std::runtime_error(
+                        "Data Layout Message chunk indexing type " +
+                        std::to_string((int)chunkIndexingType()) +
+                        " not supported.");
+            }
             break;
         default:
             throw std::runtime_error("Data Layout Message layout class " +
@@ -84,21 +156,58 @@ void H5DataLayoutMsg::_init() {
     }
 }
 
+namespace {
+/// The keys and children of a node follow its 24 byte header, there is one
+/// key more than there are children. Checked before the node is read as a
+/// H5BLinkNode.
+bool isNodeWithinFile(const H5Object& node,
+                      size_t keySize,
+                      size_t childSize,
+                      size_t fileSize) {
+    if (!isWithinFile(node.offset(), 24, fileSize))
+        return false;
+    return isWithinFile(node.offset(),
+                        24 + node.read_u16(6) * (keySize + childSize) +
+                                keySize,
+                        fileSize);
+}
+
+template <class T1, class T2>
+bool chunkCompareGreaterEqual(const T1* key0, const T2* key1, size_t len) {
+    for (ssize_t idx = ((ssize_t)len) - 1; idx >= 0; --idx) {
+        if (key0[idx] < key1[idx])
+            return false;
+        if (key0[idx] > key1[idx])
+            return true;
+    }
+    return true;
+}
+}  // namespace
+
 H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::getRawData(
-        const std::vector<size_t>& chunkOffset) const {
+        const std::vector<size_t>& chunkOffset,
+        size_t fileSize) const {
     const char* rawData = nullptr;
     size_t rawDataSize = 0;
-    if (_isChunked) {
+    if (_isChunked && version() == 4) {
+        ConstDataPointer chunk;
+        if (!findChunk(chunkOffset, fileSize, chunk))
+            throw std::runtime_error("Not found");
+        return chunk;
+    } else if (_isChunked) {
         // internally hdf5 stores chunk size with one dimension more than the
         // dimensions of the dataset
         // https://www.hdfgroup.org/HDF5/doc/H5.format.html#LayoutMessage
         std::vector<size_t> chunkOffsetFullSize(chunkOffset);
         while (chunkOffsetFullSize.size() < _chunkShape.size() + 1)
             chunkOffsetFullSize.push_back(0);
-        H5Object dataChunk(extractDataChunk(chunkOffsetFullSize));
-        rawData = dataChunk.fileAddress() +
-                  dataChunk.read_u64(8 + chunkOffsetFullSize.size() * 8);
+        H5Object dataChunk(extractDataChunk(chunkOffsetFullSize, fileSize));
+        uint64_t chunkAddress =
+                dataChunk.read_u64(8 + chunkOffsetFullSize.size() * 8);
         rawDataSize = dataChunk.read_u32(0);
+        if (!isWithinFile(chunkAddress, rawDataSize, fileSize))
+            throw std::runtime_error("Not found");
+        rawData = dataChunk.fileAddress() + chunkAddress;
     } else {
         rawData = dataAddress();
         rawDataSize = dataSize();
@@ -106,26 +215,21 @@ H5DataLayoutMsg::ConstDataPointer H5DataLayoutMsg::getRawData(
     return ConstDataPointer{rawData, rawDataSize};
 }
 
-namespace {
-template <class T1, class T2>
-bool chunkCompareGreaterEqual(const T1* key0, const T2* key1, size_t len) {
-    for (ssize_t idx = ((ssize_t)len) - 1; idx >= 0; --idx) {
-        if (key0[idx] < key1[idx])
-            return false;
-        if (key0[idx] > key1[idx])
-            return true;
-    }
-    return true;
-}
-}  // namespace
-
-H5Object H5DataLayoutMsg::extractDataChunk(
-        const std::vector<size_t>& offset) const {
+H5Object H5DataLayoutMsg::extractDataChunk(const std::vector<size_t>& offset,
+                                           size_t fileSize) const {
     const size_t keySize = 8 + offset.size() * 8;
     const size_t childSize = 8;
-    H5BLinkNode bTree(chunkBTree());
+    if (!hasChunkIndex())
+        throw std::runtime_error("Not found");
+    H5Object node(fileAddress(), chunkIndexAddress());
+    H5BLinkNode bTree;
 
-    while (bTree.nodeLevel() > 0) {
+    while (true) {
+        if (!isNodeWithinFile(node, keySize, childSize, fileSize))
+            throw std::runtime_error("Not found");
+        bTree = H5BLinkNode(node);
+        if (bTree.nodeLevel() == 0)
+            break;
         bool found = false;
         for (int i = bTree.entriesUsed() - 1; i >= 0; --i) {
             H5Object key(bTree + 24 + i * (keySize + childSize));
@@ -133,7 +237,7 @@ H5Object H5DataLayoutMsg::extractDataChunk(
                                          (const uint64_t*)key.address(8),
                                          offset.size()))
             {
-                bTree = H5BLinkNode(key.fileAddress(), key.read_u64(keySize));
+                node = H5Object(key.fileAddress(), key.read_u64(keySize));
                 found = true;
                 break;
             }
@@ -153,6 +257,155 @@ H5Object H5DataLayoutMsg::extractDataChunk(
     throw std::runtime_error("Not found");
 }
 
+std::vector<H5DataLayoutMsg::ConstDataPointer>
+H5DataLayoutMsg::getChunkIndex(size_t fileSize) const {
+    assert(_isChunked);
+    std::vector<ConstDataPointer> chunkIndex;
+    if (!hasChunkIndex())
+        return chunkIndex;
+    if (version() == 3) {
+        addChunksToIndex(H5Object(fileAddress(), chunkIndexAddress()),
+                         fileSize, chunkIndex);
+        return chunkIndex;
+    }
+    // the chunks along the first dimension, up to the last one indexed
+    std::vector<size_t> chunks = maxChunks();
+    size_t indexedChunks = 1;
+    for (auto n : chunks)
+        indexedChunks *= n;
+    if (chunkIndexingType() == EXTENSIBLE_ARRAY) {
+        indexedChunks = H5ExtensibleArray(fileAddress(), chunkIndexAddress(),
+                                          fileSize)
+                                .numberOfElements();
+    }
+    std::vector<size_t> chunkOffset(_chunkShape.size(), 0);
+    for (size_t n = 0; n < chunks[0]; ++n) {
+        chunkOffset[0] = n * _chunkShape[0];
+        if (chunkArrayIndex(chunkOffset) >= indexedChunks)
+            break;
+        ConstDataPointer chunk;
+        if (!findChunk(chunkOffset, fileSize, chunk))
+            continue;
+        chunkIndex.resize(n + 1, ConstDataPointer{nullptr, 0});
+        chunkIndex[n] = chunk;
+    }
+    return chunkIndex;
+}
+
+bool H5DataLayoutMsg::findChunk(const std::vector<size_t>& chunkOffset,
+                                size_t fileSize,
+                                ConstDataPointer& chunk) const {
+    if (!hasChunkIndex())
+        return false;
+    const size_t index = chunkArrayIndex(chunkOffset);
+    uint64_t chunkAddress = H5_INVALID_ADDRESS;
+    size_t chunkSize = _chunkSize;
+    H5Object element;
+    size_t elementSize = 0;
+    switch (chunkIndexingType()) {
+        case SINGLE_CHUNK:
+            if (index != 0)
+                return false;
+            chunkAddress = chunkIndexAddress();
+            if (flags() & 0x2)
+                chunkSize = read_u64(chunkIndexingInfoOffset());
+            break;
+        case IMPLICIT:
+            chunkAddress = chunkIndexAddress() + index * _chunkSize;
+            break;
+        case FIXED_ARRAY: {
+            H5FixedArray array(fileAddress(), chunkIndexAddress(), fileSize);
+            if (!array.findElement(index, element))
+                return false;
+            elementSize = array.elementSize();
+            break;
+        }
+        case EXTENSIBLE_ARRAY: {
+            H5ExtensibleArray array(fileAddress(), chunkIndexAddress(),
+                                    fileSize);
+            if (!array.findElement(index, element))
+                return false;
+            elementSize = array.elementSize();
+            break;
+        }
+    }
+    if (elementSize > 0) {
+        // the address of the chunk, followed by its size and filter mask if
+        // the chunks are filtered
+        chunkAddress = element.read_u64(0);
+        if (elementSize > 8)
+            chunkSize = element.readIntegerAt(8, elementSize - 8 - 4);
+    }
+    if (chunkAddress == H5_INVALID_ADDRESS ||
+        !isWithinFile(chunkAddress, chunkSize, fileSize))
+    {
+        return false;
+    }
+    chunk = ConstDataPointer{fileAddress() + chunkAddress, chunkSize};
+    return true;
+}
+
+std::vector<size_t> H5DataLayoutMsg::maxChunks() const {
+    if (_maxDim.size() != _chunkShape.size())
+        throw std::runtime_error("maximum dimensions of the dataset unknown");
+    std::vector<size_t> chunks;
+    for (size_t i = 0; i < _chunkShape.size(); ++i) {
+        size_t n = _maxDim[i];
+        if (n != H5_INVALID_ADDRESS)
+            n = (n + _chunkShape[i] - 1) / _chunkShape[i];
+        chunks.push_back(n);
+    }
+    return chunks;
+}
+
+size_t H5DataLayoutMsg::chunkArrayIndex(
+        const std::vector<size_t>& chunkOffset) const {
+    // Chunks are numbered in row-major order of all chunks the dataset can
+    // hold. An extensible array moves its unlimited dimension to the front.
+    std::vector<size_t> chunks = maxChunks();
+    std::vector<size_t> dims;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i] == H5_INVALID_ADDRESS)
+            dims.insert(dims.begin(), i);
+        else
+            dims.push_back(i);
+    }
+    size_t index = 0;
+    for (auto i : dims) {
+        size_t scaled = i < chunkOffset.size() ? chunkOffset[i] : 0;
+        index = index * chunks[i] + scaled / _chunkShape[i];
+    }
+    return index;
+}
+
+void H5DataLayoutMsg::addChunksToIndex(
+        const H5Object& node,
+        size_t fileSize,
+        std::vector<ConstDataPointer>& chunkIndex) const {
+    // the chunk offsets stored in the keys have one dimension more than
+    // the dataset, see getRawData
+    const size_t keySize = 8 + (_chunkShape.size() + 1) * 8;
+    const size_t childSize = 8;
+    if (!isNodeWithinFile(node, keySize, childSize, fileSize))
+        return;
+    H5BLinkNode bTree(node);
+    for (int i = 0; i < bTree.entriesUsed(); ++i) {
+        H5Object key(bTree + 24 + i * (keySize + childSize));
+        if (bTree.nodeLevel() > 0) {
+            addChunksToIndex(H5Object(key.fileAddress(), key.read_u64(keySize)),
+                             fileSize, chunkIndex);
+            continue;
+        }
+        if (!isWithinFile(key.read_u64(keySize), key.read_u32(0), fileSize))
+            continue;
+        size_t chunkNumber = key.read_u64(8) / _chunkShape[0];
+        if (chunkNumber >= chunkIndex.size())
+            chunkIndex.resize(chunkNumber + 1, ConstDataPointer{nullptr, 0});
+        chunkIndex[chunkNumber] = ConstDataPointer{
+                key.fileAddress() + key.read_u64(keySize), key.read_u32(0)};
+    }
+}
+
 bool H5DataLayoutMsg::isChunked() const {
     return _isChunked;
 }
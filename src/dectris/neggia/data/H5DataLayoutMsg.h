@@ -17,10 +17,24 @@ public:
     H5DataLayoutMsg() = default;
     H5DataLayoutMsg(const char* fileAddress, size_t offset);
     H5DataLayoutMsg(const H5Object&);
+    /// Layout message version 4 locates chunks by their position among all
+    /// chunks the dataset can hold, which depends on its maximum dimensions.
+    /// Without them, chunks cannot be read from such a layout.
+    H5DataLayoutMsg(const H5Object&, const std::vector<size_t>& maxDim);
     uint8_t version() const;
     uint8_t layoutClass() const;
 
-    ConstDataPointer getRawData(const std::vector<size_t>& chunkOffset) const;
+    /// fileSize is the size of the file as it was mapped. A writer may link
+    /// chunks and B-tree nodes it has appended since, those are treated as
+    /// not written.
+    ConstDataPointer getRawData(const std::vector<size_t>& chunkOffset,
+                                size_t fileSize) const;
+
+    /// Raw data of all stored chunks indexed by their chunk number along the
+    /// first dimension. Only meaningful for datasets whose chunks span all
+    /// other dimensions completely. Chunks that have not been written are
+    /// returned as {nullptr, 0}.
+    std::vector<ConstDataPointer> getChunkIndex(size_t fileSize) const;
 
     bool isChunked() const;
     std::vector<size_t> chunkShape() const;
@@ -31,20 +45,46 @@ private:
     void _init();
 
     uint8_t chunkDims() const;
-    uint32_t chunkDim(int i) const;
+    uint64_t chunkDim(int i) const;
 
     /// for raw and contigous data  (layout class 0,1)
     size_t dataSize() const;
     const char* dataAddress() const;
 
-    /// for chunked data (layout class 2)
-    H5BLinkNode chunkBTree() const;
-    H5Object extractDataChunk(const std::vector<size_t>& chunkOffset) const;
+    /// for chunked data (layout class 2), the root node of the chunk B-tree
+    /// (version 3) or the chunk index given by chunkIndexingType (version 4)
+    uint64_t chunkIndexAddress() const;
+    /// false until the first chunk has been written
+    bool hasChunkIndex() const;
+    H5Object extractDataChunk(const std::vector<size_t>& chunkOffset,
+                              size_t fileSize) const;
+    void addChunksToIndex(const H5Object& node,
+                          size_t fileSize,
+                          std::vector<ConstDataPointer>& chunkIndex) const;
+
+    /// for chunked data of version 4
+    enum ChunkIndexingType {
+        SINGLE_CHUNK = 1,
+        IMPLICIT = 2,
+        FIXED_ARRAY = 3,
+        EXTENSIBLE_ARRAY = 4,
+        BTREE_VERSION_2 = 5
+    };
+    uint8_t flags() const;
     size_t dimensionSize() const;
     uint8_t chunkIndexingType() const;
+    size_t chunkIndexingInfoOffset() const;
+    bool findChunk(const std::vector<size_t>& chunkOffset,
+                   size_t fileSize,
+                   ConstDataPointer& chunk) const;
+    std::vector<size_t> maxChunks() const;
+    size_t chunkArrayIndex(const std::vector<size_t>& chunkOffset) const;
 
     bool _isChunked;
     std::vector<size_t> _chunkShape;
+    /// bytes of an unfiltered chunk
+    size_t _chunkSize = 0;
+    std::vector<size_t> _maxDim;
 };
 
 #endif  // H5DATALAYOUTMSG_H
@@ -1,16 +1,11 @@
 // SPDX-License-Identifier: MIT
 
 #include "H5DatatypeMsg.h"
-#include <assert.h>
 
 H5DatatypeMsg::H5DatatypeMsg(const char* fileAddress, size_t offset)
-      : H5Object(fileAddress, offset) {
-    this->_init();
-}
+      : H5Object(fileAddress, offset) {}
 
-H5DatatypeMsg::H5DatatypeMsg(const H5Object& obj) : H5Object(obj) {
-    this->_init();
-}
+H5DatatypeMsg::H5DatatypeMsg(const H5Object& obj) : H5Object(obj) {}
 
 unsigned int H5DatatypeMsg::version() const {
     return (this->read_u8(0) & 0xf0) >> 4;
@@ -29,9 +24,5 @@ bool H5DatatypeMsg::isSigned() const {
         return this->read_u8(1) & 0x8;
     else if (typeId() == 1)
         return true;
-}
-
-void H5DatatypeMsg::_init() {
-    unsigned int t = typeId();
-    assert(t == 0 || t == 1);
+    return false;
 }
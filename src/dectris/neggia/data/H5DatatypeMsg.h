@@ -11,13 +11,11 @@ public:
     H5DatatypeMsg(const char* fileAddress, size_t offset);
     H5DatatypeMsg(const H5Object&);
     unsigned int version() const;
+    /// datatype class, e.g. 0 fixed-point, 1 floating-point, 3 string
     unsigned int typeId() const;
     unsigned int dataSize() const;
     bool isSigned() const;
     constexpr static unsigned int TYPE_ID = 0x3;
-
-private:
-    void _init();
 };
 
 #endif  // H5DATATYPEMSG_H
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5DenseLinks.h"
+#include <memory>
+#include "H5BTreeVersion2.h"
+#include "H5FractalHeap.h"
+#include "constants.h"
+
+bool findDenseLinkMsg(const H5LinkInfoMsg& linkInfoMsg,
+                      const StringView& name,
+                      H5MetadataCache* cache,
+                      H5LinkMsg& linkMsg) {
+    size_t btreeAddress = linkInfoMsg.getBTreeAddress();
+    if (btreeAddress == H5_INVALID_ADDRESS) {
+        // links are stored in the object header
+        return false;
+    }
+    const char* fileAddress = linkInfoMsg.fileAddress();
+    H5BTreeVersion2 btree(fileAddress, btreeAddress);
+    H5Object heap(fileAddress, linkInfoMsg.getFractalHeapAddress());
+    std::shared_ptr<const H5FractalHeap> fractalHeap =
+            cache ? cache->fractalHeap(heap)
+                  : std::make_shared<const H5FractalHeap>(heap);
+    // records hold the hash of the link name (4 bytes) and the heap ID
+    auto linkMsgOfRecord = [&](size_t recordAddress) {
+        H5Object heapId(fileAddress, recordAddress + 4);
+        return H5LinkMsg(fractalHeap->getHeapObjectById(heapId));
+    };
+    // only needed for records whose name hash equals the one of name
+    auto compareName = [&](size_t recordAddress) {
+        return name.compare(linkMsgOfRecord(recordAddress).linkName());
+    };
+    size_t recordAddress;
+    if (!btree.findLinkAddressByName(name, compareName, recordAddress))
+        return false;
+    linkMsg = linkMsgOfRecord(recordAddress);
+    return true;
+}
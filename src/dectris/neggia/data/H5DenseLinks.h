@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5DENSELINKS_H
+#define H5DENSELINKS_H
+#include "H5LinkInfoMessage.h"
+#include "H5LinkMsg.h"
+#include "H5MetadataCache.h"
+#include "StringView.h"
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#LinkInfoMessage
+///
+/// Looks up the link called name in the dense storage of a group: link
+/// messages in a fractal heap, indexed by name in a version 2 B-tree.
+/// Returns false if the group keeps its links in its object header or has
+/// no link of that name. The geometry of the heap is taken from cache if
+/// there is one.
+bool findDenseLinkMsg(const H5LinkInfoMsg& linkInfoMsg,
+                      const StringView& name,
+                      H5MetadataCache* cache,
+                      H5LinkMsg& linkMsg);
+
+#endif  // H5DENSELINKS_H
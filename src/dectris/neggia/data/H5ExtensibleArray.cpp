@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5ExtensibleArray.h"
+#include <string.h>
+#include "constants.h"
+
+namespace {
+/// signature, version, client ID and header address
+constexpr size_t BLOCK_PREFIX_SIZE = 4 + 1 + 1 + 8;
+constexpr size_t CHECKSUM_SIZE = 4;
+}  // namespace
+
+H5ExtensibleArray::H5ExtensibleArray(const char* fileAddress,
+                                     size_t offset,
+                                     size_t fileSize)
+      : H5Object(fileAddress, offset), _fileSize(fileSize) {}
+
+bool H5ExtensibleArray::hasHeader() const {
+    return isWithinFile(offset(), HEADER_SIZE, _fileSize) &&
+           memcmp(address(), "EAHD", 4) == 0;
+}
+
+size_t H5ExtensibleArray::numberOfElements() const {
+    return hasHeader() ? read_u64(44) : 0;
+}
+
+size_t H5ExtensibleArray::elementSize() const {
+    return read_u8(6);
+}
+
+size_t H5ExtensibleArray::arrayOffsetSize() const {
+    return (read_u8(7) + 7) / 8;
+}
+
+size_t H5ExtensibleArray::pageElements() const {
+    return (size_t)1 << read_u8(11);
+}
+
+bool H5ExtensibleArray::findElement(size_t index, H5Object& element) const {
+    if (index >= numberOfElements())
+        return false;
+    uint64_t indexBlockAddress = read_u64(60);
+    if (indexBlockAddress == H5_INVALID_ADDRESS)
+        return false;
+    H5Object indexBlock(fileAddress(), indexBlockAddress);
+    const size_t indexBlockElements = read_u8(8);
+    if (index < indexBlockElements) {
+        size_t elementOffset = BLOCK_PREFIX_SIZE + index * elementSize();
+        if (!isWithinFile(indexBlockAddress, elementOffset + elementSize(),
+                          _fileSize) ||
+            memcmp(indexBlock.address(), "EAIB", 4) != 0)
+        {
+            return false;
+        }
+        element = indexBlock + elementOffset;
+        return true;
+    }
+
+    // Super block s has 2^(s/2) data blocks of 2^((s+1)/2) times the
+    // minimum number of elements. The index block stores the addresses of
+    // the data blocks of the first super blocks and of the super blocks
+    // that follow.
+    const size_t minElements = read_u8(9);
+    const size_t indexBlockDataBlocks = 2 * (read_u8(10) - 1);
+    size_t offset = index - indexBlockElements;
+    size_t superBlock = 0;
+    size_t indexBlockSuperBlocks = 0;
+    size_t firstDataBlock = 0;
+    size_t dataBlocks = 1;
+    size_t dataBlockElements = minElements;
+    while (offset >= dataBlocks * dataBlockElements) {
+        if (firstDataBlock < indexBlockDataBlocks)
+            ++indexBlockSuperBlocks;
+        offset -= dataBlocks * dataBlockElements;
+        firstDataBlock += dataBlocks;
+        ++superBlock;
+        dataBlocks = (size_t)1 << (superBlock / 2);
+        dataBlockElements = ((size_t)1 << ((superBlock + 1) / 2)) * minElements;
+    }
+    const size_t dataBlock = offset / dataBlockElements;
+    offset %= dataBlockElements;
+    const size_t addressesOffset =
+            BLOCK_PREFIX_SIZE + indexBlockElements * elementSize();
+    uint64_t dataBlockAddress;
+    if (firstDataBlock < indexBlockDataBlocks) {
+        size_t addressOffset =
+                addressesOffset + (firstDataBlock + dataBlock) * 8;
+        if (!readBlockAddress(indexBlock, "EAIB", addressOffset,
+                              dataBlockAddress))
+        {
+            return false;
+        }
+        return findElementInDataBlock(dataBlockAddress, dataBlockElements,
+                                      offset, element);
+    }
+
+    uint64_t superBlockAddress;
+    if (!readBlockAddress(indexBlock, "EAIB",
+                          addressesOffset + indexBlockDataBlocks * 8 +
+                                  (superBlock - indexBlockSuperBlocks) * 8,
+                          superBlockAddress))
+    {
+        return false;
+    }
+    // a super block of paged data blocks has a bitmap of the pages that
+    // have been written for each of them
+    H5Object superBlockObject(fileAddress(), superBlockAddress);
+    const size_t pages = dataBlockElements > pageElements()
+                                 ? dataBlockElements / pageElements()
+                                 : 0;
+    const size_t bitmapOffset = BLOCK_PREFIX_SIZE + arrayOffsetSize();
+    const size_t bitmapSize = dataBlocks * ((pages + 7) / 8);
+    if (!readBlockAddress(superBlockObject, "EASB",
+                          bitmapOffset + bitmapSize + dataBlock * 8,
+                          dataBlockAddress))
+    {
+        return false;
+    }
+    if (pages > 0) {
+        size_t bit = dataBlock * pages + offset / pageElements();
+        if (!(superBlockObject.read_u8(bitmapOffset + bit / 8) &
+              (0x80 >> (bit % 8))))
+        {
+            return false;
+        }
+    }
+    return findElementInDataBlock(dataBlockAddress, dataBlockElements, offset,
+                                  element);
+}
+
+bool H5ExtensibleArray::findElementInDataBlock(uint64_t dataBlockAddress,
+                                               size_t dataBlockElements,
+                                               size_t index,
+                                               H5Object& element) const {
+    const size_t prefixSize = BLOCK_PREFIX_SIZE + arrayOffsetSize();
+    if (!isWithinFile(dataBlockAddress, prefixSize, _fileSize) ||
+        memcmp(fileAddress() + dataBlockAddress, "EADB", 4) != 0)
+    {
+        return false;
+    }
+    uint64_t elementAddress =
+            dataBlockAddress + prefixSize + index * elementSize();
+    if (dataBlockElements > pageElements()) {
+        // the pages follow the checksum of the block, each with a checksum
+        // of its own
+        elementAddress = dataBlockAddress + prefixSize + CHECKSUM_SIZE +
+                         (index / pageElements()) *
+                                 (pageElements() * elementSize() +
+                                  CHECKSUM_SIZE) +
+                         (index % pageElements()) * elementSize();
+    }
+    if (!isWithinFile(elementAddress, elementSize(), _fileSize))
+        return false;
+    element = H5Object(fileAddress(), elementAddress);
+    return true;
+}
+
+bool H5ExtensibleArray::readBlockAddress(const H5Object& block,
+                                         const char* signature,
+                                         size_t offset,
+                                         uint64_t& blockAddress) const {
+    if (!isWithinFile(block.offset(), offset + 8, _fileSize) ||
+        memcmp(block.address(), signature, 4) != 0)
+    {
+        return false;
+    }
+    blockAddress = block.read_u64(offset);
+    return blockAddress != H5_INVALID_ADDRESS;
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5EXTENSIBLEARRAY_H
+#define H5EXTENSIBLEARRAY_H
+#include <dectris/neggia/data/H5Object.h>
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#ExtensibleArray
+///
+/// Chunk index of datasets with one unlimited dimension (layout message
+/// version 4), as written by SWMR writers. The first elements are stored in
+/// the index block, the others in data blocks that double in size every
+/// other super block. Blocks that lie beyond fileSize or have not been
+/// flushed yet are treated as not written.
+
+class H5ExtensibleArray : public H5Object {
+public:
+    H5ExtensibleArray() = default;
+    H5ExtensibleArray(const char* fileAddress, size_t offset, size_t fileSize);
+    /// One more than the largest index that has been set, 0 until the
+    /// header has been written
+    size_t numberOfElements() const;
+    size_t elementSize() const;
+    /// Returns false if the element with the given index has not been
+    /// written yet
+    bool findElement(size_t index, H5Object& element) const;
+
+private:
+    bool hasHeader() const;
+    bool findElementInDataBlock(uint64_t dataBlockAddress,
+                                size_t dataBlockElements,
+                                size_t index,
+                                H5Object& element) const;
+    bool readBlockAddress(const H5Object& block,
+                          const char* signature,
+                          size_t offset,
+                          uint64_t& blockAddress) const;
+    size_t arrayOffsetSize() const;
+    size_t pageElements() const;
+
+    constexpr static size_t HEADER_SIZE = 72;
+    size_t _fileSize = 0;
+};
+
+#endif  // H5EXTENSIBLEARRAY_H
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5FixedArray.h"
+#include <string.h>
+#include "constants.h"
+
+namespace {
+/// signature, version, client ID and header address
+constexpr size_t DATA_BLOCK_PREFIX_SIZE = 4 + 1 + 1 + 8;
+constexpr size_t CHECKSUM_SIZE = 4;
+}  // namespace
+
+H5FixedArray::H5FixedArray(const char* fileAddress,
+                           size_t offset,
+                           size_t fileSize)
+      : H5Object(fileAddress, offset), _fileSize(fileSize) {}
+
+bool H5FixedArray::hasHeader() const {
+    return isWithinFile(offset(), HEADER_SIZE, _fileSize) &&
+           memcmp(address(), "FAHD", 4) == 0;
+}
+
+size_t H5FixedArray::numberOfElements() const {
+    return hasHeader() ? read_u64(8) : 0;
+}
+
+size_t H5FixedArray::elementSize() const {
+    return read_u8(6);
+}
+
+bool H5FixedArray::findElement(size_t index, H5Object& element) const {
+    if (index >= numberOfElements())
+        return false;
+    // the data block is allocated when the first element is set
+    uint64_t dataBlockAddress = read_u64(16);
+    if (dataBlockAddress == H5_INVALID_ADDRESS)
+        return false;
+    const size_t pageSize = (size_t)1 << read_u8(7);
+    uint64_t elementAddress;
+    if (numberOfElements() <= pageSize) {
+        elementAddress = dataBlockAddress + DATA_BLOCK_PREFIX_SIZE +
+                         index * elementSize();
+        if (!isWithinFile(dataBlockAddress, DATA_BLOCK_PREFIX_SIZE, _fileSize))
+            return false;
+    } else {
+        // a paged data block has a bitmap of the pages that have been
+        // written, the pages follow the checksum of the block, each with a
+        // checksum of its own
+        const size_t pages = (numberOfElements() + pageSize - 1) / pageSize;
+        const size_t bitmapSize = (pages + 7) / 8;
+        const size_t page = index / pageSize;
+        if (!isWithinFile(dataBlockAddress, DATA_BLOCK_PREFIX_SIZE + bitmapSize,
+                          _fileSize))
+        {
+            return false;
+        }
+        H5Object bitmap(fileAddress(),
+                        dataBlockAddress + DATA_BLOCK_PREFIX_SIZE);
+        if (!(bitmap.read_u8(page / 8) & (0x80 >> (page % 8))))
+            return false;
+        elementAddress = bitmap.offset() + bitmapSize + CHECKSUM_SIZE +
+                         page * (pageSize * elementSize() + CHECKSUM_SIZE) +
+                         (index % pageSize) * elementSize();
+    }
+    if (memcmp(fileAddress() + dataBlockAddress, "FADB", 4) != 0 ||
+        !isWithinFile(elementAddress, elementSize(), _fileSize))
+    {
+        return false;
+    }
+    element = H5Object(fileAddress(), elementAddress);
+    return true;
+}
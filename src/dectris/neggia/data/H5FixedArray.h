@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5FIXEDARRAY_H
+#define H5FIXEDARRAY_H
+#include <dectris/neggia/data/H5Object.h>
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#FixedArray
+///
+/// Chunk index of datasets with fixed maximum dimensions (layout message
+/// version 4). Blocks that lie beyond fileSize or have not been flushed yet
+/// are treated as not written.
+
+class H5FixedArray : public H5Object {
+public:
+    H5FixedArray() = default;
+    H5FixedArray(const char* fileAddress, size_t offset, size_t fileSize);
+    /// 0 until the header has been written
+    size_t numberOfElements() const;
+    size_t elementSize() const;
+    /// Returns false if the element with the given index has not been
+    /// written yet
+    bool findElement(size_t index, H5Object& element) const;
+
+private:
+    bool hasHeader() const;
+    constexpr static size_t HEADER_SIZE = 28;
+    size_t _fileSize = 0;
+};
+
+#endif  // H5FIXEDARRAY_H
@@ -3,85 +3,91 @@
 #include "H5FractalHeap.h"
 #include <assert.h>
 #include <string.h>
-#include <cmath>
-#include <iostream>
+#include <algorithm>
+#include <stdexcept>
 #include <string>
+#include "H5BTreeVersion2.h"
 
-H5FractalHeap::H5FractalHeap() {}
+namespace {
 
-H5FractalHeap::H5FractalHeap(const char* fileAddress, size_t offset)
-      : H5Object(fileAddress, offset) {}
-
-H5FractalHeap::H5FractalHeap(const H5Object& obj) : H5Object(obj) {
-    assert(std::string(address(), 4) == "FRHP");
+/// Index of the highest bit set, i.e. floor(log2(value)) for value > 0
+size_t log2Floor(size_t value) {
+    size_t result = 0;
+    while (value >>= 1)
+        ++result;
+    return result;
 }
 
-size_t H5FractalHeap::getBlockOffsetSize() const {
-    uint16_t maximumHeapSize = this->read_u16(128);
-    size_t blockOffsetSize = maximumHeapSize / 8;
-    if (maximumHeapSize % 8 > 0)
-        blockOffsetSize += 1;
-    return blockOffsetSize;
-}
-
-uint64_t H5FractalHeap::getFiltersEncodedLength() const {
-    return this->read_u16(7);
-}
+}  // namespace
 
-bool H5FractalHeap::filtersArePresent() const {
-    return getFiltersEncodedLength() > 0;
+H5FractalHeap::H5FractalHeap() {
+    this->init();
 }
 
-bool H5FractalHeap::blocksAreChecksummed() const {
-    uint8_t flags = this->read_u8(9);
-    return (bool)(flags & 0x02);
-}
-
-uint16_t H5FractalHeap::getTableWidth() const {
-    return this->read_u16(110);
-}
-
-size_t H5FractalHeap::getMaximumNumberOfDirectBlocks() const {
-    return (size_t)(2 + std::log2(getMaximumDirectBlockSize()) -
-                    std::log2(getStartingBlockSize())) *
-           getTableWidth();
+H5FractalHeap::H5FractalHeap(const char* fileAddress, size_t offset)
+      : H5Object(fileAddress, offset) {
+    this->init();
 }
 
-size_t H5FractalHeap::getStartingBlockSize() const {
-    return this->read_u64(112);
+H5FractalHeap::H5FractalHeap(const H5Object& obj) : H5Object(obj) {
+    this->init();
 }
 
-size_t H5FractalHeap::getMaximumDirectBlockSize() const {
-    return this->read_u64(120);
+void H5FractalHeap::init() {
+    if (fileAddress() == nullptr) {
+        _heapIdLength = 0;
+        _filtersArePresent = false;
+        _hugeObjectsBTreeAddress = 0;
+        _tableWidth = 0;
+        _startingBlockSize = 0;
+        _log2StartingBlockSize = 0;
+        _log2FirstRowSize = 0;
+        _maximumNumberOfDirectBlocks = 0;
+        _blockOffsetSize = 0;
+        _directBlockEntrySize = 0;
+        _rootBlockAddress = 0;
+        _rootBlockIsDirect = true;
+        return;
+    }
+    assert(std::string(address(), 4) == "FRHP");
+    _heapIdLength = this->read_u16(5);
+    _filtersArePresent = this->read_u16(7) > 0;
+    _hugeObjectsBTreeAddress = this->read_u64(22);
+    _tableWidth = this->read_u16(110);
+    _startingBlockSize = this->read_u64(112);
+    size_t maximumDirectBlockSize = this->read_u64(120);
+    // table width and block sizes are powers of two
+    _log2StartingBlockSize = log2Floor(_startingBlockSize);
+    _log2FirstRowSize = log2Floor(_tableWidth) + _log2StartingBlockSize;
+    _maximumNumberOfDirectBlocks =
+            (log2Floor(maximumDirectBlockSize) - _log2StartingBlockSize + 2) *
+            _tableWidth;
+    uint16_t maximumHeapSize = this->read_u16(128);
+    _blockOffsetSize = (maximumHeapSize + 7) / 8;
+    // address, and for filtered blocks their size and filter mask
+    _directBlockEntrySize = _filtersArePresent ? 8 + 8 + 4 : 8;
+    _rootBlockAddress = this->read_u64(132);
+    _rootBlockIsDirect = this->read_u16(140) == 0;
+    _directBlocks = std::make_shared<DirectBlockCache>();
 }
 
 size_t H5FractalHeap::getRow(size_t offset) const {
-    auto w = getTableWidth();
-    auto s0 = getStartingBlockSize();
-    if (offset < w * s0) {
+    size_t firstRows = offset >> _log2FirstRowSize;
+    if (firstRows == 0)
         return 0;
-    } else {
-        return 1 + (size_t)(std::log2(offset / (w * s0)));
-    }
+    return 1 + log2Floor(firstRows);
 }
 
 size_t H5FractalHeap::getRowOffset(size_t row) const {
-    auto w = getTableWidth();
-    auto s0 = getStartingBlockSize();
-    if (row == 0) {
+    if (row == 0)
         return 0;
-    } else {
-        return w * s0 * std::pow(2, row - 1);
-    }
+    return ((size_t)1 << _log2FirstRowSize) << (row - 1);
 }
 
 size_t H5FractalHeap::getBlockSize(size_t row) const {
-    auto s0 = getStartingBlockSize();
-    if (row == 0) {
-        return s0;
-    } else {
-        return s0 * std::pow(2, row - 1);
-    }
+    if (row == 0)
+        return _startingBlockSize;
+    return _startingBlockSize << (row - 1);
 }
 
 H5Object H5FractalHeap::getHeapObjectInDirectBlock(const H5Object& directBlock,
@@ -91,40 +97,104 @@ H5Object H5FractalHeap::getHeapObjectInDirectBlock(const H5Object& directBlock,
 }
 
 H5Object H5FractalHeap::getHeapObjectInIndirectBlock(
-        const H5Object& indirectBlock,
+        const H5Object& rootBlock,
         size_t heapOffset) const {
-    assert(std::string(indirectBlock.address(), 4) == "FHIB");
-    size_t row = getRow(heapOffset);
-    size_t rowOffset = getRowOffset(row);
-    size_t blockSize = getBlockSize(row);
-    size_t column = (heapOffset - rowOffset) / blockSize;
-    size_t columnOffset = rowOffset + column * blockSize;
-    size_t blockNumber = row * getTableWidth() + column;
-    size_t maximumNumberOfDirectBlocks = getMaximumNumberOfDirectBlocks();
-    if (blockNumber < maximumNumberOfDirectBlocks) {
-        size_t blockOffset = 13 + getBlockOffsetSize() +
-                             blockNumber * (8 + 16 * filtersArePresent());
-        return getHeapObjectInDirectBlock(
-                H5Object(fileAddress(), indirectBlock.read_u64(blockOffset)),
-                heapOffset - columnOffset);
-    } else {
-        size_t blockOffset =
-                13 + getBlockOffsetSize() +
-                maximumNumberOfDirectBlocks * (8 + 16 * filtersArePresent()) +
-                8 * (blockNumber - maximumNumberOfDirectBlocks);
-        return getHeapObjectInIndirectBlock(
-                H5Object(fileAddress(), indirectBlock.read_u64(blockOffset)),
-                heapOffset - columnOffset);
+    H5Object indirectBlock = rootBlock;
+    // offset within the heap at which the current indirect block starts
+    size_t indirectBlockOffset = 0;
+    while (true) {
+        assert(std::string(indirectBlock.address(), 4) == "FHIB");
+        size_t relativeOffset = heapOffset - indirectBlockOffset;
+        size_t row = getRow(relativeOffset);
+        size_t rowOffset = getRowOffset(row);
+        size_t blockSize = getBlockSize(row);
+        size_t column = (relativeOffset - rowOffset) / blockSize;
+        size_t childOffset =
+                indirectBlockOffset + rowOffset + column * blockSize;
+        size_t blockNumber = row * _tableWidth + column;
+        size_t entryOffset = 13 + _blockOffsetSize;
+        if (blockNumber < _maximumNumberOfDirectBlocks) {
+            entryOffset += blockNumber * _directBlockEntrySize;
+            size_t blockAddress = indirectBlock.read_u64(entryOffset);
+            addCachedDirectBlock(childOffset, blockSize, blockAddress);
+            return getHeapObjectInDirectBlock(
+                    H5Object(fileAddress(), blockAddress),
+                    heapOffset - childOffset);
+        }
+        entryOffset += _maximumNumberOfDirectBlocks * _directBlockEntrySize +
+                       8 * (blockNumber - _maximumNumberOfDirectBlocks);
+        indirectBlock =
+                H5Object(fileAddress(), indirectBlock.read_u64(entryOffset));
+        indirectBlockOffset = childOffset;
     }
 }
 
+bool H5FractalHeap::findCachedDirectBlock(size_t heapOffset,
+                                          size_t& blockOffset,
+                                          size_t& blockAddress) const {
+    std::lock_guard<std::mutex> lock(_directBlocks->mutex);
+    auto block = _directBlocks->blocks.upper_bound(heapOffset);
+    if (block == _directBlocks->blocks.begin())
+        return false;
+    --block;
+    if (heapOffset - block->first >= block->second.size)
+        return false;
+    blockOffset = block->first;
+    blockAddress = block->second.address;
+    return true;
+}
+
+void H5FractalHeap::addCachedDirectBlock(size_t blockOffset,
+                                         size_t blockSize,
+                                         size_t blockAddress) const {
+    std::lock_guard<std::mutex> lock(_directBlocks->mutex);
+    _directBlocks->blocks[blockOffset] = DirectBlock{blockSize, blockAddress};
+}
+
 H5Object H5FractalHeap::getHeapObject(size_t offset) const {
-    size_t rootBlockAddress = this->read_i64(132);
-    H5Object rootBlock(this->fileAddress(), rootBlockAddress);
-    uint16_t currentNRowsInRootIndirectBlock = this->read_u16(140);
-    if (currentNRowsInRootIndirectBlock == 0) {  // root block is direct block
+    H5Object rootBlock(this->fileAddress(), _rootBlockAddress);
+    if (_rootBlockIsDirect)
         return getHeapObjectInDirectBlock(rootBlock, offset);
-    } else {  // root block is indirect block
-        return getHeapObjectInIndirectBlock(rootBlock, offset);
+    size_t blockOffset, blockAddress;
+    if (findCachedDirectBlock(offset, blockOffset, blockAddress)) {
+        return getHeapObjectInDirectBlock(
+                H5Object(fileAddress(), blockAddress), offset - blockOffset);
+    }
+    return getHeapObjectInIndirectBlock(rootBlock, offset);
+}
+
+H5Object H5FractalHeap::getHeapObjectById(const H5Object& heapId) const {
+    uint8_t flags = heapId.read_u8(0);
+    assert((flags >> 6) == 0);
+    switch ((flags >> 4) & 0x03) {
+        case MANAGED:
+            return getHeapObject(heapId.readIntegerAt(1, _blockOffsetSize));
+        case HUGE_OBJECT:
+            return getHugeObject(heapId);
+        case TINY:
+            // the object is stored in the ID, after one or (for IDs longer
+            // than 17 bytes) two bytes holding its length
+            return heapId.at(_heapIdLength > 17 ? 2 : 1);
+    }
+    throw std::out_of_range("invalid fractal heap ID");
+}
+
+H5Object H5FractalHeap::getHugeObject(const H5Object& heapId) const {
+    if (_filtersArePresent)
+        throw std::out_of_range("filtered huge objects are not supported");
+    if (_heapIdLength >= 1 + 8 + 8) {
+        // address and length are stored in the ID directly
+        return H5Object(fileAddress(), heapId.read_u64(1));
+    }
+    // the ID is the key of the object in the v2 B-tree of huge objects,
+    // whose records hold address, length and ID
+    size_t hugeObjectId = heapId.readIntegerAt(
+            1, std::min<size_t>(_heapIdLength - 1, sizeof(size_t)));
+    H5BTreeVersion2 bTree(fileAddress(), _hugeObjectsBTreeAddress);
+    for (size_t recordAddress : bTree.getRecordAddresses()) {
+        H5Object record(fileAddress(), recordAddress);
+        if (record.read_u64(16) == hugeObjectId)
+            return H5Object(fileAddress(), record.read_u64(0));
     }
+    throw std::out_of_range("huge object not found");
 }
@@ -1,23 +1,46 @@
 // SPDX-License-Identifier: MIT
 
+#ifndef H5FRACTALHEAP_H
+#define H5FRACTALHEAP_H
 #include <dectris/neggia/data/H5Object.h>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#FractalHeap
+///
+/// The geometry of the doubling table is read once on construction. Direct
+/// blocks found through indirect blocks are remembered, so that looking up
+/// many objects of the same heap (e.g. listing a large group) does not walk
+/// the indirect blocks again. Copies share this cache, which may be used
+/// concurrently.
 
 class H5FractalHeap : public H5Object {
 public:
     H5FractalHeap();
     H5FractalHeap(const char* fileAddress, size_t offset);
     H5FractalHeap(const H5Object&);
+    /// Returns the managed object at the given offset within the heap
     H5Object getHeapObject(size_t offset) const;
+    /// Returns the object a heap ID refers to: a managed object, a tiny
+    /// object stored in the ID itself or a huge object stored outside the
+    /// heap. Throws std::out_of_range for filtered huge objects.
+    H5Object getHeapObjectById(const H5Object& heapId) const;
+
+    enum HeapIdType { MANAGED = 0, HUGE_OBJECT = 1, TINY = 2 };
 
 private:
-    size_t getBlockOffsetSize() const;
-    uint64_t getFiltersEncodedLength() const;
-    bool filtersArePresent() const;
-    bool blocksAreChecksummed() const;
-    uint16_t getTableWidth() const;
-    size_t getMaximumNumberOfDirectBlocks() const;
-    size_t getStartingBlockSize() const;
-    size_t getMaximumDirectBlockSize() const;
+    struct DirectBlock {
+        size_t size;
+        size_t address;
+    };
+    struct DirectBlockCache {
+        std::mutex mutex;
+        /// direct blocks by the heap offset they start at
+        std::map<size_t, DirectBlock> blocks;
+    };
+
+    void init();
     size_t getRow(size_t offset) const;
     size_t getRowOffset(size_t row) const;
     size_t getBlockSize(size_t row) const;
@@ -25,4 +48,28 @@ private:
                                         size_t heapOffset) const;
     H5Object getHeapObjectInIndirectBlock(const H5Object& indirectBlock,
                                           size_t heapOffset) const;
+    bool findCachedDirectBlock(size_t heapOffset,
+                               size_t& blockOffset,
+                               size_t& blockAddress) const;
+    void addCachedDirectBlock(size_t blockOffset,
+                              size_t blockSize,
+                              size_t blockAddress) const;
+    H5Object getHugeObject(const H5Object& heapId) const;
+
+    size_t _heapIdLength;
+    bool _filtersArePresent;
+    size_t _hugeObjectsBTreeAddress;
+    size_t _tableWidth;
+    size_t _startingBlockSize;
+    size_t _log2StartingBlockSize;
+    /// width of a row of starting blocks (table width * starting block size)
+    size_t _log2FirstRowSize;
+    size_t _maximumNumberOfDirectBlocks;
+    size_t _blockOffsetSize;
+    size_t _directBlockEntrySize;
+    size_t _rootBlockAddress;
+    bool _rootBlockIsDirect;
+    std::shared_ptr<DirectBlockCache> _directBlocks;
 };
+
+#endif  // H5FRACTALHEAP_H
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5Group.h"
+#include <assert.h>
+#include <algorithm>
+#include "H5BLinkNode.h"
+#include "H5BTreeVersion2.h"
+#include "H5FractalHeap.h"
+#include "H5LinkInfoMessage.h"
+#include "H5LocalHeap.h"
+#include "H5SymbolTableNode.h"
+#include "constants.h"
+
+namespace {
+
+void addSymbolTableNodeLinks(const H5BLinkNode& node,
+                             const H5LocalHeap& heap,
+                             std::vector<H5GroupLink>& links) {
+    assert(node.nodeType() == 0);
+    for (int i = 0; i < node.entriesUsed(); ++i) {
+        if (node.nodeLevel() > 0) {
+            addSymbolTableNodeLinks(H5BLinkNode(node.child(i)), heap, links);
+            continue;
+        }
+        H5SymbolTableNode symbolTableNode(node.child(i));
+        for (int j = 0; j < symbolTableNode.numberOfSymbols(); ++j) {
+            H5SymbolTableEntry entry(symbolTableNode.entry(j));
+            H5GroupLink link{heap.data(entry.linkNameOffset()),
+                             H5LinkMsg::HARD, entry.read_u64(8), {}, {}};
+            if (entry.cacheType() == H5SymbolTableEntry::LINK) {
+                link.linkType = H5LinkMsg::SOFT;
+                link.targetPath = heap.data(entry.getOffsetToLinkValue());
+            }
+            links.push_back(link);
+        }
+    }
+}
+
+}  // namespace
+
+H5Group::H5Group(const H5ObjectHeader& objectHeader)
+      : H5ObjectHeader(objectHeader) {}
+
+std::vector<H5GroupLink> H5Group::links() const {
+    std::vector<H5GroupLink> links;
+    forEachMessage([&](const H5HeaderMessage& msg) -> bool {
+        switch (msg.type) {
+            case SYMBOL_TABLE_MSG_TYPE_ID:
+                addSymbolTableLinks(msg.object, links);
+                break;
+            case H5LinkMsg::TYPE_ID:
+                links.push_back(fromLinkMsg(H5LinkMsg(msg.object)));
+                break;
+            case H5LinkInfoMsg::TYPE_ID:
+                addDenseLinks(msg.object, links);
+                break;
+        }
+        return true;
+    });
+    std::sort(links.begin(), links.end(),
+              [](const H5GroupLink& a, const H5GroupLink& b) {
+                  return a.name < b.name;
+              });
+    return links;
+}
+
+void H5Group::addSymbolTableLinks(const H5Object& symbolTableMsg,
+                                  std::vector<H5GroupLink>& links) const {
+    H5BLinkNode bTree(fileAddress(), symbolTableMsg.read_u64(0));
+    H5LocalHeap heap(fileAddress(), symbolTableMsg.read_u64(8));
+    addSymbolTableNodeLinks(bTree, heap, links);
+}
+
+void H5Group::addDenseLinks(const H5Object& linkInfoMsg,
+                            std::vector<H5GroupLink>& links) const {
+    H5LinkInfoMsg linkInfo(linkInfoMsg);
+    if (linkInfo.getFractalHeapAddress() == H5_INVALID_ADDRESS ||
+        linkInfo.getBTreeAddress() == H5_INVALID_ADDRESS)
+    {
+        // links are stored in the object header
+        return;
+    }
+    H5FractalHeap fractalHeap(fileAddress(), linkInfo.getFractalHeapAddress());
+    H5BTreeVersion2 bTree(fileAddress(), linkInfo.getBTreeAddress());
+    for (size_t recordAddress : bTree.getRecordAddresses()) {
+        // records hold the hash of the link name (4 bytes) and the heap ID
+        H5Object heapId(fileAddress(), recordAddress + 4);
+        links.push_back(
+                fromLinkMsg(H5LinkMsg(fractalHeap.getHeapObjectById(heapId))));
+    }
+}
+
+H5GroupLink H5Group::fromLinkMsg(const H5LinkMsg& linkMsg) {
+    H5GroupLink link{linkMsg.linkName().toString(), linkMsg.linkType(), 0,
+                     linkMsg.targetFile().toString(),
+                     linkMsg.targetPath().toString()};
+    if (link.linkType == H5LinkMsg::HARD)
+        link.objectHeaderAddress = linkMsg.hardLinkObjectHeader().offset();
+    return link;
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5GROUP_H
+#define H5GROUP_H
+#include <string>
+#include <vector>
+#include "H5LinkMsg.h"
+#include "H5ObjectHeader.h"
+
+/// A link found in a group. For hard links, objectHeaderAddress is the
+/// offset of the object header of the target within the file. For soft and
+/// external links, targetPath (and targetFile) hold the link value.
+struct H5GroupLink {
+    std::string name;
+    H5LinkMsg::LinkType linkType;
+    size_t objectHeaderAddress;
+    std::string targetFile;
+    std::string targetPath;
+};
+
+/// Lists the links of a group in one pass, for all three ways of storing
+/// them: a symbol table (v1 B-tree and local heap), link messages in the
+/// object header (compact storage) and a fractal heap indexed by a v2 B-tree
+/// (dense storage).
+/// https://support.hdfgroup.org/HDF5/doc/H5.format.html#Group
+
+class H5Group : public H5ObjectHeader {
+public:
+    H5Group() = default;
+    H5Group(const H5ObjectHeader& objectHeader);
+    /// All links, sorted by name
+    std::vector<H5GroupLink> links() const;
+
+    constexpr static unsigned int SYMBOL_TABLE_MSG_TYPE_ID = 0x11;
+
+private:
+    void addSymbolTableLinks(const H5Object& symbolTableMsg,
+                             std::vector<H5GroupLink>& links) const;
+    void addDenseLinks(const H5Object& linkInfoMsg,
+                       std::vector<H5GroupLink>& links) const;
+    static H5GroupLink fromLinkMsg(const H5LinkMsg& linkMsg);
+};
+
+#endif  // H5GROUP_H
@@ -2,6 +2,7 @@
 
 #include "H5LinkMsg.h"
 #include <assert.h>
+#include <string.h>
 #include <stdexcept>
 
 H5LinkMsg::H5LinkMsg(const char* fileAddress, size_t offset)
@@ -13,7 +14,7 @@ H5LinkMsg::H5LinkMsg(const H5Object& other) : H5Object(other) {
     this->_init();
 }
 
-std::string H5LinkMsg::linkName() const {
+StringView H5LinkMsg::linkName() const {
     return _linkName;
 }
 
@@ -21,11 +22,11 @@ H5LinkMsg::LinkType H5LinkMsg::linkType() const {
     return _linkType;
 }
 
-std::string H5LinkMsg::targetFile() const {
+StringView H5LinkMsg::targetFile() const {
     return _targetFile;
 }
 
-std::string H5LinkMsg::targetPath() const {
+StringView H5LinkMsg::targetPath() const {
     return _targetPath;
 }
 
@@ -33,60 +34,76 @@ const H5Object& H5LinkMsg::hardLinkObjectHeader() const {
     return _hardLinkObjectHeader;
 }
 
-void H5LinkMsg::_init() {
-    assert(read_u8(0) == 1);  // version == 1
-    uint8_t flags = read_u8(1);
+bool H5LinkMsg::hasLinkName(const H5Object& message,
+                            const StringView& name) {
+    size_t lengthOfLinkName;
+    size_t linkNameOffset = _linkNameOffset(message, lengthOfLinkName);
+    return StringView(message.address(linkNameOffset), lengthOfLinkName) ==
+           name;
+}
+
+size_t H5LinkMsg::_linkNameOffset(const H5Object& message,
+                                  size_t& lengthOfLinkName) {
+    assert(message.read_u8(0) == 1);  // version == 1
+    uint8_t flags = message.read_u8(1);
     bool creationOrderIsPresent = flags & 0x4;
     bool linkTypeFieldIsPresent = flags & 0x8;
     bool linkNameCharacterSetFieldIsPresent = flags & 0x10;
 
-    if (linkTypeFieldIsPresent) {
-        uint8_t lt = read_u8(2);
-        switch (lt) {
-            case 0:
-                _linkType = HARD;
-                break;
-            case 1:
-                _linkType = SOFT;
-                break;
-            case 64:
-                _linkType = EXTERNAL;
-                break;
-            default:
-                assert(false);
-        }
-    } else {
-        _linkType = HARD;
-    }
-
     uint8_t lengthOfLinkNameOffset = 2 + linkTypeFieldIsPresent +
                                      creationOrderIsPresent * 8 +
                                      linkNameCharacterSetFieldIsPresent;
 
     uint8_t lengthOfLinkNameSize = 0;
-    size_t lengthOfLinkName = 0;
     switch (flags & 0x3) {
         case 0:
             lengthOfLinkNameSize = 1;
-            lengthOfLinkName = read_u8(lengthOfLinkNameOffset);
+            lengthOfLinkName = message.read_u8(lengthOfLinkNameOffset);
             break;
         case 1:
-            lengthOfLinkName = read_u16(lengthOfLinkNameOffset);
+            lengthOfLinkName = message.read_u16(lengthOfLinkNameOffset);
             lengthOfLinkNameSize = 2;
             break;
         case 2:
-            lengthOfLinkName = read_u32(lengthOfLinkNameOffset);
+            lengthOfLinkName = message.read_u32(lengthOfLinkNameOffset);
             lengthOfLinkNameSize = 4;
             break;
         case 3:
-            lengthOfLinkName = read_u64(lengthOfLinkNameOffset);
+            lengthOfLinkName = message.read_u64(lengthOfLinkNameOffset);
             lengthOfLinkNameSize = 8;
             break;
         default:
             assert(false);
     }
-    size_t linkNameOffset = lengthOfLinkNameOffset + lengthOfLinkNameSize;
-    _linkName = std::string(address(linkNameOffset), lengthOfLinkName);
+    return lengthOfLinkNameOffset + lengthOfLinkNameSize;
+}
+
+void H5LinkMsg::_init() {
+    uint8_t flags = read_u8(1);
+    bool linkTypeFieldIsPresent = flags & 0x8;
+
+    if (linkTypeFieldIsPresent) {
+        uint8_t lt = read_u8(2);
+        switch (lt) {
+            case 0:
+                _linkType = HARD;
+                break;
+            case 1:
+                _linkType = SOFT;
+                break;
+            case 64:
+                _linkType = EXTERNAL;
+                break;
+            default:
+                assert(false);
+        }
+    } else {
+        _linkType = HARD;
+    }
+
+    size_t lengthOfLinkName;
+    size_t linkNameOffset = _linkNameOffset(*this, lengthOfLinkName);
+    _linkName = StringView(address(linkNameOffset), lengthOfLinkName);
     size_t linkInformationOffset = linkNameOffset + lengthOfLinkName;
 
     switch (_linkType) {
@@ -96,9 +113,9 @@ void H5LinkMsg::_init() {
             break;
         case SOFT: {
             size_t length = read_u16(linkInformationOffset);
-            _targetFile = "";
+            _targetFile = StringView();
             _targetPath =
-                    std::string(address(linkInformationOffset + 2), length);
+                    StringView(address(linkInformationOffset + 2), length);
             break;
         }
         case EXTERNAL: {
@@ -110,10 +127,10 @@ void H5LinkMsg::_init() {
             for (size_t i = 0; i < length - 1; ++i) {
                 if (read_u8(linkInformationOffset + i) == 0) {
                     _targetFile =
-                            std::string(address(linkInformationOffset), i);
+                            StringView(address(linkInformationOffset), i);
                     _targetPath =
-                            std::string(address(linkInformationOffset + i + 1),
-                                        length - i - 2);
+                            StringView(address(linkInformationOffset + i + 1),
+                                       length - i - 2);
                     break;
                 }
             }
@@ -3,8 +3,11 @@
 #ifndef H5LINKMSG_H
 #define H5LINKMSG_H
 #include "H5Object.h"
+#include "StringView.h"
 
 /// https://www.hdfgroup.org/HDF5/doc/H5.format.html#LinkMessage
+///
+/// Names and targets are views into the mapped file.
 
 class H5LinkMsg : public H5Object {
 public:
@@ -14,19 +17,25 @@ public:
     H5LinkMsg(const char* fileAddress, size_t offset);
     H5LinkMsg(const H5Object& other);
     constexpr static unsigned int TYPE_ID = 0x06;
-    std::string linkName() const;
+    StringView linkName() const;
     LinkType linkType() const;
-    std::string targetFile() const;
-    std::string targetPath() const;
+    StringView targetFile() const;
+    StringView targetPath() const;
     /// can be converted to H5ObjectHeader
     const H5Object& hardLinkObjectHeader() const;
 
+    /// Compares the name of the link message at message with name without
+    /// decoding the rest of the message
+    static bool hasLinkName(const H5Object& message, const StringView& name);
+
 private:
+    static size_t _linkNameOffset(const H5Object& message,
+                                  size_t& lengthOfLinkName);
     void _init();
-    std::string _linkName;
+    StringView _linkName;
     LinkType _linkType;
-    std::string _targetFile;
-    std::string _targetPath;
+    StringView _targetFile;
+    StringView _targetPath;
     H5Object _hardLinkObjectHeader;
 };
 
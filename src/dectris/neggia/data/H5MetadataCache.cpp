@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5MetadataCache.h"
+
+bool H5MetadataCache::findResolvedPath(const StringView& path,
+                                       ResolvedPath& resolvedPath) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto cachedPath = _resolvedPaths.find(path);
+    if (cachedPath == _resolvedPaths.end())
+        return false;
+    resolvedPath.objectHeader = cachedPath->second->objectHeader;
+    resolvedPath.externalFile.filename = cachedPath->second->filename;
+    resolvedPath.externalFile.h5Path = cachedPath->second->h5Path;
+    return true;
+}
+
+void H5MetadataCache::addResolvedPath(const StringView& path,
+                                      const ResolvedPath& resolvedPath) {
+    std::unique_ptr<CachedPath> cachedPath(new CachedPath{
+            path.toString(), resolvedPath.objectHeader,
+            resolvedPath.externalFile.filename.toString(),
+            resolvedPath.externalFile.h5Path});
+    std::lock_guard<std::mutex> lock(_mutex);
+    StringView key(cachedPath->path);
+    if (_resolvedPaths.find(key) == _resolvedPaths.end())
+        _resolvedPaths.emplace(key, std::move(cachedPath));
+}
+
+size_t H5MetadataCache::findDeepestGroup(const H5Path& path,
+                                         size_t& groupOffset,
+                                         StringView& groupPath) const {
+    // prefixes of the canonical path end before a separator
+    StringView pathView = path.view();
+    size_t depth = 0;
+    for (auto item = path.begin(); item != path.end(); ++item)
+        ++depth;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t prefixLength = pathView.size(); depth > 0; --depth) {
+        auto group = _groups.find(StringView(pathView.data(), prefixLength));
+        if (group != _groups.end()) {
+            groupOffset = group->second->offset;
+            groupPath = group->first;
+            return depth;
+        }
+        while (pathView[prefixLength - 1] != '/')
+            --prefixLength;
+        --prefixLength;
+    }
+    return 0;
+}
+
+void H5MetadataCache::addGroup(const StringView& path, size_t groupOffset) {
+    std::unique_ptr<CachedGroup> group(
+            new CachedGroup{path.toString(), groupOffset});
+    std::lock_guard<std::mutex> lock(_mutex);
+    StringView key(group->path);
+    if (_groups.find(key) == _groups.end())
+        _groups.emplace(key, std::move(group));
+}
+
+std::shared_ptr<const H5SymbolTableIndex> H5MetadataCache::symbolTableIndex(
+        const H5SymbolTableEntry& group) {
+    size_t bTreeAddress = group.getAddressOfBTree();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto index = _symbolTableIndexes.find(bTreeAddress);
+        if (index != _symbolTableIndexes.end())
+            return index->second;
+    }
+    // built without holding the lock, the first one added wins
+    auto index = std::make_shared<const H5SymbolTableIndex>(group);
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _symbolTableIndexes.emplace(bTreeAddress, index).first->second;
+}
+
+std::shared_ptr<const H5FractalHeap> H5MetadataCache::fractalHeap(
+        const H5Object& heap) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto fractalHeap = _fractalHeaps.find(heap.offset());
+        if (fractalHeap != _fractalHeaps.end())
+            return fractalHeap->second;
+    }
+    // opened without holding the lock, the first one added wins
+    auto fractalHeap = std::make_shared<const H5FractalHeap>(heap);
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _fractalHeaps.emplace(heap.offset(), fractalHeap).first->second;
+}
+
+size_t H5MetadataCache::numberOfGroups() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _groups.size();
+}
+
+size_t H5MetadataCache::numberOfResolvedPaths() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _resolvedPaths.size();
+}
+
+size_t H5MetadataCache::numberOfSymbolTableIndexes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _symbolTableIndexes.size();
+}
+
+size_t H5MetadataCache::numberOfFractalHeaps() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _fractalHeaps.size();
+}
+
+std::string H5MetadataCache::childPath(const StringView& groupPath,
+                                       const StringView& item) {
+    if (groupPath.empty())
+        return std::string();
+    std::string path(groupPath.toString());
+    if (path != "/")
+        path += '/';
+    path.append(item.data(), item.size());
+    return path;
+}
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5METADATACACHE_H
+#define H5METADATACACHE_H
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "H5FractalHeap.h"
+#include "H5Path.h"
+#include "H5SymbolTableIndex.h"
+#include "ResolvedPath.h"
+#include "StringView.h"
+
+/// Remembers what path resolution found in one file: the groups walked
+/// through, keyed by their absolute path, and the results of resolved paths,
+/// including links to external files. Resolving a sibling of a known object
+/// then starts from the cached parent group instead of the root. Groups are
+/// stored as the offset of their symbol table entry (superblock version 0)
+/// or of their object header (superblock version 2 and 3). Groups stored as
+/// symbol tables are indexed by name on their first lookup, fractal heaps
+/// of dense groups are kept open.
+/// Entries are never replaced, so views returned into the cache stay valid
+/// as long as the cache exists. Looking up cached entries does not allocate.
+/// All methods may be called concurrently.
+class H5MetadataCache {
+public:
+    H5MetadataCache() = default;
+    H5MetadataCache(const H5MetadataCache&) = delete;
+    H5MetadataCache& operator=(const H5MetadataCache&) = delete;
+
+    bool findResolvedPath(const StringView& path,
+                          ResolvedPath& resolvedPath) const;
+    void addResolvedPath(const StringView& path,
+                         const ResolvedPath& resolvedPath);
+
+    /// Returns the number of leading components of the absolute path that
+    /// form the deepest cached group, 0 if none is cached.
+    size_t findDeepestGroup(const H5Path& path,
+                            size_t& groupOffset,
+                            StringView& groupPath) const;
+    void addGroup(const StringView& path, size_t groupOffset);
+
+    /// Returns the index of a group stored as a symbol table, building it
+    /// on the first call for this group
+    std::shared_ptr<const H5SymbolTableIndex> symbolTableIndex(
+            const H5SymbolTableEntry& group);
+
+    /// Returns the fractal heap at heap, opening it on the first call for
+    /// this heap, so that the direct blocks it has located are reused by
+    /// later lookups
+    std::shared_ptr<const H5FractalHeap> fractalHeap(const H5Object& heap);
+
+    size_t numberOfGroups() const;
+    size_t numberOfResolvedPaths() const;
+    size_t numberOfSymbolTableIndexes() const;
+    size_t numberOfFractalHeaps() const;
+
+    /// Joins the absolute path of a group and the name of an item in it.
+    /// Returns an empty string if the path of the group is not known (empty).
+    static std::string childPath(const StringView& groupPath,
+                                 const StringView& item);
+
+private:
+    struct CachedPath {
+        std::string path;
+        H5ObjectHeader objectHeader;
+        std::string filename;
+        H5Path h5Path;
+    };
+    struct CachedGroup {
+        std::string path;
+        size_t offset;
+    };
+
+    mutable std::mutex _mutex;
+    /// keys are views of the path stored in the value
+    std::unordered_map<StringView, std::unique_ptr<CachedGroup>, StringViewHash>
+            _groups;
+    std::unordered_map<StringView, std::unique_ptr<CachedPath>, StringViewHash>
+            _resolvedPaths;
+    /// by address of the B-tree of the group
+    std::map<size_t, std::shared_ptr<const H5SymbolTableIndex>>
+            _symbolTableIndexes;
+    /// by address of the heap header
+    std::map<size_t, std::shared_ptr<const H5FractalHeap>> _fractalHeaps;
+};
+
+#endif  // H5METADATACACHE_H
@@ -43,4 +43,11 @@ private:
     size_t _offset;
 };
 
+/// True if size bytes at offset lie within the first fileSize bytes of the
+/// file. A writer may link structures it has appended after the file was
+/// mapped, those are treated as not written.
+inline bool isWithinFile(uint64_t offset, uint64_t size, size_t fileSize) {
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
 #endif  // H5OBJECT_H
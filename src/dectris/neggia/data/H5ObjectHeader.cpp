@@ -3,7 +3,7 @@
 #include "H5ObjectHeader.h"
 #include <assert.h>
 #include <iostream>
-#include <stack>
+#include <mutex>
 #include <stdexcept>
 #ifdef DEBUG_PARSING
 #include <bitset>
@@ -16,21 +16,88 @@
 #include "H5LinkMsg.h"
 #endif
 
+namespace {
+
+/// Continuation blocks still to be parsed, last in first out. Headers rarely
+/// have more than a few of them, so they are kept on the stack unless there
+/// are very many.
+class ContinuationBlocks {
+public:
+    struct Block {
+        uint64_t addr;
+        uint64_t size;
+    };
+
+    ContinuationBlocks() : _size(0) {}
+    bool empty() const { return _size == 0; }
+    void push(uint64_t addr, uint64_t size) {
+        if (_size < MAX_ON_STACK)
+            _blocks[_size] = Block{addr, size};
+        else
+            _overflow.push_back(Block{addr, size});
+        ++_size;
+    }
+    Block pop() {
+        assert(_size > 0);
+        if (--_size < MAX_ON_STACK)
+            return _blocks[_size];
+        Block block = _overflow.back();
+        _overflow.pop_back();
+        return block;
+    }
+
+private:
+    constexpr static size_t MAX_ON_STACK = 8;
+    Block _blocks[MAX_ON_STACK];
+    std::vector<Block> _overflow;
+    size_t _size;
+};
+
+}  // namespace
+
 H5ObjectHeader::H5ObjectHeader(const char* fileAddress, size_t offset)
-      : H5Object(fileAddress, offset) {
-    _init();
+      : H5Object(fileAddress, offset) {}
+
+H5ObjectHeader::H5ObjectHeader(const H5Object& other) : H5Object(other) {}
+
+H5ObjectHeader::H5ObjectHeader(const H5ObjectHeader& other)
+      : H5Object(other) {
+    *this = other;
 }
 
-H5ObjectHeader::H5ObjectHeader(const H5Object& other) : H5Object(other) {
-    _init();
+H5ObjectHeader& H5ObjectHeader::operator=(const H5ObjectHeader& other) {
+    H5Object::operator=(other);
+    // an index that other is still building is not shared
+    const MessageIndex* index =
+            other._indexPointer.load(std::memory_order_acquire);
+    _index = index ? other._index : nullptr;
+    _indexPointer.store(index, std::memory_order_release);
+    return *this;
 }
 
 uint16_t H5ObjectHeader::numberOfMessages() const {
-    return _messages.size();
+    return _messageIndex().messages.size();
 }
 
 H5HeaderMessage H5ObjectHeader::headerMessage(int i) const {
-    return _messages.at(i);
+    return _messageIndex().messages.at(i);
+}
+
+const std::vector<H5HeaderMessage>& H5ObjectHeader::messagesOfType(
+        uint16_t type) const {
+    static const std::vector<H5HeaderMessage> noMessages;
+    const auto& messagesByType = _messageIndex().messagesByType;
+    auto messages = messagesByType.find(type);
+    return messages == messagesByType.end() ? noMessages : messages->second;
+}
+
+bool H5ObjectHeader::findMessage(uint16_t type,
+                                 H5HeaderMessage& message) const {
+    const auto& messages = messagesOfType(type);
+    if (messages.empty())
+        return false;
+    message = messages.front();
+    return true;
 }
 
 int H5ObjectHeader::version() const {
@@ -43,13 +110,34 @@ int H5ObjectHeader::version() const {
     throw std::runtime_error("could not determine version of H5ObjectHeader");
 }
 
-void H5ObjectHeader::_init() {
+const H5ObjectHeader::MessageIndex& H5ObjectHeader::_messageIndex() const {
+    const MessageIndex* built = _indexPointer.load(std::memory_order_acquire);
+    if (built)
+        return *built;
+    // headers are shared between threads, e.g. through Dataset; the lock is
+    // only taken until the index of a header has been built
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!_index) {
+        std::shared_ptr<MessageIndex> index(new MessageIndex);
+        forEachMessage([&index](const H5HeaderMessage& message) -> bool {
+            index->messages.push_back(message);
+            index->messagesByType[message.type].push_back(message);
+            return true;
+        });
+        _index = index;
+        _indexPointer.store(_index.get(), std::memory_order_release);
+    }
+    return *_index;
+}
+
+void H5ObjectHeader::_walk(VisitFunction visit, void* visitor) const {
     switch (version()) {
         case 1:
-            _initV1();
+            _walkV1(visit, visitor);
             break;
         case 2:
-            _initV2();
+            _walkV2(visit, visitor);
             break;
         default:
             throw std::runtime_error("Object Header version " +
@@ -58,16 +146,12 @@ void H5ObjectHeader::_init() {
     }
 }
 
-void H5ObjectHeader::_initV1() {
+bool H5ObjectHeader::_walkV1(VisitFunction visit, void* visitor) const {
     constexpr uint64_t INVALID_SIZE = 0xffffffffffffffff;
 
     size_t messageOffset = offset() + 16;  // 12(header data) + 4(alignment)
 
-    struct ContBlock {
-        uint64_t addr;
-        uint64_t size;
-    };
-    std::stack<ContBlock> continuationBlocks;
+    ContinuationBlocks continuationBlocks;
 
     uint16_t numberOfMessagesToParse = read_u16(2);
     uint64_t currentBlockSize = read_u32(8);
@@ -96,15 +180,16 @@ void H5ObjectHeader::_initV1() {
             auto contMsg = currentMessage.object;
             uint64_t cbl = contMsg.read_u64(0);
             if (cbl != INVALID_SIZE) {
-                continuationBlocks.push({cbl, contMsg.read_u64(8)});
+                continuationBlocks.push(cbl, contMsg.read_u64(8));
             }
         }
         assert(messageObject.read_u16(0) == currentMessage.type);
         assert(messageObject.read_u16(0) <= 0x18);
-        _messages.push_back(currentMessage);
 #ifdef DEBUG_PARSING
         _printMsgDebug(currentMessage);
 #endif
+        if (!visit(visitor, currentMessage))
+            return false;
         if (++messageId < numberOfMessagesToParse) {
             uint16_t size = messageSize + 8;
             currentMessageSize += size;
@@ -112,19 +197,20 @@ void H5ObjectHeader::_initV1() {
             if (currentMessageSize == currentBlockSize) {
                 currentMessageSize = 0;
                 assert(!continuationBlocks.empty());
-                messageOffset = continuationBlocks.top().addr;
-                currentBlockSize = continuationBlocks.top().size;
-                continuationBlocks.pop();
+                auto block = continuationBlocks.pop();
+                messageOffset = block.addr;
+                currentBlockSize = block.size;
             } else {
                 messageOffset += size;
             }
         } else {
-            break;
+            return true;
         }
     }
 }
 
-void H5ObjectHeader::_initV2() {
+bool H5ObjectHeader::_walkV2(VisitFunction visit, void* visitor) const {
+    constexpr uint64_t INVALID_OFFSET = 0xffffffffffffffff;
     uint8_t flags = read_u8(5);
     size_t skipOptionalBytes = 0;
     if (flags & (1 << 4)) {
@@ -161,54 +247,47 @@ void H5ObjectHeader::_initV2() {
               << chunk0Size << ", flags: 0b" << std::bitset<8>(flags) << "]"
               << std::dec << std::endl;
 #endif
-    _addBlockV2(currentOffset, chunk0Size, optionalBytesInMessageHeader);
-}
 
-void H5ObjectHeader::_addBlockV2(size_t currentOffset,
-                                 size_t blockSize,
-                                 size_t optionalBytesInMessageHeader) {
-    constexpr uint64_t INVALID_OFFSET = 0xffffffffffffffff;
-    struct ContBlock {
-        uint64_t addr;
-        uint64_t size;
-    };
-    std::stack<ContBlock> continuationBlocks;
-
-    size_t end_headers = currentOffset + blockSize;
-    while (currentOffset < end_headers) {
-        uint16_t messageType = read_u8(currentOffset);
-        uint16_t messageSize = read_u16(currentOffset + 1);
-        uint8_t messageFlags = read_u8(currentOffset + 3);
-        currentOffset += 4 + optionalBytesInMessageHeader;
-        auto currentMessage = H5HeaderMessage{
-                H5Object(fileAddress(), offset() + currentOffset), messageType};
-        _messages.push_back(currentMessage);
+    // the continuation blocks of a block are parsed depth first, directly
+    // after the block itself
+    ContinuationBlocks continuationBlocks;
+    size_t endOfBlock = currentOffset + chunk0Size;
+    while (true) {
+        while (currentOffset < endOfBlock) {
+            uint16_t messageType = read_u8(currentOffset);
+            uint16_t messageSize = read_u16(currentOffset + 1);
+            currentOffset += 4 + optionalBytesInMessageHeader;
+            auto currentMessage = H5HeaderMessage{
+                    H5Object(fileAddress(), offset() + currentOffset),
+                    messageType};
 #ifdef DEBUG_PARSING
-        _printMsgDebug(currentMessage);
+            _printMsgDebug(currentMessage);
 #endif
+            if (!visit(visitor, currentMessage))
+                return false;
 
-        currentOffset += messageSize;
-        if (currentMessage.type == 0x10) {
-            uint64_t addr = currentMessage.object.read_u64(0);
-            uint64_t size = currentMessage.object.read_u64(8);
-            if (addr != INVALID_OFFSET) {
-                continuationBlocks.push({addr, size});
+            currentOffset += messageSize;
+            if (currentMessage.type == 0x10) {
+                uint64_t addr = currentMessage.object.read_u64(0);
+                uint64_t size = currentMessage.object.read_u64(8);
+                if (addr != INVALID_OFFSET) {
+                    continuationBlocks.push(addr, size);
+                }
             }
         }
-    }
-    while (!continuationBlocks.empty()) {
+        if (continuationBlocks.empty())
+            return true;
 #ifdef DEBUG_PARSING
         std::cerr << " >> Add version 2 continuation block" << std::endl;
 #endif
+        auto block = continuationBlocks.pop();
         const char signatureContinuationBlockV2[] = "OCHK";
-        assert(std::string(&fileAddress()[continuationBlocks.top().addr], 4) ==
+        assert(std::string(&fileAddress()[block.addr], 4) ==
                std::string(signatureContinuationBlockV2));
-        size_t checkSumSize = 8;
+        size_t checkSumSize = 4;
         size_t signatureSize = 4;
-        size_t contOffset = continuationBlocks.top().addr + 4 - offset();
-        _addBlockV2(contOffset, continuationBlocks.top().size - checkSumSize,
-                    optionalBytesInMessageHeader);
-        continuationBlocks.pop();
+        currentOffset = block.addr + signatureSize - offset();
+        endOfBlock = currentOffset + block.size - signatureSize - checkSumSize;
     }
 }
 
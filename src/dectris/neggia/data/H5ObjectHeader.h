@@ -2,32 +2,64 @@
 
 #ifndef H5OBJECTHEADER_H
 #define H5OBJECTHEADER_H
+#include <atomic>
+#include <map>
+#include <memory>
 #include <vector>
 #include "H5HeaderMsg.h"
 
 /// https://support.hdfgroup.org/HDF5/doc/H5.format.html#ObjectHeaderPrefix
+///
+/// Messages are located on demand: constructing a header reads nothing.
+/// forEachMessage() walks the messages in place without allocating, the
+/// other accessors use an index by message type that is built on first use
+/// and shared by all copies of the header.
 
 class H5ObjectHeader : public H5Object {
 public:
     H5ObjectHeader() = default;
     H5ObjectHeader(const char* fileAddress, size_t offset);
     H5ObjectHeader(const H5Object& other);
+    H5ObjectHeader(const H5ObjectHeader& other);
+    H5ObjectHeader& operator=(const H5ObjectHeader& other);
     int version() const;
     uint16_t numberOfMessages() const;
     H5HeaderMessage headerMessage(int i) const;
 
+    /// Calls visitor(const H5HeaderMessage&) for every message in header
+    /// order, including those in continuation blocks, until it returns false.
+    template <class Visitor>
+    void forEachMessage(Visitor visitor) const {
+        _walk(&H5ObjectHeader::_callVisitor<Visitor>, &visitor);
+    }
+    /// All messages of the given type in header order
+    const std::vector<H5HeaderMessage>& messagesOfType(uint16_t type) const;
+    /// Finds the first message of the given type
+    bool findMessage(uint16_t type, H5HeaderMessage& message) const;
+
 private:
-    std::vector<H5HeaderMessage> _messages;
+    struct MessageIndex {
+        std::vector<H5HeaderMessage> messages;
+        std::map<uint16_t, std::vector<H5HeaderMessage>> messagesByType;
+    };
+    typedef bool (*VisitFunction)(void*, const H5HeaderMessage&);
 
-    void _init();
-    void _initV1();
-    void _initV2();
+    /// Owns the index once it has been built. Set only once, before
+    /// _indexPointer, and never changed afterwards.
+    mutable std::shared_ptr<const MessageIndex> _index;
+    /// Lets readers find the index without taking a lock
+    mutable std::atomic<const MessageIndex*> _indexPointer{nullptr};
 
-    void _addBlockV2(size_t currentOffset,
-                     size_t blockSize,
-                     size_t optionalBytesInMessageHeader);
+    template <class Visitor>
+    static bool _callVisitor(void* visitor, const H5HeaderMessage& message) {
+        return (*static_cast<Visitor*>(visitor))(message);
+    }
+    const MessageIndex& _messageIndex() const;
+    void _walk(VisitFunction visit, void* visitor) const;
+    bool _walkV1(VisitFunction visit, void* visitor) const;
+    bool _walkV2(VisitFunction visit, void* visitor) const;
 #ifdef DEBUG_PARSING
-    void _printMsgDebug(const H5HeaderMessage& msg);
+    static void _printMsgDebug(const H5HeaderMessage& msg);
 #endif
 };
 
@@ -2,26 +2,55 @@
 
 #include "H5Path.h"
 #include <assert.h>
-#include <sstream>
 
-H5Path::H5Path(const std::string& path)
-      : _isAbsolute(!path.empty() && path[0] == '/'),
-        _path(splitPathStringIntoComponents(path)) {}
+H5Path::H5Path() : _begin(0), _isAbsolute(false) {}
+
+H5Path::H5Path(const std::string& path) {
+    init(StringView(path));
+}
+
+H5Path::H5Path(const char* path) {
+    init(StringView(path));
+}
+
+H5Path::H5Path(const StringView& path) {
+    init(path);
+}
 
 H5Path::H5Path(const H5Path& other, H5Path::const_iterator start)
-      : _isAbsolute(false) {
-    for (; start != other.end(); ++start) {
-        _path.push_back(*start);
+      : _path(other._path), _begin(0), _isAbsolute(false) {
+    if (_path)
+        _begin = start.position() - _path->data();
+}
+
+void H5Path::init(const StringView& path) {
+    _begin = 0;
+    _isAbsolute = !path.empty() && path[0] == '/';
+    std::string canonicalPath(_isAbsolute ? "/" : "");
+    canonicalPath.reserve(path.size());
+    size_t componentStart = 0;
+    for (size_t i = 0; i <= path.size(); ++i) {
+        if (i < path.size() && path[i] != '/')
+            continue;
+        if (i > componentStart) {
+            if (canonicalPath.size() > (_isAbsolute ? 1 : 0))
+                canonicalPath += '/';
+            canonicalPath.append(path.data() + componentStart,
+                                 i - componentStart);
+        }
+        componentStart = i + 1;
     }
+    _path = std::make_shared<const std::string>(std::move(canonicalPath));
 }
 
 H5Path H5Path::operator+(const H5Path& other) const {
     assert(!other.isAbsolute());
-    H5Path returnValue(*this);
-    for (auto item : other) {
-        returnValue._path.push_back(item);
-    }
-    return returnValue;
+    if (view().empty())
+        return other;
+    std::string path(view().toString());
+    path += '/';
+    path.append(other.view().data(), other.view().size());
+    return H5Path(path);
 }
 
 bool H5Path::isAbsolute() const {
@@ -29,31 +58,26 @@ bool H5Path::isAbsolute() const {
 }
 
 H5Path::const_iterator H5Path::begin() const {
-    return _path.cbegin();
+    if (!_path)
+        return const_iterator();
+    const char* end = _path->data() + _path->size();
+    const char* begin = _path->data() + _begin + (_isAbsolute ? 1 : 0);
+    return const_iterator(std::min(begin, end), end);
 }
 
 H5Path::const_iterator H5Path::end() const {
-    return _path.cend();
+    if (!_path)
+        return const_iterator();
+    const char* end = _path->data() + _path->size();
+    return const_iterator(end, end);
 }
 
-H5Path::operator std::string() const {
-    std::string returnValue(_isAbsolute ? "/" : "");
-    if (_path.size() > 0) {
-        for (size_t i = 0; i < _path.size() - 1; ++i)
-            returnValue += _path[i] + "/";
-        returnValue += _path[_path.size() - 1];
-    }
-    return returnValue;
+StringView H5Path::view() const {
+    if (!_path)
+        return StringView();
+    return StringView(_path->data() + _begin, _path->size() - _begin);
 }
 
-std::vector<std::string> H5Path::splitPathStringIntoComponents(
-        const std::string& path) const {
-    std::stringstream pathStream(path);
-    std::string item;
-    std::vector<std::string> returnValue;
-    while (std::getline(pathStream, item, '/')) {
-        if (!item.empty())
-            returnValue.push_back(item);
-    }
-    return returnValue;
+H5Path::operator std::string() const {
+    return view().toString();
 }
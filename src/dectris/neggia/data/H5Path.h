@@ -2,25 +2,78 @@
 
 #ifndef H5PATH_H
 #define H5PATH_H
+#include <iterator>
+#include <memory>
 #include <string>
-#include <vector>
+#include "StringView.h"
+
+/// A path within a file, stored once in canonical form ("/a/b" or "a/b").
+/// Its components are views into that string, and paths made of the
+/// trailing components of another path share its storage, so that walking
+/// a path does not allocate.
 
 class H5Path {
 public:
-    using const_iterator = std::vector<std::string>::const_iterator;
+    class const_iterator
+          : public std::iterator<std::forward_iterator_tag, StringView> {
+    public:
+        const_iterator() : _position(nullptr), _end(nullptr) {}
+        const_iterator(const char* position, const char* end)
+              : _position(position), _end(end) {}
+        StringView operator*() const {
+            return StringView(_position, componentLength());
+        }
+        const_iterator& operator++() {
+            _position += componentLength();
+            if (_position != _end)
+                ++_position;  // separator
+            return *this;
+        }
+        const_iterator operator+(size_t n) const {
+            const_iterator result(*this);
+            while (n-- > 0)
+                ++result;
+            return result;
+        }
+        bool operator==(const const_iterator& other) const {
+            return _position == other._position;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return _position != other._position;
+        }
+        const char* position() const { return _position; }
+
+    private:
+        size_t componentLength() const {
+            const char* separator = _position;
+            while (separator != _end && *separator != '/')
+                ++separator;
+            return separator - _position;
+        }
 
+        const char* _position;
+        const char* _end;
+    };
+
+    H5Path();
     H5Path(const std::string& path);
+    H5Path(const char* path);
+    explicit H5Path(const StringView& path);
     H5Path(const H5Path& other, const_iterator start);
     H5Path operator+(const H5Path& other) const;
     bool isAbsolute() const;
     operator std::string() const;
+    /// The canonical form of the path, valid as long as the path exists
+    StringView view() const;
     const_iterator begin() const;
     const_iterator end() const;
 
 private:
-    std::vector<std::string> splitPathStringIntoComponents(
-            const std::string& path) const;
-    std::vector<std::string> _path;
+    void init(const StringView& path);
+
+    /// may start with components not part of this path (see _begin)
+    std::shared_ptr<const std::string> _path;
+    size_t _begin;
     bool _isAbsolute;
 };
 
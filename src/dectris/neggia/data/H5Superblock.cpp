@@ -12,26 +12,59 @@
 #include <iostream>
 #endif
 
-H5Superblock::H5Superblock(const char* fileAddress) : H5Object(fileAddress, 0) {
+H5Superblock::H5Superblock(const char* fileAddress,
+                           H5MetadataCache* cache,
+                           bool acceptSwmrWriter)
+      : H5Object(fileAddress, 0),
+        _cache(cache),
+        _acceptSwmrWriter(acceptSwmrWriter) {
     const char magicNumber[] = "\211HDF\r\n\032\n";
     assert(std::string(fileAddress, 8) == std::string(magicNumber));
 }
 
+constexpr uint8_t H5Superblock::WRITE_ACCESS;
+constexpr uint8_t H5Superblock::SWMR_WRITE_ACCESS;
+
 uint8_t H5Superblock::version() const {
     return read_u8(8);
 }
 
+uint64_t H5Superblock::endOfFileAddress() const {
+    switch (version()) {
+        case 0:
+            return read_u64(40);
+        case 2:
+        case 3:
+            return read_u64(28);
+        default:
+            throw std::runtime_error("superblock version " +
+                                     std::to_string(version()) +
+                                     " not supported.");
+    }
+}
+
+uint8_t H5Superblock::fileConsistencyFlags() const {
+    return version() == 3 ? read_u8(11) : 0;
+}
+
 ResolvedPath H5Superblock::resolve(const H5Path& path) {
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
+}
+
+bool H5Superblock::tryResolve(const H5Path& path, ResolvedPath& resolvedPath) {
 #ifdef DEBUG_PARSING
     std::cerr << ">>> superblock version " << (int)version() << " resolving "
               << std::string(path) << "\n";
 #endif
     switch (version()) {
         case 0:
-            return resolveV0(path);
+            return tryResolveV0(path, resolvedPath);
         case 2:
         case 3:
-            return resolveV2(path);
+            return tryResolveV2(path, resolvedPath);
         default:
             throw std::runtime_error("superblock version " +
                                      std::to_string(version()) +
@@ -39,7 +72,8 @@ ResolvedPath H5Superblock::resolve(const H5Path& path) {
     }
 }
 
-ResolvedPath H5Superblock::resolveV0(const H5Path& path) {
+bool H5Superblock::tryResolveV0(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
     // verify header information
     int offsetSize = (int)fileAddress()[13];
     assert(offsetSize == 8);
@@ -51,26 +85,32 @@ ResolvedPath H5Superblock::resolveV0(const H5Path& path) {
     uint64_t DriverInformationBlockAddress =
             *(uint64_t*)(fileAddress() + 24 + 3 * offsetSize);
     assert(DriverInformationBlockAddress == H5_INVALID_ADDRESS);
-    return PathResolverV0(H5SymbolTableEntry(at(24 + 4 * 8))).resolve(path);
+    return PathResolverV0(H5SymbolTableEntry(at(24 + 4 * 8)), _cache)
+            .tryResolve(path, resolvedPath);
 }
 
-ResolvedPath H5Superblock::resolveV2(const H5Path& path) {
+bool H5Superblock::tryResolveV2(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
     // verify header information
     int offsetSize = (int)fileAddress()[9];
     assert(offsetSize == 8);
     int offsetLength = (int)fileAddress()[10];
     assert(offsetLength == 8);
-    if (version() == 3) {
-        // we need to check that the file is not open for write access
-        uint8_t fileConsistencyFlags = (uint8_t)fileAddress()[11];
-        if ((fileConsistencyFlags & 5) > 0)
-            throw std::runtime_error("file opened for write access");
+    // a file open for write access may only be read if asked for and while
+    // its writer keeps it consistent for readers (single writer, multiple
+    // readers)
+    uint8_t flags = fileConsistencyFlags();
+    if ((flags & WRITE_ACCESS) &&
+        !(_acceptSwmrWriter && (flags & SWMR_WRITE_ACCESS)))
+    {
+        throw std::runtime_error("file opened for write access");
     }
     uint64_t baseAddress = *(uint64_t*)(fileAddress() + 12);
     assert(baseAddress == 0);
     uint64_t extensionAddress = *(uint64_t*)(fileAddress() + 20);
     assert(extensionAddress == H5_INVALID_ADDRESS);
     uint64_t rootGroupHeaderOffset = *(uint64_t*)(fileAddress() + 36);
-    return PathResolverV2(H5ObjectHeader(fileAddress(), rootGroupHeaderOffset))
-            .resolve(path);
+    return PathResolverV2(H5ObjectHeader(fileAddress(), rootGroupHeaderOffset),
+                          _cache)
+            .tryResolve(path, resolvedPath);
 }
@@ -2,6 +2,7 @@
 
 #ifndef H5SUPERBLOCK_H
 #define H5SUPERBLOCK_H
+#include "H5MetadataCache.h"
 #include "H5Object.h"
 #include "H5SymbolTableEntry.h"
 #include "ResolvedPath.h"
@@ -11,14 +12,37 @@
 class H5Superblock : public H5Object {
 public:
     H5Superblock() = default;
-    H5Superblock(const char* fileAddress);
+    /// If cache is given, resolve() looks up and stores resolved groups and
+    /// paths in it. The cache must belong to the same file. resolve()
+    /// throws std::runtime_error for files that a writer has open, unless
+    /// acceptSwmrWriter is set and the writer keeps the file readable.
+    H5Superblock(const char* fileAddress,
+                 H5MetadataCache* cache = nullptr,
+                 bool acceptSwmrWriter = false);
     uint8_t version() const;
+    /// Size of the file according to the superblock. Throws
+    /// std::runtime_error for unsupported superblock versions.
+    uint64_t endOfFileAddress() const;
+    /// The file consistency flags of superblock version 3, 0 for older
+    /// versions
+    uint8_t fileConsistencyFlags() const;
 
+    /// the writer has the file open
+    constexpr static uint8_t WRITE_ACCESS = 0x1;
+    /// the writer keeps the file readable while writing to it (SWMR)
+    constexpr static uint8_t SWMR_WRITE_ACCESS = 0x4;
+
+    /// Throws std::out_of_range if path does not exist
     ResolvedPath resolve(const H5Path& path);
+    /// Returns false if path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
-    ResolvedPath resolveV0(const H5Path& path);
-    ResolvedPath resolveV2(const H5Path& path);
+    H5MetadataCache* _cache = nullptr;
+    bool _acceptSwmrWriter = false;
+
+    bool tryResolveV0(const H5Path& path, ResolvedPath& resolvedPath);
+    bool tryResolveV2(const H5Path& path, ResolvedPath& resolvedPath);
 };
 
 #endif  // H5SUPERBLOCK_H
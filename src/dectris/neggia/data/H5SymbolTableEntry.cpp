@@ -51,47 +51,53 @@ uint32_t H5SymbolTableEntry::getOffsetToLinkValue() const {
     return scratchSpace().read_u32(0);
 }
 
-H5SymbolTableEntry H5SymbolTableEntry::find(const std::string& entry) const {
+H5SymbolTableEntry H5SymbolTableEntry::find(const StringView& entry) const {
+    H5SymbolTableEntry found;
+    if (!tryFind(entry, found))
+        throw std::out_of_range("Not found");
+    return found;
+}
+
+bool H5SymbolTableEntry::tryFind(const StringView& entry,
+                                 H5SymbolTableEntry& found) const {
     assert(cacheType() == 1);  // makes sense only for groups
 
     H5BLinkNode bTree(fileAddress(), scratchSpace().read_i64(0));
     assert(bTree.nodeType() == 0);
     H5LocalHeap treeHeap(fileAddress(), scratchSpace().read_i64(8));
     while (bTree.nodeLevel() > 0) {
-        bool found = false;
+        bool foundChild = false;
         for (int i = 1; i <= bTree.entriesUsed(); ++i) {
             size_t off = bTree.key(i).read_u64(0);
-            std::string key = std::string(treeHeap.data(off));
-            if (entry <= key) {
+            if (entry.compare(treeHeap.data(off)) <= 0) {
                 bTree = bTree.child(i - 1);
-                found = true;
+                foundChild = true;
                 break;
             }
         }
-        if (!found)
-            throw std::runtime_error("Not found");
+        if (!foundChild)
+            return false;
     }
 
     {
         int i;
         for (i = 1; i <= bTree.entriesUsed(); ++i) {
             size_t off = bTree.key(i).read_u64(0);
-            std::string key = std::string(treeHeap.data(off));
-            if (entry <= key) {
+            if (entry.compare(treeHeap.data(off)) <= 0) {
                 break;
             }
         }
         if (i > bTree.entriesUsed())
-            throw std::out_of_range("Not found");
+            return false;
         H5SymbolTableNode symbolTableNode(bTree.child(i - 1));
         for (i = 0; i < symbolTableNode.numberOfSymbols(); ++i) {
             H5SymbolTableEntry retVal(symbolTableNode.entry(i));
             size_t off = retVal.linkNameOffset();
-            std::string key = std::string(treeHeap.data(off));
-            if (key == entry) {
-                return retVal;
+            if (entry == treeHeap.data(off)) {
+                found = retVal;
+                return true;
             }
         }
-        throw std::out_of_range("Not found");
+        return false;
     }
 }
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include "H5ObjectHeader.h"
+#include "StringView.h"
 
 /// See https://www.hdfgroup.org/HDF5/doc/H5.format.html#SymbolTableEntry
 
@@ -22,7 +23,10 @@ public:
     uint64_t getAddressOfBTree() const;
     uint64_t getAddressOfHeap() const;
     uint32_t getOffsetToLinkValue() const;
-    H5SymbolTableEntry find(const std::string& entry) const;
+    /// Throws std::out_of_range if the group has no such entry
+    H5SymbolTableEntry find(const StringView& entry) const;
+    /// Returns false if the group has no such entry
+    bool tryFind(const StringView& entry, H5SymbolTableEntry& found) const;
 };
 
 #endif  // H5SYMBOLTABLEENTRY_H
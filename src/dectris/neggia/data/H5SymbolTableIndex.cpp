@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+
+#include "H5SymbolTableIndex.h"
+#include <assert.h>
+#include "H5SymbolTableNode.h"
+
+H5SymbolTableIndex::H5SymbolTableIndex(const H5SymbolTableEntry& group)
+      : _fileAddress(group.fileAddress()) {
+    assert(group.cacheType() == H5SymbolTableEntry::GROUP);
+    H5BLinkNode bTree(_fileAddress, group.getAddressOfBTree());
+    H5LocalHeap heap(_fileAddress, group.getAddressOfHeap());
+    addEntries(bTree, heap);
+}
+
+bool H5SymbolTableIndex::find(const StringView& name,
+                              H5SymbolTableEntry& entry) const {
+    auto found = _entries.find(name);
+    if (found == _entries.end())
+        return false;
+    entry = H5SymbolTableEntry(_fileAddress, found->second);
+    return true;
+}
+
+void H5SymbolTableIndex::addEntries(const H5BLinkNode& node,
+                                    const H5LocalHeap& heap) {
+    assert(node.nodeType() == 0);
+    for (int i = 0; i < node.entriesUsed(); ++i) {
+        if (node.nodeLevel() > 0) {
+            addEntries(H5BLinkNode(node.child(i)), heap);
+            continue;
+        }
+        H5SymbolTableNode symbolTableNode(node.child(i));
+        for (int j = 0; j < symbolTableNode.numberOfSymbols(); ++j) {
+            H5SymbolTableEntry entry(symbolTableNode.entry(j));
+            _entries.emplace(StringView(heap.data(entry.linkNameOffset())),
+                             entry.offset());
+        }
+    }
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef H5SYMBOLTABLEINDEX_H
+#define H5SYMBOLTABLEINDEX_H
+#include <unordered_map>
+#include "H5BLinkNode.h"
+#include "H5LocalHeap.h"
+#include "H5SymbolTableEntry.h"
+#include "StringView.h"
+
+/// Maps the names of all entries of a group stored as a symbol table
+/// (superblock version 0) to their symbol table entries, built in one walk
+/// over the v1 B-tree. The names are views into the local heap of the group
+/// and are only valid as long as the file stays mapped.
+
+class H5SymbolTableIndex {
+public:
+    H5SymbolTableIndex() = default;
+    explicit H5SymbolTableIndex(const H5SymbolTableEntry& group);
+    /// Returns false if the group has no entry with this name
+    bool find(const StringView& name, H5SymbolTableEntry& entry) const;
+    size_t size() const { return _entries.size(); }
+
+private:
+    void addEntries(const H5BLinkNode& node, const H5LocalHeap& heap);
+
+    const char* _fileAddress = nullptr;
+    /// offsets of the symbol table entries by name
+    std::unordered_map<StringView, size_t, StringViewHash> _entries;
+};
+
+#endif  // H5SYMBOLTABLEINDEX_H
@@ -148,6 +148,6 @@ done:
     return c;
 }
 
-uint32_t JenkinsLookup3Checksum(const std::string& str, uint32_t initval) {
-    return H5_checksum_lookup3(str.data(), str.length(), initval);
+uint32_t JenkinsLookup3Checksum(const StringView& str, uint32_t initval) {
+    return H5_checksum_lookup3(str.data(), str.size(), initval);
 }
@@ -3,8 +3,8 @@
 #ifndef JENKINSLOOKUP3CHECKSUM_H
 #define JENKINSLOOKUP3CHECKSUM_H
 #include <stdint.h>
-#include <string>
+#include "StringView.h"
 
-uint32_t JenkinsLookup3Checksum(const std::string& str, uint32_t initval = 0);
+uint32_t JenkinsLookup3Checksum(const StringView& str, uint32_t initval = 0);
 
 #endif  // JENKINSLOOKUP3CHECKSUM_H
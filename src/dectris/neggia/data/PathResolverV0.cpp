@@ -4,20 +4,61 @@
 #include <assert.h>
 #include <memory>
 #include <stdexcept>
-#include "H5BTreeVersion2.h"
-#include "H5FractalHeap.h"
+#include "H5DenseLinks.h"
 #include "H5LocalHeap.h"
 #include "constants.h"
 
-PathResolverV0::PathResolverV0(const H5SymbolTableEntry& root) : _root(root) {}
+PathResolverV0::PathResolverV0(const H5SymbolTableEntry& root,
+                               H5MetadataCache* cache)
+      : _root(root), _cache(cache) {}
 
 ResolvedPath PathResolverV0::resolve(const H5Path& path) {
-    return resolvePathInSymbolTableEntry(_root, path);
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
 }
 
-ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
+bool PathResolverV0::tryResolve(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
+    if (!_cache || !path.isAbsolute()) {
+        return resolvePathInSymbolTableEntry(_root, path, StringView(),
+                                             resolvedPath);
+    }
+    StringView pathString = path.view();
+    if (_cache->findResolvedPath(pathString, resolvedPath))
+        return true;
+    size_t groupOffset;
+    StringView groupPath;
+    size_t depth = _cache->findDeepestGroup(path, groupOffset, groupPath);
+    bool found;
+    if (depth > 0) {
+        found = resolvePathInSymbolTableEntry(
+                H5SymbolTableEntry(_root.fileAddress(), groupOffset),
+                H5Path(path, path.begin() + depth), groupPath, resolvedPath);
+    } else {
+        found = resolvePathInSymbolTableEntry(_root, path, "/", resolvedPath);
+    }
+    if (found)
+        _cache->addResolvedPath(pathString, resolvedPath);
+    return found;
+}
+
+bool PathResolverV0::findEntry(const H5SymbolTableEntry& group,
+                               const StringView& name,
+                               H5SymbolTableEntry& entry) const {
+    if (_cache)
+        return _cache->symbolTableIndex(group)->find(name, entry);
+    return group.tryFind(name, entry);
+}
+
+/// inPath is the absolute path of in if known, used to cache the groups on
+/// the way
+bool PathResolverV0::resolvePathInSymbolTableEntry(
         const H5SymbolTableEntry& in,
-        const H5Path& path) {
+        const H5Path& path,
+        const StringView& inPath,
+        ResolvedPath& resolvedPath) {
     assert(in.cacheType() == H5SymbolTableEntry::DATA ||
            in.cacheType() ==
                    H5SymbolTableEntry::GROUP);  // makes sense only for groups
@@ -25,6 +66,9 @@ ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
                                                 // links via objectheader (cache
                                                 // type = 0, 1)
     H5SymbolTableEntry parentEntry(path.isAbsolute() ? _root : in);
+    std::string groupPath;
+    if (_cache)
+        groupPath = path.isAbsolute() ? "/" : inPath.toString();
 
     for (auto itemIterator = path.begin(); itemIterator != path.end();
          ++itemIterator)
@@ -32,103 +76,102 @@ ResolvedPath PathResolverV0::resolvePathInSymbolTableEntry(
         auto item = *itemIterator;
         if (parentEntry.cacheType() == H5SymbolTableEntry::GROUP) {
             H5SymbolTableEntry stEntry;
-            try {
-                stEntry = parentEntry.find(item);
-            } catch (const std::out_of_range&) {
+            if (!findEntry(parentEntry, item, stEntry)) {
                 return findPathInObjectHeader(parentEntry, item,
-                                              H5Path(path, itemIterator + 1));
+                                              H5Path(path, itemIterator + 1),
+                                              resolvedPath);
             }
             if (stEntry.cacheType() == H5SymbolTableEntry::LINK) {
                 return findPathInScratchSpace(parentEntry, stEntry,
-                                              H5Path(path, itemIterator + 1));
+                                              H5Path(path, itemIterator + 1),
+                                              resolvedPath);
             } else {
                 parentEntry = stEntry;
+                if (_cache) {
+                    groupPath = H5MetadataCache::childPath(groupPath, item);
+                    if (!groupPath.empty() &&
+                        parentEntry.cacheType() == H5SymbolTableEntry::GROUP)
+                    {
+                        _cache->addGroup(groupPath, parentEntry.offset());
+                    }
+                }
                 continue;
             }
         } else {
             throw std::runtime_error(
-                    "Expected GROUP (cache_type = 1) at path item " + item);
+                    "Expected GROUP (cache_type = 1) at path item " +
+                    item.toString());
         }
     }
-    auto output = ResolvedPath{};
-    output.objectHeader = parentEntry.objectHeader();
-    return output;
+    resolvedPath = ResolvedPath{};
+    resolvedPath.objectHeader = parentEntry.objectHeader();
+    return true;
 }
 
-ResolvedPath PathResolverV0::findPathInScratchSpace(
-        H5SymbolTableEntry parentEntry,
-        H5SymbolTableEntry symbolTableEntry,
-        const H5Path& remainingPath) {
+bool PathResolverV0::findPathInScratchSpace(H5SymbolTableEntry parentEntry,
+                                            H5SymbolTableEntry symbolTableEntry,
+                                            const H5Path& remainingPath,
+                                            ResolvedPath& resolvedPath) {
     size_t targetNameOffset = symbolTableEntry.getOffsetToLinkValue();
     H5LocalHeap treeHeap =
             H5Object(_root.fileAddress(), parentEntry.getAddressOfHeap());
     H5Path targetPath(treeHeap.data(targetNameOffset));
     return resolvePathInSymbolTableEntry(parentEntry,
-                                         targetPath + remainingPath);
+                                         targetPath + remainingPath,
+                                         StringView(), resolvedPath);
 }
 
-ResolvedPath PathResolverV0::findPathInLinkMsg(
-        const H5SymbolTableEntry& parentEntry,
-        const H5LinkMsg& linkMsg,
-        const H5Path& remainingPath) {
+bool PathResolverV0::findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
+                                       const H5LinkMsg& linkMsg,
+                                       const H5Path& remainingPath,
+                                       ResolvedPath& resolvedPath) {
     if (linkMsg.linkType() == H5LinkMsg::SOFT) {
         H5Path targetPath(linkMsg.targetPath());
         return resolvePathInSymbolTableEntry(parentEntry,
-                                             targetPath + remainingPath);
+                                             targetPath + remainingPath,
+                                             StringView(), resolvedPath);
     } else if (linkMsg.linkType() == H5LinkMsg::EXTERNAL) {
-        std::string targetFile = linkMsg.targetFile();
         H5Path targetPath(linkMsg.targetPath());
-        auto output = ResolvedPath{};
-        output.externalFile.reset(new ResolvedPath::ExternalFile{
-                targetFile, targetPath + remainingPath});
-        return output;
+        resolvedPath = ResolvedPath{};
+        resolvedPath.externalFile.filename = linkMsg.targetFile();
+        resolvedPath.externalFile.h5Path = targetPath + remainingPath;
+        return true;
     }
     throw std::runtime_error("unknown link type" +
                              std::to_string(linkMsg.linkType()));
 }
 
-uint32_t PathResolverV0::getFractalHeapOffset(
-        const H5LinkInfoMsg& linkInfoMsg,
-        const std::string& pathItem) const {
-    size_t btreeAddress = linkInfoMsg.getBTreeAddress();
-    if (btreeAddress == H5_INVALID_ADDRESS) {
-        throw std::out_of_range("Invalid address");
-    }
-    H5BTreeVersion2 btree(_root.fileAddress(), btreeAddress);
-    H5Object heapRecord(_root.fileAddress(),
-                        btree.getLinkAddressByName(pathItem));
-    return heapRecord.read_u32(5);
-}
-
-ResolvedPath PathResolverV0::findPathInObjectHeader(
+bool PathResolverV0::findPathInObjectHeader(
         const H5SymbolTableEntry& parentEntry,
-        const std::string pathItem,
-        const H5Path& remainingPath) {
+        const StringView& pathItem,
+        const H5Path& remainingPath,
+        ResolvedPath& resolvedPath) {
+    bool found = false;
     H5ObjectHeader objectHeader = parentEntry.objectHeader();
-    for (size_t i = 0; i < objectHeader.numberOfMessages(); ++i) {
-        auto msg = objectHeader.headerMessage(i);
+    objectHeader.forEachMessage([&](const H5HeaderMessage& msg) -> bool {
         switch (msg.type) {
             case H5LinkMsg::TYPE_ID: {
+                if (!H5LinkMsg::hasLinkName(msg.object, pathItem))
+                    return true;
                 H5LinkMsg linkMsg(msg.object);
-                if (linkMsg.linkName() != pathItem)
-                    continue;
-                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                found = findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                          resolvedPath);
+                return false;
             }
             case H5LinkInfoMsg::TYPE_ID: {
-                uint32_t heapOffset;
-                H5LinkInfoMsg linkInfoMsg(msg.object);
-                try {
-                    heapOffset = getFractalHeapOffset(linkInfoMsg, pathItem);
-                } catch (const std::out_of_range&) {
-                    continue;
+                H5LinkMsg linkMsg;
+                if (!findDenseLinkMsg(H5LinkInfoMsg(msg.object), pathItem,
+                                      _cache, linkMsg))
+                {
+                    return true;
                 }
-                H5FractalHeap fractalHeap(_root.fileAddress(),
-                                          linkInfoMsg.getFractalHeapAddress());
-                H5LinkMsg linkMsg(fractalHeap.getHeapObject(heapOffset));
                 assert(linkMsg.linkName() == pathItem);
-                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                found = findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                          resolvedPath);
+                return false;
             }
         }
-    }
-    throw std::out_of_range("could not find " + pathItem);
+        return true;
+    });
+    return found;
 }
@@ -4,31 +4,44 @@
 #define PATH_RESOLVER_V0_H
 #include "H5LinkInfoMessage.h"
 #include "H5LinkMsg.h"
+#include "H5MetadataCache.h"
 #include "H5Path.h"
 #include "H5SymbolTableEntry.h"
 #include "ResolvedPath.h"
+#include "StringView.h"
 
 class PathResolverV0 {
 public:
-    PathResolverV0(const H5SymbolTableEntry& root);
+    PathResolverV0(const H5SymbolTableEntry& root,
+                   H5MetadataCache* cache = nullptr);
+    /// Throws std::out_of_range if path does not exist
     ResolvedPath resolve(const H5Path& path);
+    /// Returns false if path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
     const H5SymbolTableEntry _root;
+    H5MetadataCache* const _cache;
 
-    ResolvedPath findPathInObjectHeader(const H5SymbolTableEntry& parentEntry,
-                                        const std::string pathItem,
-                                        const H5Path& remainingPath);
-    uint32_t getFractalHeapOffset(const H5LinkInfoMsg& linkInfoMsg,
-                                  const std::string& pathItem) const;
-    ResolvedPath findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
-                                   const H5LinkMsg& linkMsg,
-                                   const H5Path& remainingPath);
-    ResolvedPath findPathInScratchSpace(H5SymbolTableEntry parentEntry,
-                                        H5SymbolTableEntry symbolTableEntry,
-                                        const H5Path& remainingPath);
-    ResolvedPath resolvePathInSymbolTableEntry(const H5SymbolTableEntry& in,
-                                               const H5Path& path);
+    bool findEntry(const H5SymbolTableEntry& group,
+                   const StringView& name,
+                   H5SymbolTableEntry& entry) const;
+    bool findPathInObjectHeader(const H5SymbolTableEntry& parentEntry,
+                                const StringView& pathItem,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
+    bool findPathInLinkMsg(const H5SymbolTableEntry& parentEntry,
+                           const H5LinkMsg& linkMsg,
+                           const H5Path& remainingPath,
+                           ResolvedPath& resolvedPath);
+    bool findPathInScratchSpace(H5SymbolTableEntry parentEntry,
+                                H5SymbolTableEntry symbolTableEntry,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
+    bool resolvePathInSymbolTableEntry(const H5SymbolTableEntry& in,
+                                       const H5Path& path,
+                                       const StringView& inPath,
+                                       ResolvedPath& resolvedPath);
 };
 
 #endif  // PATH_RESOLVER_V1_H
@@ -3,56 +3,98 @@
 #include "PathResolverV2.h"
 #include <assert.h>
 #include <memory>
-#include "H5BTreeVersion2.h"
-#include "H5FractalHeap.h"
+#include "H5DenseLinks.h"
 #include "H5LocalHeap.h"
 #include "constants.h"
 
 #include <iostream>
 
-PathResolverV2::PathResolverV2(const H5ObjectHeader& root) : _root(root) {}
+PathResolverV2::PathResolverV2(const H5ObjectHeader& root,
+                               H5MetadataCache* cache)
+      : _root(root), _cache(cache) {}
 
 ResolvedPath PathResolverV2::resolve(const H5Path& path) {
-    return resolvePathInHeader(_root, path);
+    ResolvedPath resolvedPath;
+    if (!tryResolve(path, resolvedPath))
+        throw std::out_of_range("could not find " + std::string(path));
+    return resolvedPath;
 }
 
-ResolvedPath PathResolverV2::resolvePathInHeader(const H5ObjectHeader& in,
-                                                 const H5Path& path) {
+bool PathResolverV2::tryResolve(const H5Path& path,
+                                ResolvedPath& resolvedPath) {
+    if (!_cache || !path.isAbsolute())
+        return resolvePathInHeader(_root, path, StringView(), resolvedPath);
+    StringView pathString = path.view();
+    if (_cache->findResolvedPath(pathString, resolvedPath))
+        return true;
+    size_t groupOffset;
+    StringView groupPath;
+    size_t depth = _cache->findDeepestGroup(path, groupOffset, groupPath);
+    bool found;
+    if (depth > 0) {
+        found = resolvePathInHeader(
+                H5ObjectHeader(_root.fileAddress(), groupOffset),
+                H5Path(path, path.begin() + depth), groupPath, resolvedPath);
+    } else {
+        found = resolvePathInHeader(_root, path, "/", resolvedPath);
+    }
+    if (found)
+        _cache->addResolvedPath(pathString, resolvedPath);
+    return found;
+}
+
+/// inPath is the absolute path of in if known, used to cache the groups on
+/// the way
+bool PathResolverV2::resolvePathInHeader(const H5ObjectHeader& in,
+                                         const H5Path& path,
+                                         const StringView& inPath,
+                                         ResolvedPath& resolvedPath) {
     H5ObjectHeader parentEntry(path.isAbsolute() ? _root : in);
+    std::string groupPath;
+    if (_cache)
+        groupPath = path.isAbsolute() ? "/" : inPath.toString();
     for (auto itemIterator = path.begin(); itemIterator != path.end();
          ++itemIterator)
     {
-        auto resolvedPath = findPathInObjectHeader(
-                parentEntry, *itemIterator, H5Path(path, itemIterator + 1));
+        if (!findPathInObjectHeader(parentEntry, *itemIterator,
+                                    H5Path(path, itemIterator + 1),
+                                    resolvedPath))
+        {
+            return false;
+        }
         if (resolvedPath.externalFile) {
             // the object is in a different file which must be opened by
             // upper layer
-            return resolvedPath;
+            return true;
         }
         if ((itemIterator + 1) == path.end()) {
-            return resolvedPath;
+            return true;
         }
         parentEntry = resolvedPath.objectHeader;
+        if (_cache) {
+            groupPath = H5MetadataCache::childPath(groupPath, *itemIterator);
+            if (!groupPath.empty())
+                _cache->addGroup(groupPath, parentEntry.offset());
+        }
     }
-    return ResolvedPath{parentEntry, {}};
+    resolvedPath = ResolvedPath{parentEntry, {}};
+    return true;
 }
 
-ResolvedPath PathResolverV2::findPathInLinkMsg(
-        const H5ObjectHeader& parentEntry,
-        const H5LinkMsg& linkMsg,
-        const H5Path& remainingPath) {
+bool PathResolverV2::findPathInLinkMsg(const H5ObjectHeader& parentEntry,
+                                       const H5LinkMsg& linkMsg,
+                                       const H5Path& remainingPath,
+                                       ResolvedPath& resolvedPath) {
     switch (linkMsg.linkType()) {
         case H5LinkMsg::HARD: {
-            return ResolvedPath{linkMsg.hardLinkObjectHeader(), {}};
+            resolvedPath = ResolvedPath{linkMsg.hardLinkObjectHeader(), {}};
+            return true;
         }
         case H5LinkMsg::EXTERNAL: {
-            std::string targetFile = linkMsg.targetFile();
             H5Path targetPath(linkMsg.targetPath());
-            return ResolvedPath{
-                    {},
-                    std::unique_ptr<ResolvedPath::ExternalFile>{
-                            new ResolvedPath::ExternalFile{
-                                    targetFile, targetPath + remainingPath}}};
+            resolvedPath = ResolvedPath{
+                    {}, {linkMsg.targetFile(), targetPath + remainingPath}};
+            return true;
         }
         default:
             throw std::runtime_error("unknown link type " +
@@ -60,47 +102,35 @@ ResolvedPath PathResolverV2::findPathInLinkMsg(
     }
 }
 
-uint32_t PathResolverV2::getFractalHeapOffset(
-        const H5LinkInfoMsg& linkInfoMsg,
-        const std::string& pathItem) const {
-    size_t btreeAddress = linkInfoMsg.getBTreeAddress();
-    if (btreeAddress == H5_INVALID_ADDRESS) {
-        throw std::out_of_range("Invalid address");
-    }
-    H5BTreeVersion2 btree(_root.fileAddress(), btreeAddress);
-    H5Object heapRecord(_root.fileAddress(),
-                        btree.getLinkAddressByName(pathItem));
-    return heapRecord.read_u32(5);
-}
-
-ResolvedPath PathResolverV2::findPathInObjectHeader(
-        const H5ObjectHeader& parentEntry,
-        const std::string pathItem,
-        const H5Path& remainingPath) {
-    for (size_t i = 0; i < parentEntry.numberOfMessages(); ++i) {
-        auto msg = parentEntry.headerMessage(i);
+bool PathResolverV2::findPathInObjectHeader(const H5ObjectHeader& parentEntry,
+                                            const StringView& pathItem,
+                                            const H5Path& remainingPath,
+                                            ResolvedPath& resolvedPath) {
+    bool found = false;
+    parentEntry.forEachMessage([&](const H5HeaderMessage& msg) -> bool {
         switch (msg.type) {
             case H5LinkMsg::TYPE_ID: {
+                if (!H5LinkMsg::hasLinkName(msg.object, pathItem))
+                    return true;
                 H5LinkMsg linkMsg(msg.object);
-                if (linkMsg.linkName() != pathItem)
-                    continue;
-                return findPathInLinkMsg(parentEntry, linkMsg, remainingPath);
+                found = findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                          resolvedPath);
+                return false;
             }
             case H5LinkInfoMsg::TYPE_ID: {
-                uint32_t heapOffset;
-                H5LinkInfoMsg linkInfoMsg(msg.object);
-                try {
-                    heapOffset = getFractalHeapOffset(linkInfoMsg, pathItem);
-                } catch (const std::out_of_range&) {
-                    continue;
+                H5LinkMsg linkMsg;
+                if (!findDenseLinkMsg(H5LinkInfoMsg(msg.object), pathItem,
+                                      _cache, linkMsg))
+                {
+                    return true;
                 }
-                H5FractalHeap fractalHeap(_root.fileAddress(),
-                                          linkInfoMsg.getFractalHeapAddress());
-                H5LinkMsg linkMsg(fractalHeap.getHeapObject(heapOffset));
                 assert(linkMsg.linkName() == pathItem);
-                return ResolvedPath{linkMsg.hardLinkObjectHeader(), {}};
+                found = findPathInLinkMsg(parentEntry, linkMsg, remainingPath,
+                                          resolvedPath);
+                return false;
             }
         }
-    }
-    throw std::out_of_range("could not find " + pathItem);
+        return true;
+    });
+    return found;
 }
@@ -4,28 +4,37 @@
 #define PATH_RESOLVER_V2_H
 #include "H5LinkInfoMessage.h"
 #include "H5LinkMsg.h"
+#include "H5MetadataCache.h"
 #include "H5ObjectHeader.h"
 #include "H5Path.h"
 #include "ResolvedPath.h"
+#include "StringView.h"
 
 class PathResolverV2 {
 public:
-    PathResolverV2(const H5ObjectHeader& root);
+    PathResolverV2(const H5ObjectHeader& root,
+                   H5MetadataCache* cache = nullptr);
+    /// Throws std::out_of_range if path does not exist
     ResolvedPath resolve(const H5Path& path);
+    /// Returns false if path does not exist
+    bool tryResolve(const H5Path& path, ResolvedPath& resolvedPath);
 
 private:
     const H5ObjectHeader _root;
+    H5MetadataCache* const _cache;
 
-    ResolvedPath resolvePathInHeader(const H5ObjectHeader& in,
-                                     const H5Path& path);
-    ResolvedPath findPathInObjectHeader(const H5ObjectHeader& parentEntry,
-                                        const std::string pathItem,
-                                        const H5Path& remainingPath);
-    uint32_t getFractalHeapOffset(const H5LinkInfoMsg& linkInfoMsg,
-                                  const std::string& pathItem) const;
-    ResolvedPath findPathInLinkMsg(const H5ObjectHeader& parentEntry,
-                                   const H5LinkMsg& linkMsg,
-                                   const H5Path& remainingPath);
+    bool resolvePathInHeader(const H5ObjectHeader& in,
+                             const H5Path& path,
+                             const StringView& inPath,
+                             ResolvedPath& resolvedPath);
+    bool findPathInObjectHeader(const H5ObjectHeader& parentEntry,
+                                const StringView& pathItem,
+                                const H5Path& remainingPath,
+                                ResolvedPath& resolvedPath);
+    bool findPathInLinkMsg(const H5ObjectHeader& parentEntry,
+                           const H5LinkMsg& linkMsg,
+                           const H5Path& remainingPath,
+                           ResolvedPath& resolvedPath);
 };
 
 #endif  // PATH_RESOLVER_V2_H
@@ -2,22 +2,25 @@
 
 #ifndef RESOLVED_PATH_H
 #define RESOLVED_PATH_H
-#include <memory>
-#include <string>
 #include "H5ObjectHeader.h"
 #include "H5Path.h"
+#include "StringView.h"
 
 struct ResolvedPath {
     // When resolving a path in hdf5 the result can either be a link to an
     // external file or a H5ObjectHeader.
-    // gcc4.8 does not support std::optional yet so we use an unique pointer
-    // to externalfile struct. If set, objectHeader will be invalid.
+    // gcc4.8 does not support std::optional yet, so externalFile converts
+    // to true if it is set. If set, objectHeader will be invalid.
+    // filename is a view into the file the path was resolved in (or its
+    // metadata cache) and must be used before that file is closed.
     struct ExternalFile {
-        std::string filename;
+        StringView filename;
         H5Path h5Path;
+
+        explicit operator bool() const { return !filename.empty(); }
     };
     H5ObjectHeader objectHeader;
-    std::unique_ptr<ExternalFile> externalFile;
+    ExternalFile externalFile;
 };
 
 #endif  // RESOLVED_PATH_H
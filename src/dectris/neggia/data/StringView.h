@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef STRINGVIEW_H
+#define STRINGVIEW_H
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+
+/// A non-owning view of a string, e.g. of a name stored in the mapped file.
+/// The viewed characters must outlive the view.
+
+class StringView {
+public:
+    StringView() : _data(""), _size(0) {}
+    StringView(const char* data, size_t size) : _data(data), _size(size) {}
+    StringView(const char* cString) : _data(cString), _size(strlen(cString)) {}
+    StringView(const std::string& string)
+          : _data(string.data()), _size(string.size()) {}
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+    char operator[](size_t i) const { return _data[i]; }
+    std::string toString() const { return std::string(_data, _size); }
+
+    int compare(const StringView& other) const {
+        int result = memcmp(_data, other._data, std::min(_size, other._size));
+        if (result != 0)
+            return result;
+        if (_size == other._size)
+            return 0;
+        return _size < other._size ? -1 : 1;
+    }
+
+private:
+    const char* _data;
+    size_t _size;
+};
+
+inline bool operator==(const StringView& a, const StringView& b) {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator!=(const StringView& a, const StringView& b) {
+    return !(a == b);
+}
+
+inline bool operator<(const StringView& a, const StringView& b) {
+    return a.compare(b) < 0;
+}
+
+inline std::ostream& operator<<(std::ostream& stream, const StringView& view) {
+    return stream.write(view.data(), view.size());
+}
+
+/// FNV-1a, for unordered containers keyed by StringView
+struct StringViewHash {
+    size_t operator()(const StringView& view) const {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : view) {
+            hash ^= (unsigned char)c;
+            hash *= 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+#endif  // STRINGVIEW_H
@@ -0,0 +1,347 @@
+// SPDX-License-Identifier: MIT
+
+#include "DataFilePool.h"
+#include <dectris/neggia/data/H5Superblock.h>
+#include <algorithm>
+#include <vector>
+
+constexpr size_t DataFilePool::DEFAULT_CAPACITY;
+constexpr size_t DataFilePool::READAHEAD_FRAMES;
+
+DataFilePool::DataFilePool(const H5File& masterFile,
+                           Dataset::PageCachePolicy pageCachePolicy,
+                           const StagingEngine* staging,
+                           const NumaTopology* numaTopology,
+                           const SidecarIndex* index,
+                           size_t capacity)
+      : _masterFile(masterFile),
+        _pageCachePolicy(pageCachePolicy),
+        _staging(staging),
+        _numaTopology(numaTopology),
+        _index(index),
+        _capacity(std::max(capacity, (size_t)1)),
+        _warmUpQueues(numaTopology ? numaTopology->numberOfNodes() : 1),
+        _entryCounter(0),
+        _useCounter(0),
+        _stop(false) {
+    for (size_t node = 0; node < _warmUpQueues.size(); ++node)
+        _warmUpThreads.emplace_back(&DataFilePool::runWarmUp, this, node);
+}
+
+DataFilePool::~DataFilePool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    for (auto& thread : _warmUpThreads)
+        thread.join();
+}
+
+DataFilePool::DatasetPointer DataFilePool::open(const std::string& path) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    closeConsumedCopies();
+    auto entry = _entries.find(path);
+    if (entry != _entries.end()) {
+        entry->second.lastUse = ++_useCounter;
+        Entry existing = entry->second;
+        lock.unlock();
+        return get(path, existing);
+    }
+    std::promise<DatasetPointer> promise;
+    Entry inserted = insert(path, promise.get_future().share());
+    lock.unlock();
+    fulfil(path, promise, ANY_COPY);
+    return get(path, inserted);
+}
+
+DataFilePool::DatasetPointer DataFilePool::reopen(const std::string& path,
+                                                  const DatasetPointer& stale) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto entry = _entries.find(path);
+    if (entry != _entries.end()) {
+        entry->second.lastUse = ++_useCounter;
+        Entry existing = entry->second;
+        bool isReady = existing.dataset.wait_for(std::chrono::seconds(0)) ==
+                       std::future_status::ready;
+        if (!isReady || existing.dataset.get() != stale) {
+            lock.unlock();
+            return get(path, existing);
+        }
+    }
+    std::promise<DatasetPointer> promise;
+    Entry inserted = insert(path, promise.get_future().share());
+    lock.unlock();
+    fulfil(path, promise, SOURCE_FILE);
+    return get(path, inserted);
+}
+
+DataFilePool::DatasetPointer DataFilePool::waitForGrowth(
+        const std::string& path,
+        const DatasetPointer& stale,
+        std::chrono::milliseconds pollInterval,
+        Deadline deadline) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto entry = _entries.find(path);
+        if (entry != _entries.end() &&
+            entry->second.dataset.wait_for(std::chrono::seconds(0)) ==
+                    std::future_status::ready)
+        {
+            entry->second.lastUse = ++_useCounter;
+            Entry existing = entry->second;
+            bool isNewer = false;
+            try {
+                isNewer = existing.dataset.get() != stale;
+            } catch (...) {
+                // failed to open, opened again below
+            }
+            if (isNewer) {
+                lock.unlock();
+                return get(path, existing);
+            }
+        }
+        if (_reopening.insert(path).second) {
+            lock.unlock();
+            std::this_thread::sleep_until(std::min(
+                    std::chrono::steady_clock::now() + pollInterval,
+                    deadline));
+            DatasetPointer dataset;
+            try {
+                dataset = reopen(path, stale);
+            } catch (...) {
+                finishReopening(path);
+                throw;
+            }
+            finishReopening(path);
+            return dataset;
+        }
+        _reopened.wait_until(lock, deadline);
+    }
+    return stale;
+}
+
+void DataFilePool::warmUp(const std::string& path) {
+    size_t node = _numaTopology ? _numaTopology->currentNode() : 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_entries.count(path) > 0)
+            return;
+        for (const auto& queue : _warmUpQueues) {
+            if (std::find(queue.begin(), queue.end(), path) != queue.end())
+                return;
+        }
+        _warmUpQueues[node].push_back(path);
+    }
+    _condition.notify_all();
+}
+
+DataFilePool::DataFileLocation DataFilePool::locate(const H5File& masterFile,
+                                                   const std::string& path) {
+    H5Superblock superblock(masterFile.fileAddress(),
+                            masterFile.metadataCache());
+    auto resolvedPath = superblock.resolve(path);
+    if (!resolvedPath.externalFile)
+        return DataFileLocation{std::string(), path};
+    std::string filename = resolvedPath.externalFile.filename.toString();
+    if (filename.empty())
+        throw std::out_of_range("external link without a filename");
+    if (filename[0] != '/')
+        filename = masterFile.fileDir() + "/" + filename;
+    return DataFileLocation{filename, resolvedPath.externalFile.h5Path};
+}
+
+Dataset DataFilePool::openDataset(const std::string& path,
+                                  bool waitForStaging,
+                                  StagingEngine::LocalCopy& localCopy) const {
+    if (_staging) {
+        DataFileLocation location;
+        try {
+            location = locate(_masterFile, path);
+            if (!location.filename.empty()) {
+                localCopy = waitForStaging
+                                    ? _staging->waitForLocalCopy(
+                                              location.filename)
+                                    : _staging->localCopy(location.filename);
+            }
+        } catch (const std::exception&) {
+            // reported by the Dataset constructor below
+        }
+        if (!localCopy.path.empty())
+            return Dataset(H5File(localCopy.path), location.path);
+    }
+    return Dataset(_masterFile, path);
+}
+
+Dataset DataFilePool::openDatasetFromSource(const std::string& path) const {
+    DataFileLocation location = locate(_masterFile, path);
+    if (location.filename.empty())
+        return Dataset(_masterFile.reopen(), path);
+    return Dataset(H5File(location.filename, _masterFile.writerPolicy()),
+                   location.path);
+}
+
+Dataset DataFilePool::openIndexedDataset(
+        const SidecarIndex::DataFile& dataFile,
+        StagingEngine::LocalCopy& localCopy) const {
+    if (dataFile.filename.empty())
+        return Dataset(_masterFile, dataFile.path);
+    if (_staging)
+        localCopy = _staging->localCopy(dataFile.filename);
+    return Dataset(H5File(localCopy.path.empty() ? dataFile.filename
+                                                 : localCopy.path),
+                   dataFile.path);
+}
+
+DataFilePool::DatasetPointer DataFilePool::load(const std::string& path,
+                                                Source source) {
+    std::unique_ptr<Dataset> dataset;
+    StagingEngine::LocalCopy localCopy;
+    SidecarIndex::DataFile dataFile;
+    if (source == SOURCE_FILE) {
+        dataset.reset(new Dataset(openDatasetFromSource(path)));
+        dataset->indexChunks();
+    } else if (_index && _index->findDataFile(path, dataFile) &&
+               SidecarIndex::isUnchanged(dataFile))
+    {
+        dataset.reset(new Dataset(openIndexedDataset(dataFile, localCopy)));
+        dataset->setChunkLocations(dataFile.chunks);
+    } else {
+        dataset.reset(new Dataset(
+                openDataset(path, source == STAGED_COPY, localCopy)));
+        dataset->indexChunks();
+    }
+    dataset->setPageCachePolicy(_pageCachePolicy);
+    if (dataset->hasChunkIndex()) {
+        size_t nFrames = std::min(dataset->dim()[0], READAHEAD_FRAMES);
+        std::vector<size_t> chunkOffset(dataset->dim().size(), 0);
+        for (size_t frame = 0; frame < nFrames; ++frame) {
+            chunkOffset[0] = frame;
+            dataset->prefetch(chunkOffset);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (localCopy.path.empty())
+            _stagedCopies.erase(path);
+        else
+            _stagedCopies[path] = localCopy.path;
+    }
+    // the staged copy stays leased as long as the dataset maps it
+    std::shared_ptr<const void> lease = localCopy.lease;
+    return DatasetPointer(dataset.release(), [lease](const Dataset* opened) {
+        delete opened;
+    });
+}
+
+bool DataFilePool::fulfil(const std::string& path,
+                          std::promise<DatasetPointer>& promise,
+                          Source source) {
+    try {
+        promise.set_value(load(path, source));
+        return true;
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        return false;
+    }
+}
+
+void DataFilePool::closeConsumedCopies() {
+    if (!_staging)
+        return;
+    for (auto copy = _stagedCopies.begin(); copy != _stagedCopies.end();) {
+        if (_staging->isStaged(copy->second)) {
+            ++copy;
+            continue;
+        }
+        // readers still holding the dataset keep it open until they are done
+        auto entry = _entries.find(copy->first);
+        if (entry != _entries.end() &&
+            entry->second.dataset.wait_for(std::chrono::seconds(0)) ==
+                    std::future_status::ready)
+        {
+            _entries.erase(entry);
+        }
+        copy = _stagedCopies.erase(copy);
+    }
+}
+
+DataFilePool::DatasetPointer DataFilePool::get(const std::string& path,
+                                               const Entry& entry) {
+    try {
+        return entry.dataset.get();
+    } catch (...) {
+        // forget failed attempts so that the file is opened again next time
+        std::lock_guard<std::mutex> lock(_mutex);
+        erase(path, entry.id);
+        throw;
+    }
+}
+
+DataFilePool::Entry DataFilePool::insert(const std::string& path,
+                                         const DatasetFuture& future) {
+    Entry entry{future, ++_entryCounter, ++_useCounter};
+    _entries[path] = entry;
+    if (_entries.size() > _capacity)
+        evictLeastRecentlyUsed();
+    return entry;
+}
+
+void DataFilePool::erase(const std::string& path, uint64_t id) {
+    auto entry = _entries.find(path);
+    if (entry != _entries.end() && entry->second.id == id)
+        _entries.erase(entry);
+}
+
+void DataFilePool::finishReopening(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _reopening.erase(path);
+    }
+    _reopened.notify_all();
+}
+
+void DataFilePool::evictLeastRecentlyUsed() {
+    // datasets that are still being opened are never evicted, datasets in
+    // use by a reader stay alive through their shared pointer
+    auto leastRecentlyUsed = _entries.end();
+    for (auto entry = _entries.begin(); entry != _entries.end(); ++entry) {
+        if (entry->second.dataset.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+        {
+            continue;
+        }
+        if (leastRecentlyUsed == _entries.end() ||
+            entry->second.lastUse < leastRecentlyUsed->second.lastUse)
+        {
+            leastRecentlyUsed = entry;
+        }
+    }
+    if (leastRecentlyUsed != _entries.end())
+        _entries.erase(leastRecentlyUsed);
+}
+
+void DataFilePool::runWarmUp(size_t node) {
+    if (_numaTopology)
+        _numaTopology->bindCurrentThread(node);
+    std::deque<std::string>& queue = _warmUpQueues[node];
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _condition.wait(lock, [&] { return _stop || !queue.empty(); });
+        if (_stop)
+            return;
+        std::string path = queue.front();
+        queue.pop_front();
+        if (_entries.count(path) > 0)
+            continue;
+        std::promise<DatasetPointer> promise;
+        Entry inserted = insert(path, promise.get_future().share());
+        lock.unlock();
+        bool success = fulfil(path, promise, STAGED_COPY);
+        lock.lock();
+        // a failed warm-up is not an error yet, the file is opened again
+        // and the error reported when the data is actually requested
+        if (!success)
+            erase(path, inserted.id);
+    }
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef DATAFILEPOOL_H
+#define DATAFILEPOOL_H
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/H5File.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NumaTopology.h"
+#include "SidecarIndex.h"
+#include "StagingEngine.h"
+
+/// Keeps the datasets of the most recently used data files open and warms
+/// up upcoming data files on a background thread: the file is opened and
+/// mapped, the dataset path resolved, its chunk index built and readahead of
+/// the first frames started before the first frame is actually requested.
+/// If a staging engine is given, data files are opened from their staged
+/// local copy whenever one is available, and warm-ups wait for the copy of
+/// a file that is being staged. Datasets of copies that staging has
+/// consumed are closed so that their space can be reused. Given a NUMA
+/// topology, there is one warm-up thread per node and a file is warmed up on
+/// the node of the thread that asked for it, so that its page cache and
+/// index are local to it.
+/// Given a sidecar index, data files that have not changed since it was
+/// written are opened directly and their chunk index is taken from it.
+class DataFilePool {
+public:
+    typedef std::shared_ptr<const Dataset> DatasetPointer;
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    struct DataFileLocation {
+        /// empty if the dataset is stored in the master file itself
+        std::string filename;
+        std::string path;
+    };
+
+    DataFilePool(const H5File& masterFile,
+                 Dataset::PageCachePolicy pageCachePolicy,
+                 const StagingEngine* staging = nullptr,
+                 const NumaTopology* numaTopology = nullptr,
+                 const SidecarIndex* index = nullptr,
+                 size_t capacity = DEFAULT_CAPACITY);
+    ~DataFilePool();
+    DataFilePool(const DataFilePool&) = delete;
+    DataFilePool& operator=(const DataFilePool&) = delete;
+
+    /// Returns the dataset at path in the master file. Waits if the dataset
+    /// is currently being warmed up, throws what the Dataset constructor
+    /// throws if it cannot be opened.
+    DatasetPointer open(const std::string& path);
+    /// Opens the dataset at path again from a fresh mapping of its file to
+    /// see the frames a writer has appended since stale was opened. Returns
+    /// the dataset another reader has reopened in the meantime instead of
+    /// opening it once more. Staged copies and the sidecar index are not
+    /// used, they describe the file as it was when they were made.
+    DatasetPointer reopen(const std::string& path,
+                          const DatasetPointer& stale);
+    /// Returns the dataset at path once it has been opened again like
+    /// reopen() does since stale was opened. Of the threads waiting for the
+    /// same path, one opens it again after pollInterval and wakes the
+    /// others, so that the file is mapped once per interval however many
+    /// frames are waited for. Returns stale if deadline passes first.
+    DatasetPointer waitForGrowth(const std::string& path,
+                                 const DatasetPointer& stale,
+                                 std::chrono::milliseconds pollInterval,
+                                 Deadline deadline);
+    /// Schedules the dataset at path to be opened in the background
+    void warmUp(const std::string& path);
+
+    /// Follows the external link at path in the master file without
+    /// opening the target file.
+    static DataFileLocation locate(const H5File& masterFile,
+                                   const std::string& path);
+
+    constexpr static size_t DEFAULT_CAPACITY = 8;
+    constexpr static size_t READAHEAD_FRAMES = 4;
+
+private:
+    typedef std::shared_future<DatasetPointer> DatasetFuture;
+    struct Entry {
+        DatasetFuture dataset;
+        uint64_t id;
+        uint64_t lastUse;
+    };
+
+    enum Source {
+        /// a staged copy if there is one
+        ANY_COPY,
+        /// a staged copy, waiting if the file is being staged
+        STAGED_COPY,
+        /// the file itself, freshly mapped
+        SOURCE_FILE
+    };
+
+    Dataset openDataset(const std::string& path,
+                        bool waitForStaging,
+                        StagingEngine::LocalCopy& localCopy) const;
+    Dataset openIndexedDataset(const SidecarIndex::DataFile& dataFile,
+                               StagingEngine::LocalCopy& localCopy) const;
+    Dataset openDatasetFromSource(const std::string& path) const;
+    DatasetPointer load(const std::string& path, Source source);
+    bool fulfil(const std::string& path,
+                std::promise<DatasetPointer>& promise,
+                Source source);
+    void closeConsumedCopies();
+    DatasetPointer get(const std::string& path, const Entry& entry);
+    Entry insert(const std::string& path, const DatasetFuture& future);
+    void erase(const std::string& path, uint64_t id);
+    void finishReopening(const std::string& path);
+    void evictLeastRecentlyUsed();
+    void runWarmUp(size_t node);
+
+    const H5File _masterFile;
+    const Dataset::PageCachePolicy _pageCachePolicy;
+    const StagingEngine* const _staging;
+    const NumaTopology* const _numaTopology;
+    const SidecarIndex* const _index;
+    const size_t _capacity;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::map<std::string, Entry> _entries;
+    /// the staged copies the datasets of _entries were opened from
+    std::map<std::string, std::string> _stagedCopies;
+    std::vector<std::deque<std::string>> _warmUpQueues;
+    /// the paths a thread in waitForGrowth is about to open again
+    std::set<std::string> _reopening;
+    std::condition_variable _reopened;
+    uint64_t _entryCounter;
+    uint64_t _useCounter;
+    bool _stop;
+    std::vector<std::thread> _warmUpThreads;
+};
+
+#endif  // DATAFILEPOOL_H
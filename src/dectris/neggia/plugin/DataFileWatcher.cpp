@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: MIT
+
+#include "DataFileWatcher.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+constexpr std::chrono::milliseconds DataFileWatcher::POLL_INTERVAL;
+constexpr std::chrono::seconds DataFileWatcher::SETTLE_TIME;
+
+namespace {
+
+bool exists(const std::string& path) {
+    struct stat fileStatus;
+    return stat(path.c_str(), &fileStatus) == 0;
+}
+
+}  // namespace
+
+DataFileWatcher::DataFileWatcher(const std::string& directory)
+      : _directory(directory), _inotify(-1), _cancelled(false), _stop(false) {
+#ifdef __linux__
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify < 0)
+        throw std::runtime_error("cannot initialize inotify");
+    uint32_t events = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO;
+    if (inotify_add_watch(_inotify, directory.c_str(), events) < 0) {
+        close(_inotify);
+        throw std::runtime_error("cannot watch " + directory);
+    }
+    addExistingFiles();
+    _thread = std::thread(&DataFileWatcher::run, this);
+#endif
+}
+
+DataFileWatcher::~DataFileWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    if (_thread.joinable())
+        _thread.join();
+    if (_inotify >= 0)
+        close(_inotify);
+}
+
+bool DataFileWatcher::isComplete(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return isCompleteLocked(path);
+}
+
+bool DataFileWatcher::waitUntilExists(const std::string& path,
+                                      Deadline deadline) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_cancelled) {
+        if (existsLocked(path))
+            return true;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        // files that are not watched are checked for again after a while
+        _condition.wait_until(
+                lock, std::min(deadline, std::chrono::steady_clock::now() +
+                                                 POLL_INTERVAL));
+    }
+    return false;
+}
+
+void DataFileWatcher::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+    }
+    _condition.notify_all();
+}
+
+bool DataFileWatcher::isWatched(const std::string& path) const {
+    size_t separator = path.rfind('/');
+    return _inotify >= 0 && separator != std::string::npos &&
+           path.compare(0, separator, _directory) == 0;
+}
+
+bool DataFileWatcher::isCompleteLocked(const std::string& path) const {
+    if (!isWatched(path))
+        return exists(path);
+    // a file that is not known yet has been created so recently that its
+    // events have not been read
+    auto file = _files.find(path.substr(path.rfind('/') + 1));
+    return file != _files.end() && file->second;
+}
+
+bool DataFileWatcher::existsLocked(const std::string& path) const {
+    if (!isWatched(path))
+        return exists(path);
+    return _files.count(path.substr(path.rfind('/') + 1)) > 0;
+}
+
+void DataFileWatcher::addExistingFiles() {
+    DIR* directory = opendir(_directory.c_str());
+    if (!directory)
+        return;
+    while (dirent* entry = readdir(directory))
+        _files.emplace(entry->d_name, true);
+    closedir(directory);
+}
+
+void DataFileWatcher::relistFiles() {
+    DIR* directory = opendir(_directory.c_str());
+    if (!directory)
+        return;
+    auto now = std::chrono::steady_clock::now();
+    std::map<std::string, bool> files;
+    _unsettledFiles.clear();
+    while (dirent* entry = readdir(directory)) {
+        auto known = _files.find(entry->d_name);
+        bool isComplete = known != _files.end() && known->second;
+        files[entry->d_name] = isComplete;
+        struct stat fileStatus;
+        std::string path = _directory + "/" + entry->d_name;
+        if (!isComplete && stat(path.c_str(), &fileStatus) == 0) {
+            _unsettledFiles[entry->d_name] = UnsettledFile{
+                    fileStatus.st_size, fileStatus.st_mtime, now};
+        }
+    }
+    closedir(directory);
+    _files.swap(files);
+}
+
+void DataFileWatcher::settleFiles() {
+    auto now = std::chrono::steady_clock::now();
+    bool settled = false;
+    for (auto file = _unsettledFiles.begin(); file != _unsettledFiles.end();) {
+        struct stat fileStatus;
+        std::string path = _directory + "/" + file->first;
+        if (stat(path.c_str(), &fileStatus) != 0) {
+            file = _unsettledFiles.erase(file);
+            continue;
+        }
+        UnsettledFile& seen = file->second;
+        if (fileStatus.st_size != seen.size ||
+            fileStatus.st_mtime != seen.modificationTime)
+        {
+            seen = UnsettledFile{fileStatus.st_size, fileStatus.st_mtime, now};
+            ++file;
+        } else if (now - seen.unchangedSince >= SETTLE_TIME) {
+            _files[file->first] = true;
+            file = _unsettledFiles.erase(file);
+            settled = true;
+        } else {
+            ++file;
+        }
+    }
+    if (settled)
+        _condition.notify_all();
+}
+
+void DataFileWatcher::run() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stop)
+                return;
+        }
+        struct pollfd request = {_inotify, POLLIN, 0};
+        if (poll(&request, 1, POLL_INTERVAL.count()) > 0)
+            readEvents();
+        std::lock_guard<std::mutex> lock(_mutex);
+        settleFiles();
+    }
+}
+
+void DataFileWatcher::readEvents() {
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t size = read(_inotify, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            break;
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (char* position = buffer; position < buffer + size;) {
+            const struct inotify_event* event =
+                    (const struct inotify_event*)position;
+            position += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                relistFiles();
+                continue;
+            }
+            if (event->len == 0)
+                continue;
+            _files[event->name] =
+                    (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0;
+            _unsettledFiles.erase(event->name);
+        }
+    }
+    _condition.notify_all();
+#endif
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef DATAFILEWATCHER_H
+#define DATAFILEWATCHER_H
+#include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// Watches the directory of the master file for data files that the file
+/// writer creates and completes while the frames are already being read. A
+/// file counts as complete once its writer has closed it or it has been
+/// moved into the directory. Files that are already there when the watch
+/// starts count as complete unless they are written to later on. If events
+/// have been lost, files that were complete stay complete and the others
+/// count as complete once an event says so or their size and modification
+/// time have not changed for SETTLE_TIME. Without inotify, and for files in
+/// other directories, a file counts as complete once it exists.
+class DataFileWatcher {
+public:
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    /// Throws std::runtime_error if the directory cannot be watched
+    explicit DataFileWatcher(const std::string& directory);
+    ~DataFileWatcher();
+    DataFileWatcher(const DataFileWatcher&) = delete;
+    DataFileWatcher& operator=(const DataFileWatcher&) = delete;
+
+    bool isComplete(const std::string& path) const;
+    /// Waits until the file at path exists, complete or not, e.g. for a
+    /// writer that keeps it readable while appending to it. Returns false if
+    /// the deadline passes first or the watch has been cancelled.
+    bool waitUntilExists(const std::string& path, Deadline deadline) const;
+    /// Makes all current and future waits return false, e.g. on close
+    void cancel();
+
+    /// How often files are checked for if there is no inotify
+    constexpr static std::chrono::milliseconds POLL_INTERVAL{100};
+    /// How long a file whose events have been lost has to stay unchanged
+    constexpr static std::chrono::seconds SETTLE_TIME{2};
+
+private:
+    /// An incomplete file whose events have been lost, as last seen
+    struct UnsettledFile {
+        off_t size;
+        time_t modificationTime;
+        Deadline unchangedSince;
+    };
+
+    void run();
+    void readEvents();
+    /// Marks the files in the directory as complete unless they are known
+    void addExistingFiles();
+    /// Lists the directory again after events have been lost
+    void relistFiles();
+    /// Marks the unsettled files that have not changed for SETTLE_TIME as
+    /// complete
+    void settleFiles();
+    bool isWatched(const std::string& path) const;
+    bool isCompleteLocked(const std::string& path) const;
+    bool existsLocked(const std::string& path) const;
+
+    const std::string _directory;
+    int _inotify;
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _condition;
+    /// files of the directory by name, true once they are complete
+    std::map<std::string, bool> _files;
+    /// the incomplete files of _files that no event has been read for since
+    /// events have been lost
+    std::map<std::string, UnsettledFile> _unsettledFiles;
+    bool _cancelled;
+    bool _stop;
+    std::thread _thread;
+};
+
+#endif  // DATAFILEWATCHER_H
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameCache.h"
+#include <exception>
+
+FrameCache::FrameCache(size_t budget) : _budget(budget), _statistics() {}
+
+FrameCache::FramePointer FrameCache::get(size_t frameNumber,
+                                         size_t numberOfPixels,
+                                         const Decoder& decode) {
+    size_t bytes = numberOfPixels * sizeof(int32_t);
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto entry = _entries.find(frameNumber);
+    if (entry != _entries.end()) {
+        ++_statistics.hits;
+        if (entry->second.frame.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready)
+        {
+            ++_statistics.waits;
+        }
+        _useOrder.splice(_useOrder.end(), _useOrder, entry->second.use);
+        FrameFuture frame = entry->second.frame;
+        lock.unlock();
+        return frame.get();
+    }
+    ++_statistics.misses;
+    if (bytes > _budget) {
+        lock.unlock();
+        return decodeFrame(numberOfPixels, decode);
+    }
+    std::promise<FramePointer> promise;
+    insert(frameNumber, promise.get_future().share(), bytes);
+    lock.unlock();
+    try {
+        FramePointer frame = decodeFrame(numberOfPixels, decode);
+        promise.set_value(frame);
+        return frame;
+    } catch (...) {
+        // the next request decodes the frame again. Frames that are not
+        // ready are never evicted, the entry is still there and ours.
+        lock.lock();
+        erase(_entries.find(frameNumber));
+        lock.unlock();
+        // the waiting threads get the same error
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+FrameCache::Statistics FrameCache::statistics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+FrameCache::FramePointer FrameCache::decodeFrame(size_t numberOfPixels,
+                                                 const Decoder& decode) {
+    std::shared_ptr<int32_t> frame(new int32_t[numberOfPixels],
+                                   std::default_delete<int32_t[]>());
+    decode(frame.get());
+    return frame;
+}
+
+void FrameCache::insert(size_t frameNumber,
+                        const FrameFuture& future,
+                        size_t bytes) {
+    Entry entry{future, bytes, _useOrder.insert(_useOrder.end(), frameNumber)};
+    _entries[frameNumber] = entry;
+    _statistics.bytes += bytes;
+    if (_statistics.bytes > _budget)
+        evictLeastRecentlyUsed();
+}
+
+void FrameCache::erase(std::map<size_t, Entry>::iterator entry) {
+    _statistics.bytes -= entry->second.bytes;
+    _useOrder.erase(entry->second.use);
+    _entries.erase(entry);
+}
+
+void FrameCache::evictLeastRecentlyUsed() {
+    // frames that are still being decoded are never evicted, frames in use
+    // by a reader stay alive through their shared pointer
+    auto frameNumber = _useOrder.begin();
+    while (_statistics.bytes > _budget && frameNumber != _useOrder.end()) {
+        auto entry = _entries.find(*frameNumber++);
+        if (entry->second.frame.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready)
+        {
+            erase(entry);
+            ++_statistics.evictions;
+        }
+    }
+}
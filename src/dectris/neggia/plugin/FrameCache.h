@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+/// Keeps the most recently used decoded frames, i.e. after the pixel mask
+/// has been applied, within a budget of bytes. XDS reads some frames more
+/// than once, e.g. the background range, and several threads may ask for
+/// the same frame at the same time: a frame is decoded once, the threads
+/// that ask for it meanwhile wait for that decode to finish.
+class FrameCache {
+public:
+    typedef std::shared_ptr<const int32_t> FramePointer;
+    /// Decodes a frame into the given buffer
+    typedef std::function<void(int32_t* frame)> Decoder;
+
+    struct Statistics {
+        /// requests served from the cache, including the ones that waited
+        uint64_t hits;
+        /// requests that waited for another thread decoding the frame
+        uint64_t waits;
+        uint64_t misses;
+        uint64_t evictions;
+        /// size of the frames currently cached or being decoded
+        size_t bytes;
+    };
+
+    explicit FrameCache(size_t budget);
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    /// Returns the frame of numberOfPixels values. On a miss, the frame is
+    /// decoded into a new buffer. Rethrows what decode throws, a frame that
+    /// could not be decoded is not cached.
+    FramePointer get(size_t frameNumber,
+                     size_t numberOfPixels,
+                     const Decoder& decode);
+    Statistics statistics() const;
+
+private:
+    typedef std::shared_future<FramePointer> FrameFuture;
+    struct Entry {
+        FrameFuture frame;
+        size_t bytes;
+        /// position in _useOrder
+        std::list<size_t>::iterator use;
+    };
+
+    static FramePointer decodeFrame(size_t numberOfPixels,
+                                    const Decoder& decode);
+    void insert(size_t frameNumber, const FrameFuture& future, size_t bytes);
+    void erase(std::map<size_t, Entry>::iterator entry);
+    void evictLeastRecentlyUsed();
+
+    const size_t _budget;
+    mutable std::mutex _mutex;
+    std::map<size_t, Entry> _entries;
+    /// frame numbers, least recently used first
+    std::list<size_t> _useOrder;
+    Statistics _statistics;
+};
+
+#endif  // FRAMECACHE_H
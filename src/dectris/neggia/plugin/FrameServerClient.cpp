@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameServerClient.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
+FrameServerClient::Channel::~Channel() {
+    if (frame)
+        munmap((void*)frame, frameBytes);
+}
+
+FrameServerClient::FrameServerClient(const std::string& socketPath,
+                                     const std::string& masterFilename)
+      : _socketPath(socketPath), _masterFilename(masterFilename) {
+    // the server opens every file once, whichever path it is opened by
+    char resolved[PATH_MAX];
+    if (realpath(masterFilename.c_str(), resolved))
+        _masterFilename = resolved;
+    auto channel = openChannel(_header);
+    returnChannel(std::move(channel));
+}
+
+FrameServerClient::~FrameServerClient() {}
+
+const FrameServerConnection::Header& FrameServerClient::header() const {
+    return _header;
+}
+
+FrameServerConnection::Status FrameServerClient::read(uint64_t frameNumber,
+                                                      void* frame) {
+    auto channel = takeChannel();
+    FrameServerConnection::Request request =
+            FrameServerConnection::Request();
+    request.protocolVersion = FrameServerConnection::PROTOCOL_VERSION;
+    request.type = FrameServerConnection::READ;
+    request.frameNumber = frameNumber;
+    channel->connection->sendRequest(request);
+    FrameServerConnection::Response response;
+    int fd;
+    channel->connection->receiveResponse(response, fd);
+    if (fd >= 0)
+        close(fd);
+    if (response.status == FrameServerConnection::OK)
+        memcpy(frame, channel->frame, channel->frameBytes);
+    // a channel that failed above is closed and not reused
+    returnChannel(std::move(channel));
+    return (FrameServerConnection::Status)response.status;
+}
+
+std::unique_ptr<FrameServerClient::Channel> FrameServerClient::openChannel(
+        FrameServerConnection::Header& header) {
+    std::unique_ptr<Channel> channel(new Channel());
+    channel->connection = FrameServerConnection::connect(_socketPath);
+    FrameServerConnection::Request request =
+            FrameServerConnection::Request();
+    request.protocolVersion = FrameServerConnection::PROTOCOL_VERSION;
+    request.type = FrameServerConnection::OPEN;
+    request.filenameSize = _masterFilename.size();
+    channel->connection->sendRequest(request, _masterFilename);
+    FrameServerConnection::Response response;
+    int fd;
+    channel->connection->receiveResponse(response, fd);
+    if (response.status != FrameServerConnection::OK || fd < 0) {
+        if (fd >= 0)
+            close(fd);
+        throw std::runtime_error(_socketPath + " cannot serve " +
+                                 _masterFilename);
+    }
+    struct stat bufferStatus;
+    size_t frameBytes = (size_t)response.header.nx * response.header.ny *
+                        response.header.dataSize;
+    void* address = MAP_FAILED;
+    if (fstat(fd, &bufferStatus) == 0 &&
+        (size_t)bufferStatus.st_size >= frameBytes)
+    {
+        address = mmap(NULL, frameBytes, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (address == MAP_FAILED)
+        throw std::runtime_error("cannot map the frame buffer of the server");
+    channel->frame = (const char*)address;
+    channel->frameBytes = frameBytes;
+    header = response.header;
+    return channel;
+}
+
+std::unique_ptr<FrameServerClient::Channel> FrameServerClient::takeChannel() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_idleChannels.empty()) {
+            auto channel = std::move(_idleChannels.back());
+            _idleChannels.pop_back();
+            return channel;
+        }
+    }
+    FrameServerConnection::Header header;
+    return openChannel(header);
+}
+
+void FrameServerClient::returnChannel(std::unique_ptr<Channel> channel) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _idleChannels.push_back(std::move(channel));
+}
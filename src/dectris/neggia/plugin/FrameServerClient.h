@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMESERVERCLIENT_H
+#define FRAMESERVERCLIENT_H
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FrameServerConnection.h"
+
+/// Reads frames from neggia-served instead of decoding them in this
+/// process. Every thread reading concurrently uses a connection and frame
+/// buffer of its own, connections are kept for the next reader.
+class FrameServerClient {
+public:
+    /// Connects to the server at socketPath and opens masterFilename. Throws
+    /// std::runtime_error if there is no server or it cannot open the file.
+    FrameServerClient(const std::string& socketPath,
+                      const std::string& masterFilename);
+    ~FrameServerClient();
+    FrameServerClient(const FrameServerClient&) = delete;
+    FrameServerClient& operator=(const FrameServerClient&) = delete;
+
+    const FrameServerConnection::Header& header() const;
+    /// Copies frame frameNumber (counting from 0 across the data files) into
+    /// frame, nx * ny pixels of dataSize bytes as stored in the data file,
+    /// and returns the status of the server. Throws std::runtime_error if
+    /// the connection fails.
+    FrameServerConnection::Status read(uint64_t frameNumber, void* frame);
+
+private:
+    struct Channel {
+        std::unique_ptr<FrameServerConnection> connection;
+        /// the frame buffer shared with the server
+        const char* frame = nullptr;
+        size_t frameBytes = 0;
+
+        ~Channel();
+    };
+
+    std::unique_ptr<Channel> openChannel(
+            FrameServerConnection::Header& header);
+    std::unique_ptr<Channel> takeChannel();
+    void returnChannel(std::unique_ptr<Channel> channel);
+
+    const std::string _socketPath;
+    std::string _masterFilename;
+    FrameServerConnection::Header _header;
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Channel>> _idleChannels;
+};
+
+#endif  // FRAMESERVERCLIENT_H
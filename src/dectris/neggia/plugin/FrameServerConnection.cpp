@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameServerConnection.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <vector>
+
+constexpr uint32_t FrameServerConnection::PROTOCOL_VERSION;
+
+namespace {
+
+const uint64_t MAX_FILENAME_SIZE = 1 << 16;
+
+// a client that went away must not kill the server with SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+}  // namespace
+
+FrameServerConnection::FrameServerConnection(int socket) : _socket(socket) {}
+
+FrameServerConnection::~FrameServerConnection() {
+    close(_socket);
+}
+
+std::unique_ptr<FrameServerConnection> FrameServerConnection::connect(
+        const std::string& socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + socketPath);
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("cannot create socket");
+    std::unique_ptr<FrameServerConnection> connection(
+            new FrameServerConnection(fd));
+    if (::connect(fd, (const struct sockaddr*)&address, sizeof(address)) != 0)
+        throw std::runtime_error("cannot connect to " + socketPath);
+    return connection;
+}
+
+void FrameServerConnection::sendRequest(const Request& request,
+                                        const std::string& filename) {
+    sendAll(&request, sizeof(request), -1);
+    if (!filename.empty())
+        sendAll(filename.data(), filename.size(), -1);
+}
+
+bool FrameServerConnection::receiveRequest(Request& request,
+                                           std::string& filename) {
+    if (!receiveAll(&request, sizeof(request), nullptr))
+        return false;
+    filename.clear();
+    if (request.type == OPEN) {
+        if (request.filenameSize > MAX_FILENAME_SIZE)
+            throw std::runtime_error("invalid request");
+        std::vector<char> buffer(request.filenameSize);
+        if (!receiveAll(buffer.data(), buffer.size(), nullptr))
+            return false;
+        filename.assign(buffer.begin(), buffer.end());
+    }
+    return true;
+}
+
+void FrameServerConnection::sendResponse(const Response& response, int fd) {
+    sendAll(&response, sizeof(response), fd);
+}
+
+void FrameServerConnection::receiveResponse(Response& response, int& fd) {
+    fd = -1;
+    if (!receiveAll(&response, sizeof(response), &fd))
+        throw std::runtime_error("frame server closed the connection");
+}
+
+void FrameServerConnection::shutdown() {
+    ::shutdown(_socket, SHUT_RDWR);
+}
+
+bool FrameServerConnection::receiveAll(void* data, size_t size, int* fd) {
+    char* position = (char*)data;
+    while (size > 0) {
+        struct iovec io = {position, size};
+        char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(_socket, &message, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw std::runtime_error("cannot receive from socket");
+        if (n == 0) {
+            if (position != (char*)data)
+                throw std::runtime_error("incomplete message");
+            return false;
+        }
+        for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header;
+             header = CMSG_NXTHDR(&message, header))
+        {
+            if (header->cmsg_level != SOL_SOCKET ||
+                header->cmsg_type != SCM_RIGHTS)
+            {
+                continue;
+            }
+            int received;
+            memcpy(&received, CMSG_DATA(header), sizeof(int));
+            if (fd && *fd < 0)
+                *fd = received;
+            else
+                close(received);
+        }
+        position += n;
+        size -= n;
+    }
+    return true;
+}
+
+void FrameServerConnection::sendAll(const void* data, size_t size, int fd) {
+    const char* position = (const char*)data;
+    while (size > 0) {
+        struct iovec io = {(void*)position, size};
+        char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        if (fd >= 0) {
+            // the descriptor goes along with the first byte
+            memset(control, 0, sizeof(control));
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(header), &fd, sizeof(int));
+        }
+        ssize_t n = sendmsg(_socket, &message, SEND_FLAGS);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw std::runtime_error("cannot send to socket");
+        position += n;
+        size -= n;
+        fd = -1;
+    }
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMESERVERCONNECTION_H
+#define FRAMESERVERCONNECTION_H
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+/// One end of a connection between neggia-served and a client over a Unix
+/// socket. The client opens a master file and receives the header together
+/// with a file descriptor of a shared memory buffer of one frame. Each frame
+/// the client asks for afterwards is read by the server straight into that
+/// buffer, in the type it is stored in; the pixels never pass the socket.
+/// Throws std::runtime_error if the connection fails.
+class FrameServerConnection {
+public:
+    enum RequestType { OPEN = 1, READ = 2 };
+
+    enum Status {
+        OK = 0,
+        /// OPEN: the file is not a master file the server can read
+        CANNOT_OPEN = 1,
+        /// READ: the frame does not exist or cannot be read
+        CANNOT_READ = 2,
+        /// unknown protocol version or request, READ before OPEN
+        INVALID_REQUEST = 3
+    };
+
+    struct Request {
+        uint32_t protocolVersion;
+        uint32_t type;
+        /// READ: the frame number, counting from 0 across the data files
+        uint64_t frameNumber;
+        /// OPEN: the size of the absolute path of the master file that
+        /// follows the request
+        uint64_t filenameSize;
+    };
+
+    struct Header {
+        uint32_t nx;
+        uint32_t ny;
+        /// bytes per pixel
+        uint32_t dataSize;
+        uint32_t isSigned;
+        /// the frames of all data files
+        uint64_t numberOfFrames;
+    };
+
+    struct Response {
+        uint32_t status;
+        /// OPEN only
+        Header header;
+    };
+
+    /// Takes ownership of the connected socket
+    explicit FrameServerConnection(int socket);
+    ~FrameServerConnection();
+    FrameServerConnection(const FrameServerConnection&) = delete;
+    FrameServerConnection& operator=(const FrameServerConnection&) = delete;
+
+    static std::unique_ptr<FrameServerConnection> connect(
+            const std::string& socketPath);
+
+    void sendRequest(const Request& request,
+                     const std::string& filename = std::string());
+    /// Returns false if the client has closed the connection
+    bool receiveRequest(Request& request, std::string& filename);
+    /// Passes fd along with the response unless it is negative
+    void sendResponse(const Response& response, int fd = -1);
+    /// Stores the file descriptor passed along in fd, -1 if there is none
+    void receiveResponse(Response& response, int& fd);
+    /// Makes pending and future calls fail, e.g. to stop a server thread
+    void shutdown();
+
+    constexpr static uint32_t PROTOCOL_VERSION = 2;
+
+private:
+    bool receiveAll(void* data, size_t size, int* fd);
+    void sendAll(const void* data, size_t size, int fd);
+
+    int _socket;
+};
+
+#endif  // FRAMESERVERCONNECTION_H
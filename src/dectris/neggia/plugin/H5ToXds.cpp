@@ -1,8 +1,16 @@
 // SPDX-License-Identifier: MIT
 
 #include "H5ToXds.h"
+#include <assert.h>
+#include <string.h>
+#include <dectris/neggia/data/H5Group.h>
 #include <dectris/neggia/user/Dataset.h>
 #include <dectris/neggia/user/H5File.h>
+#include <dectris/neggia/user/MetadataSnapshot.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -10,8 +18,20 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <vector>
+#include "DataFilePool.h"
+#include "DataFileWatcher.h"
+#include "FrameCache.h"
+#include "FrameServerClient.h"
 #include "H5Error.h"
+#include "NodeLocalMask.h"
+#include "NumaTopology.h"
+#include "PluginConfig.h"
+#include "SharedFrameCache.h"
+#include "SidecarIndex.h"
+#include "StagingEngine.h"
 
 namespace {
 
@@ -22,14 +42,41 @@ struct H5DataCache {
     int dimy;
     int datasize;
     int nframesPerDataset;
-    std::unique_ptr<int32_t[]> mask;
+    std::unique_ptr<NodeLocalMask> mask;
+    /// scalars below /entry/instrument/detector
+    MetadataSnapshot detectorMetadata;
     float xpixelSize;
     float ypixelSize;
     bool masterFileOnly;
+    size_t numberOfFrames;
+    PluginConfig config;
+    /// null unless the frames are read from neggia-served
+    std::unique_ptr<FrameServerClient> server;
+    std::unique_ptr<NumaTopology> numaTopology;
+    std::unique_ptr<StagingEngine> staging;
+    /// null if disabled or if there is no valid index yet
+    std::unique_ptr<SidecarIndex> index;
+    std::unique_ptr<DataFilePool> dataFiles;
+    /// null unless in live mode
+    std::unique_ptr<DataFileWatcher> dataFileWatcher;
+    /// null if disabled
+    std::unique_ptr<FrameCache> frameCache;
+    /// null if disabled or if the segment cannot be used
+    std::unique_ptr<SharedFrameCache> sharedFrameCache;
+    std::atomic<bool> closing{false};
+    /// Writes the sidecar index once the header has been read
+    std::future<void> indexWriter;
+    /// Reads everything plugin_get_header reports, started by plugin_open.
+    /// Declared last so that it is joined before the members it writes to
+    /// are destroyed.
+    std::shared_future<void> headerWarmUp;
 };
 
 std::unique_ptr<H5DataCache> GLOBAL_HANDLE = nullptr;
 
+/// How often a file that is still being written is checked for new frames
+constexpr std::chrono::milliseconds LIVE_POLL_INTERVAL(100);
+
 void printVersionInfo() {
     std::cout << "This is neggia " << VERSION << " (Copyright Dectris 2020)"
               << std::endl;
@@ -72,73 +119,48 @@ void applyMaskAndTransformToInt32(const T* indata,
     }
 }
 
-template <class Type>
-Type readFromDataset(const Dataset& d) {
-    Type val;
-    d.read(&val);
-    return val;
-}
-
-uint64_t readNonZeroUint(const Dataset& d) {
-    assert(d.dataTypeId() == 0);
-    if (d.isSigned()) {
-        int64_t value;
-        switch (d.dataSize()) {
-            case sizeof(int8_t):
-                value = readFromDataset<int8_t>(d);
-                break;
-            case sizeof(int16_t):
-                value = readFromDataset<int16_t>(d);
-                break;
-            case sizeof(int32_t):
-                value = readFromDataset<int32_t>(d);
-                break;
-            case sizeof(int64_t):
-                value = readFromDataset<int64_t>(d);
-                break;
-            default:
-                throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE");
-        }
-        if (value <= 0) {
-            throw H5Error(-4, "NEGGIA ERROR: VALUE ZERO OR NEGATIVE");
+/// Transforms count frames that have been decoded one after the other to
+/// the start of data, as stored in the data file, to int32 in place. The
+/// pixels are transformed from the last one to the first so that none is
+/// overwritten before it has been read, and are read as bytes since data is
+/// an int array.
+template <class T>
+void applyMaskAndTransformToInt32InPlace(int data[],
+                                         const int32_t* mask,
+                                         size_t numberOfPixels,
+                                         size_t count) {
+    const char* indata = (const char*)data;
+    for (size_t i = count; i-- > 0;) {
+        size_t frame = i * numberOfPixels;
+        for (size_t j = numberOfPixels; j-- > 0;) {
+            T value;
+            memcpy(&value, indata + (frame + j) * sizeof(T), sizeof(T));
+            data[frame + j] = mask[j] ? mask[j] : applyOverflow(value);
         }
-        return value;
     }
-    uint64_t value;
-    switch (d.dataSize()) {
-        case sizeof(uint8_t):
-            value = readFromDataset<uint8_t>(d);
-            break;
-        case sizeof(uint16_t):
-            value = readFromDataset<uint16_t>(d);
-            break;
-        case sizeof(uint32_t):
-            value = readFromDataset<uint32_t>(d);
-            break;
-        case sizeof(uint64_t):
-            value = readFromDataset<uint64_t>(d);
-            break;
-        default:
-            throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE");
-    }
-    if (value == 0) {
-        throw H5Error(-4, "NEGGIA ERROR: VALUE MUST BE NON-ZERO");
-    }
-    return value;
 }
 
-double readFloatFromDataset(const Dataset& d) {
-    assert(d.dataTypeId() == 1);
-    switch (d.dataSize()) {
-        case sizeof(float):
-            return readFromDataset<float>(d);
-        case sizeof(double):
-            return readFromDataset<double>(d);
+uint64_t nonZeroUint(const MetadataSnapshot::Value& value) {
+    switch (value.type) {
+        case MetadataSnapshot::Value::SIGNED_INTEGER:
+            if (value.signedInteger <= 0)
+                throw H5Error(-4, "NEGGIA ERROR: VALUE ZERO OR NEGATIVE");
+            return (uint64_t)value.signedInteger;
+        case MetadataSnapshot::Value::UNSIGNED_INTEGER:
+            if (value.unsignedInteger == 0)
+                throw H5Error(-4, "NEGGIA ERROR: VALUE MUST BE NON-ZERO");
+            return value.unsignedInteger;
         default:
             throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE");
     }
 }
 
+double floatValue(const MetadataSnapshot::Value& value) {
+    if (value.type != MetadataSnapshot::Value::FLOAT)
+        throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE");
+    return value.floatingPoint;
+}
+
 H5DataCache* getPreopenedDataCache() {
     H5DataCache* dataCache = GLOBAL_HANDLE.get();
     if (!dataCache) {
@@ -147,6 +169,59 @@ H5DataCache* getPreopenedDataCache() {
     return dataCache;
 }
 
+/// Whether the files may still be written to while they are read
+bool isLive(const H5DataCache* dataCache) {
+    return dataCache->config.liveTimeout > 0;
+}
+
+DataFileWatcher::Deadline getLiveDeadline(const H5DataCache* dataCache) {
+    // the timeout is at most a week, the deadline cannot overflow
+    return std::chrono::steady_clock::now() +
+           std::chrono::seconds(dataCache->config.liveTimeout);
+}
+
+/// Returns an empty string if the dataset at path is stored in the master
+/// file or cannot be located (reported once the dataset is opened)
+std::string getDataFilename(const std::string& path,
+                            const H5DataCache* dataCache) {
+    try {
+        return DataFilePool::locate(dataCache->h5File, path).filename;
+    } catch (const std::exception&) {
+        return std::string();
+    }
+}
+
+/// Data files appear next to the master file while the detector is still
+/// writing, a writer that keeps them readable (SWMR) appends the frames
+/// later on. Opens the dataset at path as soon as its file exists and holds
+/// the dataset. Throws std::out_of_range if the file has not been created
+/// by the deadline, and what opening the dataset threw last if it cannot be
+/// opened by then.
+DataFilePool::DatasetPointer openLiveDataset(
+        const std::string& path,
+        DataFileWatcher::Deadline deadline,
+        const H5DataCache* dataCache) {
+    std::string filename = getDataFilename(path, dataCache);
+    if (dataCache->dataFileWatcher && !filename.empty() &&
+        !dataCache->dataFileWatcher->waitUntilExists(filename, deadline))
+    {
+        throw std::out_of_range(filename + " has not been created");
+    }
+    while (true) {
+        try {
+            return dataCache->dataFiles->open(path);
+        } catch (const std::exception&) {
+            if (dataCache->closing ||
+                std::chrono::steady_clock::now() >= deadline)
+            {
+                throw;
+            }
+        }
+        // e.g. the writer has not created the dataset yet
+        std::this_thread::sleep_for(LIVE_POLL_INTERVAL);
+    }
+}
+
 size_t correctFrameNumberOffset(int frameNumberStartingFromOne) {
     if (frameNumberStartingFromOne < 1) {
         throw H5Error(-2, "NEGGIA ERROR: Framenumbers start from 1");
@@ -176,20 +251,34 @@ std::string getPathToDataset(size_t globalFrameNumber,
     return ss.str();
 }
 
-void setXPixelSize(H5DataCache* dataCache) {
+void readDetectorMetadata(H5DataCache* dataCache) {
     try {
-        Dataset d(dataCache->h5File, "/entry/instrument/detector/x_pixel_size");
-        dataCache->xpixelSize = (float)readFloatFromDataset(d);
-    } catch (const std::out_of_range&) {
+        dataCache->detectorMetadata = MetadataSnapshot(
+                dataCache->h5File, "/entry/instrument/detector");
+    } catch (const std::exception&) {
+        throw H5Error(-4, "NEGGIA ERROR: CANNOT READ DETECTOR METADATA FROM ",
+                      dataCache->filename);
+    }
+}
+
+void setXPixelSize(H5DataCache* dataCache) {
+    MetadataSnapshot::Value value;
+    if (dataCache->detectorMetadata.find(
+                "/entry/instrument/detector/x_pixel_size", value))
+    {
+        dataCache->xpixelSize = (float)floatValue(value);
+    } else {
         dataCache->xpixelSize = 0;
     }
 }
 
 void setYPixelSize(H5DataCache* dataCache) {
-    try {
-        Dataset d(dataCache->h5File, "/entry/instrument/detector/y_pixel_size");
-        dataCache->ypixelSize = (float)readFloatFromDataset(d);
-    } catch (const std::out_of_range&) {
+    MetadataSnapshot::Value value;
+    if (dataCache->detectorMetadata.find(
+                "/entry/instrument/detector/y_pixel_size", value))
+    {
+        dataCache->ypixelSize = (float)floatValue(value);
+    } else {
         dataCache->ypixelSize = 0;
     }
 }
@@ -221,6 +310,11 @@ void preprocessPixelMask(int32_t* dest, ValueType* src, size_t count) {
     }
 }
 
+void setMask(H5DataCache* dataCache, std::shared_ptr<const int32_t> mask) {
+    dataCache->mask.reset(new NodeLocalMask(*dataCache->numaTopology, mask,
+                                            dataCache->dimx * dataCache->dimy));
+}
+
 void setPixelMask(H5DataCache* dataCache) {
     try {
         Dataset pixelMask(
@@ -232,27 +326,28 @@ void setPixelMask(H5DataCache* dataCache) {
         dataCache->dimx = (int)dim[1];
         dataCache->dimy = (int)dim[0];
         size_t s = (size_t)(dataCache->dimx * dataCache->dimy);
-        dataCache->mask.reset(new int32_t[s]);
+        std::shared_ptr<int32_t> mask(new int32_t[s],
+                                      std::default_delete<int32_t[]>());
         if (pixelMask.isSigned()) {
             switch (pixelMask.dataSize()) {
                 case 1: {
                     auto pm = read2D<int8_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 2: {
                     auto pm = read2D<int16_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 4: {
                     auto pm = read2D<int32_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 8: {
                     auto pm = read2D<int64_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 default:
@@ -264,22 +359,22 @@ void setPixelMask(H5DataCache* dataCache) {
             switch (pixelMask.dataSize()) {
                 case 1: {
                     auto pm = read2D<uint8_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 2: {
                     auto pm = read2D<uint16_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 4: {
                     auto pm = read2D<uint32_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 case 8: {
                     auto pm = read2D<uint64_t>(pixelMask);
-                    preprocessPixelMask(dataCache->mask.get(), pm.get(), s);
+                    preprocessPixelMask(mask.get(), pm.get(), s);
                     break;
                 }
                 default:
@@ -288,6 +383,7 @@ void setPixelMask(H5DataCache* dataCache) {
                                   "PIXEL MASK");
             }
         }
+        setMask(dataCache, mask);
     } catch (const std::out_of_range&) {
         throw H5Error(-4, "NEGGIA ERROR: CANNOT READ PIXEL MASK FROM ",
                       dataCache->filename);
@@ -295,81 +391,287 @@ void setPixelMask(H5DataCache* dataCache) {
 }
 
 size_t getNumberOfImages(const H5DataCache* dataCache) {
-    try {
-        Dataset d(dataCache->h5File,
-                  "/entry/instrument/detector/detectorSpecific/nimages");
-        return readNonZeroUint(d);
-    } catch (const std::out_of_range&) {
+    MetadataSnapshot::Value value;
+    if (!dataCache->detectorMetadata.find(
+                "/entry/instrument/detector/detectorSpecific/nimages", value))
+    {
         throw H5Error(-4, "NEGGIA ERROR: CANNOT READ N_IMAGES FROM ",
                       dataCache->filename);
+    }
+    try {
+        return nonZeroUint(value);
     } catch (const H5Error&) {
         throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE FOR N_IMAGES");
     }
 }
 
 size_t getNumberOfTriggers(const H5DataCache* dataCache) {
-    try {
-        Dataset d(dataCache->h5File,
-                  "/entry/instrument/detector/detectorSpecific/ntrigger");
-        return readNonZeroUint(d);
-    } catch (const std::out_of_range&) {
+    MetadataSnapshot::Value value;
+    if (!dataCache->detectorMetadata.find(
+                "/entry/instrument/detector/detectorSpecific/ntrigger", value))
+    {
         std::cerr << "NEGGIA WARNING: "
                      "/entry/instrument/detector/detectorSpecific/ntrigger not "
                      "found, using ntrigger = 1\n";
         return 1;
+    }
+    try {
+        return nonZeroUint(value);
     } catch (const H5Error&) {
         throw H5Error(-4, "NEGGIA ERROR: UNSUPPORTED DATATYPE FOR N_TRIGGER");
     }
 }
 
-void setNFramesPerDatasetFromPath(H5DataCache* dataCache,
-                                  const std::string& path) {
+/// A dataset that is still being written to may not hold all of its frames
+/// yet, in that case its frames are counted from the size it may grow to or,
+/// if it may grow without limit, by spreading the frames over the datasets.
+size_t getNFramesPerDataset(const Dataset& dataset,
+                            size_t numberOfDatasets,
+                            const H5DataCache* dataCache) {
+    size_t nframes = dataset.dim()[0];
+    if (!isLive(dataCache))
+        return nframes;
+    size_t maxFrames = dataset.maxDim()[0];
+    if (maxFrames == Dataset::UNLIMITED) {
+        maxFrames = (dataCache->numberOfFrames + numberOfDatasets - 1) /
+                    numberOfDatasets;
+    }
+    return std::max(nframes, maxFrames);
+}
+
+/// Returns the shape of a frame, {y, x}
+std::vector<size_t> setNFramesPerDatasetFromPath(H5DataCache* dataCache,
+                                                 const std::string& path,
+                                                 size_t numberOfDatasets) {
     try {
-        Dataset dataset(dataCache->h5File, path);
-        auto dim = dataset.dim();
+        auto dataset =
+                isLive(dataCache)
+                        ? openLiveDataset(path, getLiveDeadline(dataCache),
+                                          dataCache)
+                        : dataCache->dataFiles->open(path);
+        auto dim = dataset->dim();
         assert(dim.size() == 3);
-        dataCache->nframesPerDataset = dim[0];
-        assert(dataCache->dimy == dim[1]);
-        assert(dataCache->dimx == dim[2]);
-        dataCache->datasize = dataset.dataSize();
-        assert(dataset.dataTypeId() == 0);
-        assert(dataset.isChunked());
-        assert(dataset.chunkShape() ==
-               std::vector<size_t>({1, (unsigned int)dataCache->dimy,
-                                    (unsigned int)dataCache->dimx}));
+        dataCache->nframesPerDataset =
+                getNFramesPerDataset(*dataset, numberOfDatasets, dataCache);
+        dataCache->datasize = dataset->dataSize();
+        assert(dataset->dataTypeId() == 0);
+        assert(dataset->isChunked());
+        assert(dataset->chunkShape() ==
+               std::vector<size_t>({1, dim[1], dim[2]}));
+        return std::vector<size_t>({dim[1], dim[2]});
     } catch (const std::out_of_range&) {
         throw H5Error(-4, "NEGGIA ERROR: CANNOT OPEN " + path + " FROM ",
                       dataCache->filename);
     }
 }
 
-void setNFramesPerDataset(H5DataCache* dataCache) {
+/// Returns the shape of a frame, {y, x}
+std::vector<size_t> setNFramesPerDataset(H5DataCache* dataCache) {
+    std::vector<H5GroupLink> links;
+    try {
+        links = dataCache->h5File.listGroup("/entry/data");
+    } catch (const std::out_of_range&) {
+        throw H5Error(-4, "NEGGIA ERROR: CANNOT OPEN /entry/data FROM ",
+                      dataCache->filename);
+    }
+    dataCache->masterFileOnly =
+            std::none_of(links.begin(), links.end(),
+                         [](const H5GroupLink& link) {
+                             return link.name == "data_000001";
+                         });
+    if (dataCache->masterFileOnly)
+        return setNFramesPerDatasetFromPath(dataCache, "/entry/data/data", 1);
+    size_t numberOfDatasets =
+            std::count_if(links.begin(), links.end(),
+                          [](const H5GroupLink& link) {
+                              return link.name.compare(0, 5, "data_") == 0;
+                          });
+    return setNFramesPerDatasetFromPath(dataCache, "/entry/data/data_000001",
+                                        numberOfDatasets);
+}
+
+/// Not used in live mode, the index would describe files that still change
+void openSidecarIndex(H5DataCache* dataCache) {
+    if (!dataCache->config.useIndex || isLive(dataCache))
+        return;
     try {
-        setNFramesPerDatasetFromPath(dataCache, "/entry/data/data_000001");
-        dataCache->masterFileOnly = false;
+        dataCache->index.reset(new SidecarIndex(
+                SidecarIndex::indexFilename(dataCache->filename,
+                                            dataCache->config.indexDirectory),
+                dataCache->filename));
+    } catch (const std::runtime_error&) {
+        // missing or out of date, written again once the header is read
+    }
+}
+
+void readHeaderFromIndex(H5DataCache* dataCache) {
+    const SidecarIndex::Header& header = dataCache->index->header();
+    dataCache->dimx = header.dimx;
+    dataCache->dimy = header.dimy;
+    dataCache->datasize = header.datasize;
+    dataCache->nframesPerDataset = header.nframesPerDataset;
+    dataCache->numberOfFrames = header.numberOfFrames;
+    dataCache->xpixelSize = header.xpixelSize;
+    dataCache->ypixelSize = header.ypixelSize;
+    dataCache->masterFileOnly = header.masterFileOnly != 0;
+    setMask(dataCache, dataCache->index->mask());
+}
+
+/// The data files are read by the server. Returns the shape of a frame,
+/// {y, x}.
+std::vector<size_t> readFrameShapeFromServer(H5DataCache* dataCache) {
+    const FrameServerConnection::Header& header = dataCache->server->header();
+    dataCache->datasize = header.dataSize;
+    return std::vector<size_t>({header.ny, header.nx});
+}
+
+/// Opens every data file once to record its chunk index. Data files that
+/// cannot be opened (yet), or are not reached before the file is closed, are
+/// left out and opened the usual way later on.
+void writeSidecarIndex(const H5DataCache* dataCache) {
+    SidecarIndex::Header header = SidecarIndex::Header();
+    header.dimx = dataCache->dimx;
+    header.dimy = dataCache->dimy;
+    header.datasize = dataCache->datasize;
+    header.nframesPerDataset = dataCache->nframesPerDataset;
+    header.numberOfFrames = dataCache->numberOfFrames;
+    header.xpixelSize = dataCache->xpixelSize;
+    header.ypixelSize = dataCache->ypixelSize;
+    header.masterFileOnly = dataCache->masterFileOnly;
+    SidecarIndex::DataFiles dataFiles;
+    size_t nframesPerDataset = (size_t)dataCache->nframesPerDataset;
+    for (size_t firstFrame = 0; firstFrame < dataCache->numberOfFrames;
+         firstFrame += nframesPerDataset)
+    {
+        if (dataCache->closing)
+            break;
+        if (dataCache->masterFileOnly && firstFrame > 0)
+            break;
+        std::string path = getPathToDataset(firstFrame, dataCache);
+        try {
+            auto location = DataFilePool::locate(dataCache->h5File, path);
+            SidecarIndex::DataFile dataFile;
+            if (!location.filename.empty() &&
+                !SidecarIndex::FileIdentity::read(location.filename,
+                                                  dataFile.identity))
+            {
+                continue;
+            }
+            Dataset dataset(dataCache->h5File, path);
+            dataset.indexChunks();
+            if (!dataset.hasChunkIndex())
+                continue;
+            dataFile.filename = location.filename;
+            dataFile.path = location.path;
+            dataFile.chunks = dataset.chunkLocations();
+            dataFiles[path] = dataFile;
+        } catch (const std::exception&) {
+        }
+    }
+    std::string indexFilename = SidecarIndex::indexFilename(
+            dataCache->filename, dataCache->config.indexDirectory);
+    try {
+        SidecarIndex::write(indexFilename, dataCache->filename, header,
+                            dataCache->mask->mask(), dataFiles);
+    } catch (const std::runtime_error& error) {
+        std::cerr << "NEGGIA WARNING: INDEX NOT WRITTEN, " << error.what()
+                  << std::endl;
+    }
+}
+
+/// Decodes the pixel mask on a separate thread while the metadata is read
+/// and the first data file is opened.
+void readHeader(H5DataCache* dataCache) {
+    if (dataCache->index) {
+        readHeaderFromIndex(dataCache);
+        return;
+    }
+    auto pixelMask = std::async(std::launch::async,
+                                [dataCache]() { setPixelMask(dataCache); });
+    std::vector<size_t> frameShape;
+    try {
+        readDetectorMetadata(dataCache);
+        setXPixelSize(dataCache);
+        setYPixelSize(dataCache);
+        size_t nimages = getNumberOfImages(dataCache);
+        size_t ntrigger = getNumberOfTriggers(dataCache);
+        dataCache->numberOfFrames = nimages * ntrigger;
+        frameShape = dataCache->server ? readFrameShapeFromServer(dataCache)
+                                       : setNFramesPerDataset(dataCache);
+    } catch (...) {
+        pixelMask.wait();
+        throw;
+    }
+    pixelMask.get();
+    if (dataCache->server) {
+        if (frameShape != std::vector<size_t>({(size_t)dataCache->dimy,
+                                               (size_t)dataCache->dimx}))
+        {
+            throw H5Error(-4, "NEGGIA ERROR: FRAME SERVER READS FRAMES OF "
+                              "ANOTHER SHAPE THAN THE PIXEL MASK");
+        }
+        return;
+    }
+    assert(frameShape == std::vector<size_t>({(size_t)dataCache->dimy,
+                                              (size_t)dataCache->dimx}));
+    if (dataCache->config.useIndex && !isLive(dataCache)) {
+        dataCache->indexWriter = std::async(
+                std::launch::async,
+                [dataCache]() { writeSidecarIndex(dataCache); });
+    }
+}
+
+/// Needs the frame size, attached once the header has been read
+void startSharedFrameCache(H5DataCache* dataCache) {
+    if (dataCache->config.sharedFrameCacheBudget == 0 || dataCache->server)
+        return;
+    try {
+        dataCache->sharedFrameCache.reset(new SharedFrameCache(
+                dataCache->filename,
+                (size_t)dataCache->dimx * dataCache->dimy,
+                dataCache->config.sharedFrameCacheBudget));
+    } catch (const std::runtime_error& error) {
+        std::cerr << "NEGGIA WARNING: SHARED FRAME CACHE DISABLED, "
+                  << error.what() << std::endl;
+    }
+}
+
+void startHeaderWarmUp(H5DataCache* dataCache) {
+    dataCache->headerWarmUp = std::async(std::launch::async,
+                                         [dataCache]() {
+                                             readHeader(dataCache);
+                                             startSharedFrameCache(dataCache);
+                                         })
+                                      .share();
+}
+
+/// Waits for the header to be read, rethrows the error if reading failed.
+/// Errors other than H5Error are reported as a header error.
+void joinHeaderWarmUp(const H5DataCache* dataCache) {
+    try {
+        dataCache->headerWarmUp.get();
     } catch (const H5Error&) {
-        setNFramesPerDatasetFromPath(dataCache, "/entry/data/data");
-        dataCache->masterFileOnly = true;
+        throw;
+    } catch (const std::exception& error) {
+        throw H5Error(-4, "NEGGIA ERROR: CANNOT READ HEADER: ", error.what());
     }
 }
 
 void applyMaskAndTransformToInt32(const H5DataCache* dataCache,
                                   const void* indata,
                                   int outdata[]) {
+    const int32_t* mask = dataCache->mask->get();
     switch (dataCache->datasize) {
         case 1:
-            applyMaskAndTransformToInt32((const uint8_t*)indata, outdata,
-                                         dataCache->mask.get(),
+            applyMaskAndTransformToInt32((const uint8_t*)indata, outdata, mask,
                                          dataCache->dimx * dataCache->dimy);
             break;
         case 2:
-            applyMaskAndTransformToInt32((const uint16_t*)indata, outdata,
-                                         dataCache->mask.get(),
+            applyMaskAndTransformToInt32((const uint16_t*)indata, outdata, mask,
                                          dataCache->dimx * dataCache->dimy);
             break;
         case 4:
-            applyMaskAndTransformToInt32((const uint32_t*)indata, outdata,
-                                         dataCache->mask.get(),
+            applyMaskAndTransformToInt32((const uint32_t*)indata, outdata, mask,
                                          dataCache->dimx * dataCache->dimy);
             break;
         default: {
@@ -378,26 +680,339 @@ void applyMaskAndTransformToInt32(const H5DataCache* dataCache,
     }
 }
 
-void readDataset(int* frame_number,
+void applyMaskAndTransformToInt32InPlace(const H5DataCache* dataCache,
+                                         int data[],
+                                         size_t count) {
+    const int32_t* mask = dataCache->mask->get();
+    size_t numberOfPixels = dataCache->dimx * dataCache->dimy;
+    switch (dataCache->datasize) {
+        case 1:
+            applyMaskAndTransformToInt32InPlace<uint8_t>(data, mask,
+                                                         numberOfPixels, count);
+            break;
+        case 2:
+            applyMaskAndTransformToInt32InPlace<uint16_t>(
+                    data, mask, numberOfPixels, count);
+            break;
+        case 4:
+            applyMaskAndTransformToInt32InPlace<uint32_t>(
+                    data, mask, numberOfPixels, count);
+            break;
+        default: {
+            throw H5Error(-3, "NEGGIA ERROR: DATATYPE NOT SUPPORTED");
+        }
+    }
+}
+
+void warmUpNextDataset(size_t globalFrameNumber,
+                       const H5DataCache* dataCache) {
+    if (dataCache->masterFileOnly)
+        return;
+    size_t nframesPerDataset = (size_t)dataCache->nframesPerDataset;
+    size_t firstFrameOfNextDataset =
+            (globalFrameNumber / nframesPerDataset + 1) * nframesPerDataset;
+    if (firstFrameOfNextDataset >= dataCache->numberOfFrames)
+        return;
+    std::string path = getPathToDataset(firstFrameOfNextDataset, dataCache);
+    // a data file that is still being written is opened once it is needed
+    if (dataCache->dataFileWatcher &&
+        !dataCache->dataFileWatcher->isComplete(
+                getDataFilename(path, dataCache)))
+    {
+        return;
+    }
+    dataCache->dataFiles->warmUp(path);
+}
+
+std::string locateDataFile(size_t dataFileNumber,
+                           const H5DataCache* dataCache) {
+    size_t firstFrame = dataFileNumber * dataCache->nframesPerDataset;
+    if (dataCache->masterFileOnly || firstFrame >= dataCache->numberOfFrames)
+        return std::string();
+    try {
+        return DataFilePool::locate(dataCache->h5File,
+                                    getPathToDataset(firstFrame, dataCache))
+                .filename;
+    } catch (const std::exception&) {
+        return std::string();
+    }
+}
+
+/// Not used in live mode, a staged copy would miss what is appended later
+void startStaging(H5DataCache* dataCache) {
+    if (dataCache->config.stagingDirectory.empty() || isLive(dataCache))
+        return;
+    try {
+        const H5DataCache* constDataCache = dataCache;
+        dataCache->staging.reset(new StagingEngine(
+                dataCache->config.stagingDirectory,
+                dataCache->config.stagingBudget,
+                dataCache->config.stagingFilesAhead,
+                [constDataCache](size_t dataFileNumber) {
+                    return locateDataFile(dataFileNumber, constDataCache);
+                }));
+    } catch (const std::runtime_error& error) {
+        std::cerr << "NEGGIA WARNING: STAGING DISABLED, " << error.what()
+                  << std::endl;
+    }
+}
+
+/// Waits for the dataset to be opened again until the writer has appended
+/// the chunk at chunkOffset or the deadline has passed
+DataFilePool::DatasetPointer waitForChunk(
+        const std::string& path,
+        DataFilePool::DatasetPointer dataset,
+        const std::vector<size_t>& chunkOffset,
+        DataFileWatcher::Deadline deadline,
+        const H5DataCache* dataCache) {
+    while (!dataset->hasChunk(chunkOffset) &&
+           chunkOffset[0] < dataset->maxDim()[0] && !dataCache->closing &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+        dataset = dataCache->dataFiles->waitForGrowth(
+                path, dataset, LIVE_POLL_INTERVAL, deadline);
+    }
+    return dataset;
+}
+
+void decodeFrame(int frameNumber,
+                 size_t globalFrameNumber,
                  int data_array[],
                  const H5DataCache* dataCache) {
-    size_t globalFrameNumber = correctFrameNumberOffset(*frame_number);
     std::string pathToDataset = getPathToDataset(globalFrameNumber, dataCache);
+    if (dataCache->staging && !dataCache->masterFileOnly) {
+        dataCache->staging->advance(globalFrameNumber /
+                                    dataCache->nframesPerDataset);
+    }
     try {
-        Dataset dataset(dataCache->h5File, pathToDataset);
-        size_t totNumberOfDatasets = dataset.dim()[0];
+        DataFileWatcher::Deadline deadline;
+        DataFilePool::DatasetPointer dataset;
+        if (isLive(dataCache)) {
+            deadline = getLiveDeadline(dataCache);
+            dataset = openLiveDataset(pathToDataset, deadline, dataCache);
+        } else {
+            dataset = dataCache->dataFiles->open(pathToDataset);
+        }
+        warmUpNextDataset(globalFrameNumber, dataCache);
         size_t datasetFrameNumber =
                 getFrameNumberWithinDataset(globalFrameNumber, dataCache);
+        std::vector<size_t> chunkOffset({datasetFrameNumber, 0, 0});
+        if (isLive(dataCache)) {
+            dataset = waitForChunk(pathToDataset, dataset, chunkOffset,
+                                   deadline, dataCache);
+            if (!dataset->hasChunk(chunkOffset))
+                throw std::out_of_range("frame not written yet");
+        }
+        size_t totNumberOfDatasets = dataset->dim()[0];
         if (datasetFrameNumber >= totNumberOfDatasets)
             throw std::out_of_range("frame_number out of range");
+        // first touched by the reading thread, so that it is allocated on
+        // the NUMA node the thread runs on
         std::unique_ptr<char[]> buffer(
                 new char[dataCache->dimx * dataCache->dimy *
                          dataCache->datasize]);
-        dataset.read(buffer.get(),
-                     std::vector<size_t>({datasetFrameNumber, 0, 0}));
+        dataset->read(buffer.get(), chunkOffset);
         applyMaskAndTransformToInt32(dataCache, buffer.get(), data_array);
     } catch (const std::out_of_range&) {
-        throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAME ", *frame_number);
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAME ", frameNumber);
+    }
+}
+
+/// Takes the frame from the shared frame cache if there is one
+void readFrame(int frameNumber,
+               size_t globalFrameNumber,
+               int data_array[],
+               const H5DataCache* dataCache) {
+    if (!dataCache->sharedFrameCache) {
+        decodeFrame(frameNumber, globalFrameNumber, data_array, dataCache);
+        return;
+    }
+    dataCache->sharedFrameCache->read(
+            globalFrameNumber, data_array, [&](int32_t* buffer) {
+                decodeFrame(frameNumber, globalFrameNumber, buffer, dataCache);
+            });
+}
+
+/// The server reads the frame as stored in the data file, the mask is
+/// applied here
+void readFromServer(int frameNumber,
+                    size_t globalFrameNumber,
+                    int data_array[],
+                    const H5DataCache* dataCache) {
+    if (globalFrameNumber >= dataCache->numberOfFrames)
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAME ", frameNumber);
+    std::unique_ptr<char[]> buffer(
+            new char[dataCache->dimx * dataCache->dimy * dataCache->datasize]);
+    FrameServerConnection::Status status;
+    try {
+        status = dataCache->server->read(globalFrameNumber, buffer.get());
+    } catch (const std::runtime_error& error) {
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT READ FRAME ", frameNumber,
+                      " FROM FRAME SERVER, ", error.what());
+    }
+    if (status == FrameServerConnection::CANNOT_READ) {
+        throw H5Error(-2, "NEGGIA ERROR: FRAME SERVER CANNOT OPEN FRAME ",
+                      frameNumber);
+    }
+    if (status != FrameServerConnection::OK) {
+        throw H5Error(-4, "NEGGIA ERROR: FRAME SERVER REJECTED FRAME ",
+                      frameNumber);
+    }
+    applyMaskAndTransformToInt32(dataCache, buffer.get(), data_array);
+}
+
+void readDataset(int* frame_number,
+                 int data_array[],
+                 const H5DataCache* dataCache) {
+    size_t globalFrameNumber = correctFrameNumberOffset(*frame_number);
+    if (dataCache->server) {
+        readFromServer(*frame_number, globalFrameNumber, data_array,
+                       dataCache);
+        return;
+    }
+    if (!dataCache->frameCache) {
+        readFrame(*frame_number, globalFrameNumber, data_array, dataCache);
+        return;
+    }
+    int frameNumber = *frame_number;
+    size_t numberOfPixels = dataCache->dimx * dataCache->dimy;
+    auto frame = dataCache->frameCache->get(
+            globalFrameNumber, numberOfPixels, [&](int32_t* buffer) {
+                readFrame(frameNumber, globalFrameNumber, buffer, dataCache);
+            });
+    std::copy(frame.get(), frame.get() + numberOfPixels, data_array);
+}
+
+/// Decodes count frames that all lie within the same dataset
+void decodeFrames(int firstFrameNumber,
+                  size_t globalFrameNumber,
+                  size_t count,
+                  int data_array[],
+                  const H5DataCache* dataCache) {
+    std::string pathToDataset = getPathToDataset(globalFrameNumber, dataCache);
+    if (dataCache->staging && !dataCache->masterFileOnly) {
+        dataCache->staging->advance(globalFrameNumber /
+                                    dataCache->nframesPerDataset);
+    }
+    try {
+        auto dataset = dataCache->dataFiles->open(pathToDataset);
+        warmUpNextDataset(globalFrameNumber, dataCache);
+        size_t datasetFrameNumber =
+                getFrameNumberWithinDataset(globalFrameNumber, dataCache);
+        if ((size_t)dataCache->datasize > sizeof(int))
+            throw H5Error(-3, "NEGGIA ERROR: DATATYPE NOT SUPPORTED");
+        // the frames as stored take no more space than the transformed ones
+        dataset->readFrames(datasetFrameNumber, count, data_array);
+        applyMaskAndTransformToInt32InPlace(dataCache, data_array, count);
+    } catch (const std::out_of_range&) {
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT OPEN FRAMES ", firstFrameNumber,
+                      " TO ", firstFrameNumber + count - 1);
+    } catch (const H5Error&) {
+        throw;
+    } catch (const std::exception& error) {
+        throw H5Error(-2, "NEGGIA ERROR: CANNOT READ FRAMES ", firstFrameNumber,
+                      " TO ", firstFrameNumber + count - 1, ", ", error.what());
+    }
+}
+
+/// Reads the frames of each dataset with a single Dataset::readFrames call.
+/// Frames that may be cached, served or still be written are read one by
+/// one instead.
+void readDatasetBatch(int firstFrameNumber,
+                      int numberOfFrames,
+                      int data_array[],
+                      const H5DataCache* dataCache) {
+    if (numberOfFrames < 0)
+        throw H5Error(-2, "NEGGIA ERROR: NEGATIVE NUMBER OF FRAMES");
+    size_t numberOfPixels = dataCache->dimx * dataCache->dimy;
+    if (dataCache->server || dataCache->frameCache ||
+        dataCache->sharedFrameCache || isLive(dataCache))
+    {
+        for (int i = 0; i < numberOfFrames; ++i) {
+            int frameNumber = firstFrameNumber + i;
+            readDataset(&frameNumber, data_array + i * numberOfPixels,
+                        dataCache);
+        }
+        return;
+    }
+    size_t firstGlobalFrameNumber = correctFrameNumberOffset(firstFrameNumber);
+    size_t nframesPerDataset = dataCache->nframesPerDataset;
+    for (size_t i = 0; i < (size_t)numberOfFrames;) {
+        size_t globalFrameNumber = firstGlobalFrameNumber + i;
+        size_t count = std::min(
+                (size_t)numberOfFrames - i,
+                nframesPerDataset - globalFrameNumber % nframesPerDataset);
+        decodeFrames(firstFrameNumber + i, globalFrameNumber, count,
+                     data_array + i * numberOfPixels, dataCache);
+        i += count;
+    }
+}
+
+void startFrameCache(H5DataCache* dataCache) {
+    if (dataCache->config.frameCacheBudget > 0) {
+        dataCache->frameCache.reset(
+                new FrameCache(dataCache->config.frameCacheBudget));
+    }
+}
+
+/// Needed before the header is read, which opens the first data file
+void startDataFileWatcher(H5DataCache* dataCache) {
+    if (!isLive(dataCache))
+        return;
+    try {
+        dataCache->dataFileWatcher.reset(
+                new DataFileWatcher(dataCache->h5File.fileDir()));
+    } catch (const std::runtime_error& error) {
+        std::cerr << "NEGGIA WARNING: NOT WATCHING FOR DATA FILES, "
+                  << error.what() << std::endl;
+    }
+}
+
+/// Returns false if NEGGIA_SERVER is not set or the server cannot be used
+bool connectToServer(H5DataCache* dataCache) {
+    if (dataCache->config.serverSocket.empty())
+        return false;
+    try {
+        dataCache->server.reset(new FrameServerClient(
+                dataCache->config.serverSocket, dataCache->filename));
+        return true;
+    } catch (const std::runtime_error& error) {
+        std::cerr << "NEGGIA WARNING: NOT USING FRAME SERVER, " << error.what()
+                  << std::endl;
+        return false;
+    }
+}
+
+/// Sets up everything needed to decode the frames in this process
+void prepareDecoding(H5DataCache* dataCache) {
+    startStaging(dataCache);
+    openSidecarIndex(dataCache);
+    dataCache->dataFiles.reset(new DataFilePool(
+            dataCache->h5File,
+            dataCache->config.dropConsumedPages ? Dataset::DROP_CONSUMED_PAGES
+                                                : Dataset::KEEP_PAGES,
+            dataCache->staging.get(), dataCache->numaTopology.get(),
+            dataCache->index.get()));
+    startFrameCache(dataCache);
+    startDataFileWatcher(dataCache);
+}
+
+void printFrameCacheStatistics(const H5DataCache* dataCache) {
+    if (dataCache->frameCache) {
+        FrameCache::Statistics statistics =
+                dataCache->frameCache->statistics();
+        std::cout << "NEGGIA FRAME CACHE: " << statistics.hits << " HITS ("
+                  << statistics.waits << " WAITED FOR A DECODE), "
+                  << statistics.misses << " MISSES, " << statistics.evictions
+                  << " EVICTIONS" << std::endl;
+    }
+    if (dataCache->sharedFrameCache) {
+        SharedFrameCache::Statistics statistics =
+                dataCache->sharedFrameCache->statistics();
+        std::cout << "NEGGIA SHARED FRAME CACHE: " << statistics.hits
+                  << " HITS (" << statistics.waits
+                  << " WAITED FOR A DECODE), " << statistics.misses
+                  << " MISSES" << std::endl;
     }
 }
 
@@ -419,23 +1034,40 @@ void plugin_open(const char* filename, int info_array[1024], int* error_flag) {
     setInfoArray(info_array);
     *error_flag = 0;
     printVersionInfo();
+    // checked first, so that nothing is started for a file that would be
+    // closed again right away
+    if (GLOBAL_HANDLE) {
+        std::cerr << "NEGGIA ERROR: CAN ONLY OPEN ONE FILE AT A TIME "
+                  << std::endl;
+        *error_flag = -4;
+        return;
+    }
     std::unique_ptr<H5DataCache> dataCache(new H5DataCache);
     try {
         dataCache->filename = filename;
-        dataCache->h5File = H5File(filename);
+        dataCache->config = PluginConfig::fromEnvironment();
+        // files that are still being written are only read in live mode
+        dataCache->h5File = H5File(
+                filename, isLive(dataCache.get()) ? H5File::ACCEPT_SWMR_WRITER
+                                                  : H5File::REJECT_WRITER);
+        // the mask is applied in this process, frames read by the server
+        // included
+        dataCache->numaTopology.reset(
+                new NumaTopology(dataCache->config.numaAware));
+        if (!connectToServer(dataCache.get()))
+            prepareDecoding(dataCache.get());
     } catch (const std::out_of_range&) {
         std::cerr << "NEGGIA ERROR: CANNOT OPEN " << filename << std::endl;
         *error_flag = -4;
         return;
-    }
-    if (GLOBAL_HANDLE) {
-        std::cerr << "NEGGIA ERROR: CAN ONLY OPEN ONE FILE AT A TIME "
-                  << std::endl;
+    } catch (const std::exception& error) {
+        std::cerr << "NEGGIA ERROR: CANNOT OPEN " << filename << ": "
+                  << error.what() << std::endl;
         *error_flag = -4;
         return;
-    } else {
-        GLOBAL_HANDLE = std::move(dataCache);
     }
+    GLOBAL_HANDLE = std::move(dataCache);
+    startHeaderWarmUp(GLOBAL_HANDLE.get());
 }
 
 void plugin_get_header(int* nx,
@@ -449,19 +1081,14 @@ void plugin_get_header(int* nx,
     setInfoArray(info);
     try {
         H5DataCache* dataCache = getPreopenedDataCache();
-        setXPixelSize(dataCache);
-        setYPixelSize(dataCache);
-        setPixelMask(dataCache);
-        size_t nimages = getNumberOfImages(dataCache);
-        size_t ntrigger = getNumberOfTriggers(dataCache);
-        setNFramesPerDataset(dataCache);
+        joinHeaderWarmUp(dataCache);
 
         *nx = dataCache->dimx;
         *ny = dataCache->dimy;
         *nbytes = dataCache->datasize;
         *qx = dataCache->xpixelSize;
         *qy = dataCache->ypixelSize;
-        *number_of_frames = (int)(nimages * ntrigger);
+        *number_of_frames = (int)dataCache->numberOfFrames;
 
     } catch (const H5Error& error) {
         std::cerr << error.what() << std::endl;
@@ -481,6 +1108,7 @@ void plugin_get_data(int* frame_number,
     setInfoArray(info_array);
     try {
         H5DataCache* dataCache = getPreopenedDataCache();
+        joinHeaderWarmUp(dataCache);
         readDataset(frame_number, data_array, dataCache);
     } catch (const H5Error& error) {
         std::cerr << error.what() << std::endl;
@@ -490,7 +1118,60 @@ void plugin_get_data(int* frame_number,
     *error_flag = 0;
 }
 
+void plugin_get_data_batch(int* first_frame_number,
+                           int* number_of_frames,
+                           int* nx,
+                           int* ny,
+                           int data_array[],
+                           int info_array[1024],
+                           int* error_flag) {
+    setInfoArray(info_array);
+    try {
+        H5DataCache* dataCache = getPreopenedDataCache();
+        joinHeaderWarmUp(dataCache);
+        if (*nx < 0 || *ny < 0 ||
+            (size_t)*nx * (size_t)*ny !=
+                    (size_t)dataCache->dimx * (size_t)dataCache->dimy)
+        {
+            throw H5Error(-4, "NEGGIA ERROR: FRAMES OF ", *nx, " x ", *ny,
+                          " PIXELS REQUESTED, THE DETECTOR HAS ",
+                          dataCache->dimx, " x ", dataCache->dimy);
+        }
+        readDatasetBatch(*first_frame_number, *number_of_frames, data_array,
+                         dataCache);
+    } catch (const H5Error& error) {
+        std::cerr << error.what() << std::endl;
+        *error_flag = error.getErrorCode();
+        return;
+    }
+    *error_flag = 0;
+}
+
+void plugin_get_frame_cache_statistics(uint64_t* hits,
+                                       uint64_t* misses,
+                                       int* error_flag) {
+    try {
+        H5DataCache* dataCache = getPreopenedDataCache();
+        FrameCache::Statistics statistics = FrameCache::Statistics();
+        if (dataCache->frameCache)
+            statistics = dataCache->frameCache->statistics();
+        *hits = statistics.hits;
+        *misses = statistics.misses;
+    } catch (const H5Error& error) {
+        std::cerr << error.what() << std::endl;
+        *error_flag = error.getErrorCode();
+        return;
+    }
+    *error_flag = 0;
+}
+
 void plugin_close(int* error_flag) {
+    if (GLOBAL_HANDLE) {
+        GLOBAL_HANDLE->closing = true;
+        if (GLOBAL_HANDLE->dataFileWatcher)
+            GLOBAL_HANDLE->dataFileWatcher->cancel();
+        printFrameCacheStatistics(GLOBAL_HANDLE.get());
+    }
     GLOBAL_HANDLE.reset();
 }
 
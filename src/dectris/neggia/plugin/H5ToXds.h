@@ -32,6 +32,24 @@ void plugin_get_data(int* frame_number,
                      int info_array[1024],
                      int* error_flag);
 
+/// Not part of the XDS plugin interface: reads number_of_frames frames
+/// starting at first_frame_number into data_array, one after the other.
+/// Frames in the same data file are located together and decoded in
+/// parallel.
+void plugin_get_data_batch(int* first_frame_number,
+                           int* number_of_frames,
+                           int* nx,
+                           int* ny,
+                           int data_array[],
+                           int info_array[1024],
+                           int* error_flag);
+
+/// Not part of the XDS plugin interface: the counters of the frame cache
+/// (NEGGIA_FRAME_CACHE) of the open file, 0 if the cache is disabled
+void plugin_get_frame_cache_statistics(uint64_t* hits,
+                                       uint64_t* misses,
+                                       int* error_flag);
+
 void plugin_close(int* error_flag);
 
 #ifdef __cplusplus
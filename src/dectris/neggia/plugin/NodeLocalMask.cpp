@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: MIT
+
+#include "NodeLocalMask.h"
+#include <algorithm>
+
+NodeLocalMask::NodeLocalMask(const NumaTopology& topology,
+                             std::shared_ptr<const int32_t> mask,
+                             size_t size)
+      : _topology(topology),
+        _mask(mask),
+        _size(size),
+        _nodeCopies(new NodeCopy[topology.numberOfNodes()]) {}
+
+const int32_t* NodeLocalMask::get() const {
+    if (_topology.numberOfNodes() == 1)
+        return _mask.get();
+    NodeCopy& nodeCopy = _nodeCopies[_topology.currentNode()];
+    std::call_once(nodeCopy.allocated, [&] {
+        nodeCopy.values.reset(new int32_t[_size]);
+        std::copy(_mask.get(), _mask.get() + _size, nodeCopy.values.get());
+    });
+    return nodeCopy.values.get();
+}
+
+const int32_t* NodeLocalMask::mask() const {
+    return _mask.get();
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef NODELOCALMASK_H
+#define NODELOCALMASK_H
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include "NumaTopology.h"
+
+/// The pixel mask is read for every pixel of every frame. Each NUMA node
+/// gets its own copy, allocated by the first thread that needs it on that
+/// node. Once a copy exists, looking it up takes no lock.
+class NodeLocalMask {
+public:
+    /// mask holds size values, topology must outlive the object
+    NodeLocalMask(const NumaTopology& topology,
+                  std::shared_ptr<const int32_t> mask,
+                  size_t size);
+    NodeLocalMask(const NodeLocalMask&) = delete;
+    NodeLocalMask& operator=(const NodeLocalMask&) = delete;
+
+    /// The copy of the node the calling thread runs on. On a single node,
+    /// the mask itself.
+    const int32_t* get() const;
+    const int32_t* mask() const;
+
+private:
+    struct NodeCopy {
+        std::once_flag allocated;
+        std::unique_ptr<int32_t[]> values;
+    };
+
+    const NumaTopology& _topology;
+    std::shared_ptr<const int32_t> _mask;
+    size_t _size;
+    std::unique_ptr<NodeCopy[]> _nodeCopies;
+};
+
+#endif  // NODELOCALMASK_H
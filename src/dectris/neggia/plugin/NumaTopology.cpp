@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+
+#include "NumaTopology.h"
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+/// Parses lists like "0-3,8,10-11" as found in sysfs
+std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        int first, last;
+        char dash;
+        std::stringstream rangeStream(range);
+        if (!(rangeStream >> first))
+            continue;
+        if (!(rangeStream >> dash >> last) || dash != '-')
+            last = first;
+        for (int value = first; value <= last; ++value)
+            values.push_back(value);
+    }
+    return values;
+}
+
+std::string readLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+}  // namespace
+
+NumaTopology::NumaTopology(bool enabled, const std::string& sysfsPath) {
+#ifdef __linux__
+    if (enabled) {
+        for (int node : parseList(readLine(sysfsPath + "online"))) {
+            auto cpus = parseList(readLine(sysfsPath + "node" +
+                                           std::to_string(node) + "/cpulist"));
+            // memory-only nodes have no CPUs to run workers on
+            if (cpus.empty())
+                continue;
+            for (int cpu : cpus) {
+                if ((size_t)cpu >= _nodeOfCpu.size())
+                    _nodeOfCpu.resize(cpu + 1, 0);
+                _nodeOfCpu[cpu] = _cpusOfNode.size();
+            }
+            _cpusOfNode.push_back(cpus);
+        }
+    }
+#else
+    (void)enabled;
+    (void)sysfsPath;
+#endif
+    if (_cpusOfNode.size() < 2) {
+        _cpusOfNode.clear();
+        _nodeOfCpu.clear();
+    }
+}
+
+size_t NumaTopology::numberOfNodes() const {
+    return _cpusOfNode.empty() ? 1 : _cpusOfNode.size();
+}
+
+size_t NumaTopology::currentNode() const {
+#ifdef __linux__
+    if (!_cpusOfNode.empty()) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && (size_t)cpu < _nodeOfCpu.size())
+            return _nodeOfCpu[cpu];
+    }
+#endif
+    return 0;
+}
+
+void NumaTopology::bindCurrentThread(size_t node) const {
+#ifdef __linux__
+    if (node >= _cpusOfNode.size())
+        return;
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : _cpusOfNode[node]) {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuSet);
+    }
+    sched_setaffinity(0, sizeof(cpuSet), &cpuSet);
+#else
+    (void)node;
+#endif
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef NUMATOPOLOGY_H
+#define NUMATOPOLOGY_H
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/// NUMA nodes of the machine and the CPUs belonging to them, read from
+/// /sys/devices/system/node on Linux. Where this information is not
+/// available, or if disabled, all CPUs form a single node and threads are
+/// never pinned.
+class NumaTopology {
+public:
+    /// sysfsPath is only given by tests
+    explicit NumaTopology(
+            bool enabled,
+            const std::string& sysfsPath = "/sys/devices/system/node/");
+
+    size_t numberOfNodes() const;
+    /// Node of the CPU the calling thread is currently running on
+    size_t currentNode() const;
+    /// Restricts the calling thread to the CPUs of node
+    void bindCurrentThread(size_t node) const;
+
+private:
+    std::vector<std::vector<int>> _cpusOfNode;
+    std::vector<size_t> _nodeOfCpu;
+};
+
+#endif  // NUMATOPOLOGY_H
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+
+#include "PluginConfig.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+
+namespace {
+
+std::string getEnvironment(const char* name, const std::string& defaultValue) {
+    const char* value = getenv(name);
+    return value ? std::string(value) : defaultValue;
+}
+
+bool readPageCachePolicy() {
+    std::string value = getEnvironment("NEGGIA_PAGE_CACHE", "keep");
+    if (value == "drop")
+        return true;
+    if (value != "keep") {
+        std::cerr << "NEGGIA WARNING: IGNORING NEGGIA_PAGE_CACHE=" << value
+                  << ", EXPECTED keep OR drop\n";
+    }
+    return false;
+}
+
+bool readNumaAware() {
+    std::string value = getEnvironment("NEGGIA_NUMA", "on");
+    if (value == "off")
+        return false;
+    if (value != "on") {
+        std::cerr << "NEGGIA WARNING: IGNORING NEGGIA_NUMA=" << value
+                  << ", EXPECTED on OR off\n";
+    }
+    return true;
+}
+
+void readIndex(PluginConfig& config) {
+    std::string value = getEnvironment("NEGGIA_INDEX", "off");
+    config.useIndex = !value.empty() && value != "off";
+    config.indexDirectory = value == "on" || value == "off" ? "" : value;
+}
+
+size_t readSize(const char* name, size_t defaultValue) {
+    std::string value = getEnvironment(name, "");
+    if (value.empty())
+        return defaultValue;
+    char* end;
+    errno = 0;
+    unsigned long long size = strtoull(value.c_str(), &end, 10);
+    const std::string suffixes = "KMGT";
+    size_t suffix = *end ? suffixes.find(*end) : std::string::npos;
+    int shift = 0;
+    if (suffix != std::string::npos) {
+        shift = 10 * (suffix + 1);
+        ++end;
+    }
+    if (end == value.c_str() || *end != '\0' || value[0] == '-') {
+        std::cerr << "NEGGIA WARNING: IGNORING " << name << "=" << value
+                  << ", EXPECTED A NUMBER\n";
+        return defaultValue;
+    }
+    if (errno == ERANGE || size > (SIZE_MAX >> shift)) {
+        std::cerr << "NEGGIA WARNING: IGNORING " << name << "=" << value
+                  << ", NUMBER TOO LARGE\n";
+        return defaultValue;
+    }
+    return size << shift;
+}
+
+/// Longest timeout accepted, far beyond any acquisition and far below
+/// what a deadline on the steady clock can hold
+constexpr unsigned long MAX_SECONDS = 7 * 24 * 60 * 60;
+
+size_t readSeconds(const char* name, size_t defaultValue) {
+    std::string value = getEnvironment(name, "");
+    if (value.empty())
+        return defaultValue;
+    char* end;
+    errno = 0;
+    unsigned long seconds = strtoul(value.c_str(), &end, 10);
+    if (end == value.c_str() || *end != '\0' || value[0] == '-' ||
+        errno == ERANGE || seconds > MAX_SECONDS)
+    {
+        std::cerr << "NEGGIA WARNING: IGNORING " << name << "=" << value
+                  << ", EXPECTED A NUMBER OF SECONDS UP TO " << MAX_SECONDS
+                  << "\n";
+        return defaultValue;
+    }
+    return seconds;
+}
+
+}  // namespace
+
+PluginConfig PluginConfig::fromEnvironment() {
+    PluginConfig config;
+    config.dropConsumedPages = readPageCachePolicy();
+    config.stagingDirectory = getEnvironment("NEGGIA_STAGING_DIR", "");
+    config.stagingBudget =
+            readSize("NEGGIA_STAGING_BUDGET", size_t(8) << 30);
+    config.stagingFilesAhead = readSize("NEGGIA_STAGING_AHEAD", 2);
+    if (config.stagingFilesAhead == 0)
+        config.stagingFilesAhead = 1;
+    config.numaAware = readNumaAware();
+    readIndex(config);
+    config.frameCacheBudget = readSize("NEGGIA_FRAME_CACHE", 0);
+    config.sharedFrameCacheBudget =
+            readSize("NEGGIA_SHARED_FRAME_CACHE", 0);
+    config.liveTimeout = readSeconds("NEGGIA_LIVE_TIMEOUT", 0);
+    config.serverSocket = getEnvironment("NEGGIA_SERVER", "");
+    return config;
+}
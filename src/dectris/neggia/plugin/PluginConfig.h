@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PLUGINCONFIG_H
+#define PLUGINCONFIG_H
+#include <stddef.h>
+#include <string>
+
+/// Runtime options of the XDS plugin. XDS passes nothing but the filename
+/// to the plugin, therefore the options are read from environment variables.
+struct PluginConfig {
+    /// NEGGIA_PAGE_CACHE=drop releases the pages of a frame from the page
+    /// cache once it has been decoded, NEGGIA_PAGE_CACHE=keep (default)
+    /// leaves them cached for jobs that read the frames more than once.
+    bool dropConsumedPages;
+    /// NEGGIA_STAGING_DIR enables copying the data files ahead of the
+    /// current frame into a fast local directory, empty if disabled.
+    std::string stagingDirectory;
+    /// NEGGIA_STAGING_BUDGET limits the size of the staged copies, bytes
+    /// with an optional K, M, G or T suffix.
+    size_t stagingBudget;
+    /// NEGGIA_STAGING_AHEAD is the number of data files staged ahead.
+    size_t stagingFilesAhead;
+    /// NEGGIA_NUMA=off disables pinning the warm-up threads to NUMA nodes
+    /// and keeping node-local copies of the pixel mask.
+    bool numaAware;
+    /// NEGGIA_INDEX=on keeps a sidecar index next to the master file,
+    /// NEGGIA_INDEX=<directory> keeps it in that directory and
+    /// NEGGIA_INDEX=off (default) disables it.
+    bool useIndex;
+    /// empty if the index is kept next to the master file
+    std::string indexDirectory;
+    /// NEGGIA_FRAME_CACHE keeps decoded frames in memory up to that many
+    /// bytes, with an optional K, M, G or T suffix. 0 (default) disables it.
+    size_t frameCacheBudget;
+    /// NEGGIA_SHARED_FRAME_CACHE shares decoded frames with the other
+    /// processes on the node reading the same master file, in a shared
+    /// memory segment of that many bytes. 0 (default) disables it.
+    size_t sharedFrameCacheBudget;
+    /// NEGGIA_LIVE_TIMEOUT enables reading files that are still being
+    /// written: a frame that has not been written yet is waited for up to
+    /// that many seconds, at most a week. 0 (default) disables it.
+    size_t liveTimeout;
+    /// NEGGIA_SERVER is the socket of a neggia-served instance to read the
+    /// frames from instead of decoding them, empty if not set.
+    std::string serverSocket;
+
+    static PluginConfig fromEnvironment();
+};
+
+#endif  // PLUGINCONFIG_H
@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: MIT
+
+#include "SharedFrameCache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "SidecarIndex.h"
+
+constexpr uint32_t SharedFrameCache::FORMAT_VERSION;
+constexpr size_t SharedFrameCache::MAX_PROBES;
+
+/// Lives at the start of the segment, followed by the slots and the frames
+struct SharedFrameCache::Segment {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint64_t frameBytes;
+    std::atomic<uint64_t> useCounter;
+};
+
+/// The state packs the frame number + 1 (upper 32 bits, 0 if empty), the
+/// status (2 bits) and, depending on the status, the process id of the
+/// writer or the number of readers (lower 30 bits).
+struct SharedFrameCache::Slot {
+    std::atomic<uint64_t> state;
+    std::atomic<uint64_t> lastUse;
+};
+
+namespace {
+
+const char MAGIC[8] = {'N', 'E', 'G', 'G', 'I', 'A', 'F', 'C'};
+
+const uint64_t EMPTY = 0;
+const uint64_t WRITING = 1;
+const uint64_t READY = 2;
+
+const uint64_t MAX_KEY = std::numeric_limits<uint32_t>::max();
+const uint64_t LOW_BITS = (uint64_t(1) << 30) - 1;
+
+/// Lookups that lose a race against another process start over this often
+/// before the frame is decoded without the segment
+const size_t MAX_ATTEMPTS = 16;
+/// How long to wait for another process decoding a frame
+const std::chrono::seconds WAIT_TIMEOUT(10);
+/// How often a process opens the segment again that the last process
+/// detaching has removed in the meantime
+const int MAX_OPENS = 8;
+
+/// Bytes of the segment locked with record locks. Attaching and detaching
+/// processes take turns with an exclusive lock on the guard. Every attached
+/// process holds a shared lock on the attachment byte, the exclusive lock on
+/// it is only granted if no other process is attached.
+const off_t GUARD_LOCK = 0;
+const off_t ATTACHMENT_LOCK = 1;
+
+#ifdef F_OFD_SETLK
+// locks of the open file description, converted atomically
+const int SET_LOCK = F_OFD_SETLK;
+const int SET_LOCK_AND_WAIT = F_OFD_SETLKW;
+#else
+// locks of the process, one cache per process at a time
+const int SET_LOCK = F_SETLK;
+const int SET_LOCK_AND_WAIT = F_SETLKW;
+#endif
+
+uint64_t pack(uint64_t key, uint64_t status, uint64_t lowBits) {
+    return key << 32 | status << 30 | lowBits;
+}
+
+uint64_t keyOf(uint64_t state) {
+    return state >> 32;
+}
+
+uint64_t statusOf(uint64_t state) {
+    return (state >> 30) & 0x3;
+}
+
+uint64_t lowBitsOf(uint64_t state) {
+    return state & LOW_BITS;
+}
+
+bool writerIsAlive(uint64_t state) {
+    return kill((pid_t)lowBitsOf(state), 0) == 0 || errno != ESRCH;
+}
+
+bool lockByte(int fd, off_t offset, short type, bool wait) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = offset;
+    lock.l_len = 1;
+    while (fcntl(fd, wait ? SET_LOCK_AND_WAIT : SET_LOCK, &lock) != 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+/// Whether name still refers to the segment, i.e. it has not been removed
+/// since it was opened
+bool isLinked(const std::string& name, const struct stat& segmentStatus) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+    if (fd < 0)
+        return false;
+    struct stat linkedStatus;
+    bool isLinked = fstat(fd, &linkedStatus) == 0 &&
+                    linkedStatus.st_dev == segmentStatus.st_dev &&
+                    linkedStatus.st_ino == segmentStatus.st_ino;
+    close(fd);
+    return isLinked;
+}
+
+size_t alignToCacheLine(size_t size) {
+    return (size + 63) / 64 * 64;
+}
+
+/// FNV-1a over the identity of the master file and the geometry, processes
+/// with a different budget use a segment of their own
+std::string segmentName(const SidecarIndex::FileIdentity& identity,
+                        uint64_t frameBytes,
+                        uint64_t slotCount) {
+    uint64_t fields[] = {identity.size,
+                         (uint64_t)identity.modificationSeconds,
+                         (uint64_t)identity.modificationNanoseconds,
+                         identity.inode,
+                         identity.device,
+                         frameBytes,
+                         slotCount};
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*)fields;
+    for (size_t i = 0; i < sizeof(fields); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    std::ostringstream name;
+    name << "/neggia-" << std::hex << std::setw(16) << std::setfill('0')
+         << hash;
+    return name.str();
+}
+
+}  // namespace
+
+SharedFrameCache::SharedFrameCache(const std::string& masterFilename,
+                                   size_t numberOfPixels,
+                                   size_t budget)
+      : _frameBytes(numberOfPixels * sizeof(int32_t)),
+        _slotCount(_frameBytes > 0 ? budget / _frameBytes : 0),
+        _fd(-1),
+        _segment(nullptr),
+        _slots(nullptr),
+        _frames(nullptr),
+        _hits(0),
+        _waits(0),
+        _misses(0) {
+    if (_slotCount < MAX_PROBES)
+        throw std::runtime_error("budget too small for the frame size");
+    if (_slotCount > std::numeric_limits<uint32_t>::max())
+        _slotCount = std::numeric_limits<uint32_t>::max();
+    SidecarIndex::FileIdentity identity;
+    if (!SidecarIndex::FileIdentity::read(masterFilename, identity))
+        throw std::runtime_error("cannot access " + masterFilename);
+    _name = segmentName(identity, _frameBytes, _slotCount);
+    size_t framesOffset = alignToCacheLine(
+            alignToCacheLine(sizeof(Segment)) + _slotCount * sizeof(Slot));
+    _mappingSize = framesOffset + _slotCount * _frameBytes;
+    for (int open = 0;; ++open) {
+        if (open == MAX_OPENS)
+            throw std::runtime_error("shared memory keeps being removed");
+        _fd = shm_open(_name.c_str(), O_RDWR | O_CREAT, 0600);
+        if (_fd < 0)
+            throw std::runtime_error("cannot open shared memory " + _name);
+        bool isAttached;
+        try {
+            isAttached = attach();
+        } catch (const std::runtime_error&) {
+            if (_segment)
+                munmap(_segment, _mappingSize);
+            // releases the locks
+            close(_fd);
+            throw;
+        }
+        if (isAttached)
+            break;
+        close(_fd);
+    }
+    _frames = (char*)_segment + framesOffset;
+}
+
+SharedFrameCache::~SharedFrameCache() {
+    munmap(_segment, _mappingSize);
+    // the conversion of the shared lock only succeeds if no other process
+    // is attached, and no other process attaches while the guard is held
+    if (lockByte(_fd, GUARD_LOCK, F_WRLCK, true) &&
+        lockByte(_fd, ATTACHMENT_LOCK, F_WRLCK, false))
+    {
+        shm_unlink(_name.c_str());
+    }
+    close(_fd);
+}
+
+void SharedFrameCache::read(size_t frameNumber,
+                            int32_t* frame,
+                            const Decoder& decode) {
+    uint64_t key = (uint64_t)frameNumber + 1;
+    Lookup lookup = DECODE_LOCALLY;
+    for (size_t attempt = 0; attempt < MAX_ATTEMPTS && key <= MAX_KEY;
+         ++attempt)
+    {
+        lookup = tryRead(key, frame, decode);
+        if (lookup != RETRY)
+            break;
+    }
+    if (lookup == COPIED) {
+        ++_hits;
+        return;
+    }
+    ++_misses;
+    if (lookup != DECODED)
+        decode(frame);
+}
+
+SharedFrameCache::Statistics SharedFrameCache::statistics() const {
+    Statistics statistics;
+    statistics.hits = _hits;
+    statistics.waits = _waits;
+    statistics.misses = _misses;
+    return statistics;
+}
+
+const std::string& SharedFrameCache::name() const {
+    return _name;
+}
+
+SharedFrameCache::Lookup SharedFrameCache::tryRead(uint64_t key,
+                                                   int32_t* frame,
+                                                   const Decoder& decode) {
+    // every process probes the same slots in the same order and picks the
+    // same victim, so that processes missing the same frame at the same time
+    // race for the same slot and the losers find the frame being decoded
+    size_t home = (key * 0x9e3779b97f4a7c15ull) % _slotCount;
+    Slot* victim = nullptr;
+    uint64_t victimState = 0;
+    for (size_t probe = 0; probe < MAX_PROBES; ++probe) {
+        Slot& slot = _slots[(home + probe) % _slotCount];
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+        uint64_t status = statusOf(state);
+        if (keyOf(state) == key && status == READY)
+            return tryCopy(slot, key, frame) ? COPIED : RETRY;
+        if (keyOf(state) == key && status == WRITING) {
+            ++_waits;
+            return waitForWriter(slot, key) ? RETRY : DECODE_LOCALLY;
+        }
+        if (victim && statusOf(victimState) != READY)
+            continue;
+        bool isFree = status == EMPTY ||
+                      (status == WRITING && !writerIsAlive(state));
+        if (isFree) {
+            victim = &slot;
+            victimState = state;
+        } else if (status == READY && lowBitsOf(state) == 0 &&
+                   (!victim || slot.lastUse < victim->lastUse))
+        {
+            victim = &slot;
+            victimState = state;
+        }
+    }
+    if (!victim)
+        return DECODE_LOCALLY;
+    uint64_t claimed = pack(key, WRITING, (uint64_t)getpid());
+    if (!victim->state.compare_exchange_strong(victimState, claimed,
+                                               std::memory_order_acq_rel))
+    {
+        return RETRY;
+    }
+    decodeIntoSlot(*victim, key, frame, decode);
+    return DECODED;
+}
+
+bool SharedFrameCache::tryCopy(Slot& slot, uint64_t key, int32_t* frame) {
+    uint64_t state = slot.state.load(std::memory_order_acquire);
+    do {
+        if (keyOf(state) != key || statusOf(state) != READY)
+            return false;
+    } while (!slot.state.compare_exchange_weak(state, state + 1,
+                                               std::memory_order_acq_rel));
+    memcpy(frame, frameData(slot), _frameBytes);
+    slot.lastUse = ++_segment->useCounter;
+    slot.state.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool SharedFrameCache::waitForWriter(Slot& slot, uint64_t key) {
+    auto deadline = std::chrono::steady_clock::now() + WAIT_TIMEOUT;
+    while (true) {
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+        if (keyOf(state) != key || statusOf(state) != WRITING)
+            return true;
+        if (!writerIsAlive(state)) {
+            slot.state.compare_exchange_strong(state, pack(0, EMPTY, 0));
+            return true;
+        }
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+void SharedFrameCache::decodeIntoSlot(Slot& slot,
+                                      uint64_t key,
+                                      int32_t* frame,
+                                      const Decoder& decode) {
+    try {
+        decode(frame);
+    } catch (...) {
+        slot.state.store(pack(0, EMPTY, 0), std::memory_order_release);
+        throw;
+    }
+    memcpy(frameData(slot), frame, _frameBytes);
+    slot.lastUse = ++_segment->useCounter;
+    slot.state.store(pack(key, READY, 0), std::memory_order_release);
+}
+
+bool SharedFrameCache::attach() {
+    // the locks are released by closing the segment if this throws
+    if (!lockByte(_fd, GUARD_LOCK, F_WRLCK, true))
+        throw std::runtime_error("cannot lock shared memory " + _name);
+    struct stat segmentStatus;
+    if (fstat(_fd, &segmentStatus) != 0)
+        throw std::runtime_error("cannot access shared memory " + _name);
+    if (!isLinked(_name, segmentStatus))
+        return false;
+    bool alone = lockByte(_fd, ATTACHMENT_LOCK, F_WRLCK, false);
+    bool isNew = (size_t)segmentStatus.st_size != _mappingSize;
+    if (isNew && (!alone || ftruncate(_fd, _mappingSize) != 0))
+        throw std::runtime_error("cannot resize shared memory " + _name);
+    void* address = mmap(NULL, _mappingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, _fd, 0);
+    if (address == MAP_FAILED)
+        throw std::runtime_error("cannot map shared memory " + _name);
+    _segment = (Segment*)address;
+    if (!_segment->useCounter.is_lock_free())
+        throw std::runtime_error("no lock-free atomics in shared memory");
+    _slots = (Slot*)((char*)_segment + alignToCacheLine(sizeof(Segment)));
+    bool isValid = memcmp(_segment->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                   _segment->version == FORMAT_VERSION &&
+                   _segment->slotCount == _slotCount &&
+                   _segment->frameBytes == _frameBytes;
+    if (alone) {
+        if (isValid)
+            recover();
+        else
+            initialize();
+    } else if (!isValid) {
+        throw std::runtime_error("unexpected content in " + _name);
+    }
+    if (!lockByte(_fd, ATTACHMENT_LOCK, F_RDLCK, false) ||
+        !lockByte(_fd, GUARD_LOCK, F_UNLCK, false))
+    {
+        throw std::runtime_error("cannot lock shared memory " + _name);
+    }
+    return true;
+}
+
+void SharedFrameCache::initialize() {
+    memset((void*)_segment, 0, (char*)(_slots + _slotCount) - (char*)_segment);
+    _segment->version = FORMAT_VERSION;
+    _segment->slotCount = (uint32_t)_slotCount;
+    _segment->frameBytes = _frameBytes;
+    memcpy(_segment->magic, MAGIC, sizeof(MAGIC));
+}
+
+void SharedFrameCache::recover() {
+    // no other process is attached: claims and references left in the
+    // segment belong to processes that died while holding them
+    for (size_t i = 0; i < _slotCount; ++i) {
+        uint64_t state = _slots[i].state;
+        if (statusOf(state) == WRITING)
+            _slots[i].state = pack(0, EMPTY, 0);
+        else if (statusOf(state) == READY)
+            _slots[i].state = pack(keyOf(state), READY, 0);
+    }
+}
+
+int32_t* SharedFrameCache::frameData(const Slot& slot) const {
+    return (int32_t*)(_frames + (&slot - _slots) * _frameBytes);
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef SHAREDFRAMECACHE_H
+#define SHAREDFRAMECACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+
+/// Decoded frames shared by all processes on a node that read the same
+/// master file, e.g. parallel XDS jobs on the same sweep. The frames live in
+/// a POSIX shared memory segment named after the identity of the master file
+/// and the frame size. The segment is an open-addressed table of slots, each
+/// holding one frame. A process claims a slot with a compare-and-swap, the
+/// first process to miss a frame decodes it and the others copy it out.
+/// Readers pin a slot with a reference count while copying, pinned slots
+/// and slots being written are never evicted.
+///
+/// A process that dies while writing a slot leaves its process id in the
+/// slot, the next process waiting for that frame frees the slot again. When
+/// a process attaches and finds no other process attached, all claims and
+/// references left behind by crashed processes are dropped. The last
+/// process to detach removes the segment. Processes attach and detach one at
+/// a time under a record lock on the segment.
+class SharedFrameCache {
+public:
+    /// Decodes a frame into the given buffer
+    typedef std::function<void(int32_t* frame)> Decoder;
+
+    struct Statistics {
+        /// frames copied from the segment, including the ones that waited
+        uint64_t hits;
+        /// frames that were being decoded by another process or thread
+        uint64_t waits;
+        uint64_t misses;
+    };
+
+    /// Attaches to the segment for the frames of masterFilename, creating
+    /// it with as many frames as fit into budget bytes if it does not exist
+    /// yet. Throws std::runtime_error if the segment cannot be used.
+    SharedFrameCache(const std::string& masterFilename,
+                     size_t numberOfPixels,
+                     size_t budget);
+    ~SharedFrameCache();
+    SharedFrameCache(const SharedFrameCache&) = delete;
+    SharedFrameCache& operator=(const SharedFrameCache&) = delete;
+
+    /// Copies the frame into frame, decoding it with decode and storing it
+    /// in the segment if no process has done so yet. Rethrows what decode
+    /// throws.
+    void read(size_t frameNumber, int32_t* frame, const Decoder& decode);
+    Statistics statistics() const;
+    const std::string& name() const;
+
+    constexpr static uint32_t FORMAT_VERSION = 1;
+    /// number of slots searched for a frame
+    constexpr static size_t MAX_PROBES = 8;
+
+private:
+    struct Slot;
+    struct Segment;
+
+    /// Outcome of looking for a frame
+    enum Lookup { COPIED, DECODED, RETRY, DECODE_LOCALLY };
+
+    Lookup tryRead(uint64_t key, int32_t* frame, const Decoder& decode);
+    bool tryCopy(Slot& slot, uint64_t key, int32_t* frame);
+    bool waitForWriter(Slot& slot, uint64_t key);
+    void decodeIntoSlot(Slot& slot,
+                        uint64_t key,
+                        int32_t* frame,
+                        const Decoder& decode);
+    /// Returns false if the segment has been removed since it was opened
+    bool attach();
+    void initialize();
+    void recover();
+    int32_t* frameData(const Slot& slot) const;
+
+    std::string _name;
+    size_t _frameBytes;
+    size_t _slotCount;
+    size_t _mappingSize;
+    int _fd;
+    Segment* _segment;
+    Slot* _slots;
+    char* _frames;
+    std::atomic<uint64_t> _hits;
+    std::atomic<uint64_t> _waits;
+    std::atomic<uint64_t> _misses;
+};
+
+#endif  // SHAREDFRAMECACHE_H
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: MIT
+
+#include "SidecarIndex.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+constexpr uint32_t SidecarIndex::FORMAT_VERSION;
+
+namespace {
+
+const char MAGIC[8] = {'N', 'E', 'G', 'G', 'I', 'A', 'I', 'X'};
+
+/// Bounds-checked reads from the mapped index
+class Reader {
+public:
+    Reader(const char* begin, const char* end) : _position(begin), _end(end) {}
+
+    template <class T>
+    T read() {
+        T value;
+        memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+    std::string readString() {
+        uint64_t size = read<uint64_t>();
+        const char* data = take(size);
+        return std::string(data, size);
+    }
+    const char* take(uint64_t size) {
+        if (size > (uint64_t)(_end - _position))
+            throw std::runtime_error("index is truncated");
+        const char* data = _position;
+        _position += size;
+        return data;
+    }
+    void align(size_t alignment, const char* begin) {
+        size_t offset = _position - begin;
+        take((alignment - offset % alignment) % alignment);
+    }
+
+private:
+    const char* _position;
+    const char* _end;
+};
+
+template <class T>
+void append(std::string& buffer, const T& value) {
+    buffer.append((const char*)&value, sizeof(T));
+}
+
+void appendString(std::string& buffer, const std::string& value) {
+    append(buffer, (uint64_t)value.size());
+    buffer.append(value);
+}
+
+void appendIdentity(std::string& buffer,
+                    const SidecarIndex::FileIdentity& identity) {
+    append(buffer, identity.size);
+    append(buffer, identity.modificationSeconds);
+    append(buffer, identity.modificationNanoseconds);
+    append(buffer, identity.inode);
+    append(buffer, identity.device);
+}
+
+SidecarIndex::FileIdentity readIdentity(Reader& reader) {
+    SidecarIndex::FileIdentity identity;
+    identity.size = reader.read<uint64_t>();
+    identity.modificationSeconds = reader.read<int64_t>();
+    identity.modificationNanoseconds = reader.read<int64_t>();
+    identity.inode = reader.read<uint64_t>();
+    identity.device = reader.read<uint64_t>();
+    return identity;
+}
+
+std::shared_ptr<const char> mapIndex(const std::string& filename,
+                                     size_t& size) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + filename);
+    struct stat fileStatus;
+    if (fstat(fd, &fileStatus) != 0 || fileStatus.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("cannot read " + filename);
+    }
+    size = (size_t)fileStatus.st_size;
+    void* address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+        throw std::runtime_error("cannot map " + filename);
+    return std::shared_ptr<const char>(
+            (const char*)address,
+            [size](const char* address) { munmap((void*)address, size); });
+}
+
+bool writeAll(int fd, const std::string& buffer) {
+    for (size_t written = 0; written < buffer.size();) {
+        ssize_t n = ::write(fd, buffer.data() + written,
+                            buffer.size() - written);
+        if (n < 0 && errno != EINTR)
+            return false;
+        if (n > 0)
+            written += n;
+    }
+    return true;
+}
+
+/// FNV-1a, distinguishes master files of the same name in a shared directory
+uint64_t hashPath(const std::string& path) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : path) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+bool SidecarIndex::FileIdentity::read(const std::string& filename,
+                                      FileIdentity& identity) {
+    struct stat fileStatus;
+    if (stat(filename.c_str(), &fileStatus) != 0)
+        return false;
+    identity.size = (uint64_t)fileStatus.st_size;
+#ifdef __APPLE__
+    identity.modificationSeconds = fileStatus.st_mtimespec.tv_sec;
+    identity.modificationNanoseconds = fileStatus.st_mtimespec.tv_nsec;
+#else
+    identity.modificationSeconds = fileStatus.st_mtim.tv_sec;
+    identity.modificationNanoseconds = fileStatus.st_mtim.tv_nsec;
+#endif
+    identity.inode = (uint64_t)fileStatus.st_ino;
+    identity.device = (uint64_t)fileStatus.st_dev;
+    return true;
+}
+
+bool SidecarIndex::FileIdentity::operator==(const FileIdentity& other) const {
+    return size == other.size &&
+           modificationSeconds == other.modificationSeconds &&
+           modificationNanoseconds == other.modificationNanoseconds &&
+           inode == other.inode && device == other.device;
+}
+
+SidecarIndex::SidecarIndex(const std::string& indexFilename,
+                           const std::string& masterFilename) {
+    size_t size;
+    _mapping = mapIndex(indexFilename, size);
+    const char* begin = _mapping.get();
+    Reader reader(begin, begin + size);
+    if (memcmp(reader.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0 ||
+        reader.read<uint32_t>() != FORMAT_VERSION)
+    {
+        throw std::runtime_error(indexFilename + " is not a neggia index");
+    }
+    reader.read<uint32_t>();
+    FileIdentity master;
+    if (!FileIdentity::read(masterFilename, master) ||
+        !(readIdentity(reader) == master))
+    {
+        throw std::runtime_error(indexFilename + " is out of date");
+    }
+    _header = reader.read<Header>();
+    if (_header.dimx < 0 || _header.dimy < 0)
+        throw std::runtime_error(indexFilename + " is corrupt");
+    reader.align(sizeof(uint64_t), begin);
+    _mask = (const int32_t*)reader.take((uint64_t)_header.dimx *
+                                        _header.dimy * sizeof(int32_t));
+    reader.align(sizeof(uint64_t), begin);
+    uint64_t numberOfDataFiles = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < numberOfDataFiles; ++i) {
+        std::string path = reader.readString();
+        DataFile& dataFile = _dataFiles[path];
+        dataFile.filename = reader.readString();
+        dataFile.path = reader.readString();
+        dataFile.identity = readIdentity(reader);
+        uint64_t numberOfChunks = reader.read<uint64_t>();
+        const char* chunks =
+                reader.take(numberOfChunks * sizeof(Dataset::ChunkLocation));
+        dataFile.chunks.resize(numberOfChunks);
+        memcpy(dataFile.chunks.data(), chunks,
+               numberOfChunks * sizeof(Dataset::ChunkLocation));
+    }
+}
+
+const SidecarIndex::Header& SidecarIndex::header() const {
+    return _header;
+}
+
+std::shared_ptr<const int32_t> SidecarIndex::mask() const {
+    return std::shared_ptr<const int32_t>(_mapping, _mask);
+}
+
+bool SidecarIndex::findDataFile(const std::string& path,
+                                DataFile& dataFile) const {
+    auto found = _dataFiles.find(path);
+    if (found == _dataFiles.end())
+        return false;
+    dataFile = found->second;
+    return true;
+}
+
+bool SidecarIndex::isUnchanged(const DataFile& dataFile) {
+    // the master file has been checked when the index was opened
+    if (dataFile.filename.empty())
+        return true;
+    FileIdentity identity;
+    return FileIdentity::read(dataFile.filename, identity) &&
+           identity == dataFile.identity;
+}
+
+void SidecarIndex::write(const std::string& indexFilename,
+                         const std::string& masterFilename,
+                         const Header& header,
+                         const int32_t* mask,
+                         const DataFiles& dataFiles) {
+    FileIdentity master;
+    if (!FileIdentity::read(masterFilename, master))
+        throw std::runtime_error("cannot access " + masterFilename);
+    std::string buffer(MAGIC, sizeof(MAGIC));
+    append(buffer, FORMAT_VERSION);
+    append(buffer, (uint32_t)0);
+    appendIdentity(buffer, master);
+    append(buffer, header);
+    buffer.resize((buffer.size() + 7) / 8 * 8);
+    buffer.append((const char*)mask,
+                  (size_t)header.dimx * header.dimy * sizeof(int32_t));
+    buffer.resize((buffer.size() + 7) / 8 * 8);
+    append(buffer, (uint64_t)dataFiles.size());
+    for (const auto& dataFile : dataFiles) {
+        appendString(buffer, dataFile.first);
+        appendString(buffer, dataFile.second.filename);
+        appendString(buffer, dataFile.second.path);
+        appendIdentity(buffer, dataFile.second.identity);
+        append(buffer, (uint64_t)dataFile.second.chunks.size());
+        buffer.append((const char*)dataFile.second.chunks.data(),
+                      dataFile.second.chunks.size() *
+                              sizeof(Dataset::ChunkLocation));
+    }
+
+    // several jobs may write the index of the same master file at once, the
+    // complete index appears atomically under its final name
+    std::string partial = indexFilename + "." + std::to_string(getpid());
+    int fd = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot create " + partial);
+    bool success = writeAll(fd, buffer);
+    success = close(fd) == 0 && success;
+    if (success)
+        success = rename(partial.c_str(), indexFilename.c_str()) == 0;
+    if (!success) {
+        unlink(partial.c_str());
+        throw std::runtime_error("cannot write " + indexFilename);
+    }
+}
+
+std::string SidecarIndex::indexFilename(const std::string& masterFilename,
+                                        const std::string& directory) {
+    if (directory.empty())
+        return masterFilename + ".neggia-index";
+    std::string absolutePath = masterFilename;
+    char resolved[PATH_MAX];
+    if (realpath(masterFilename.c_str(), resolved))
+        absolutePath = resolved;
+    size_t slash = absolutePath.find_last_of('/');
+    std::string baseName = slash == std::string::npos
+                                   ? absolutePath
+                                   : absolutePath.substr(slash + 1);
+    std::ostringstream filename;
+    filename << directory << "/" << baseName << "-" << std::hex
+             << std::setw(16) << std::setfill('0') << hashPath(absolutePath)
+             << ".neggia-index";
+    return filename.str();
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef SIDECARINDEX_H
+#define SIDECARINDEX_H
+#include <dectris/neggia/user/Dataset.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// A compact binary file that keeps what reading the header of a master file
+/// and opening its data files found: the header values, the preprocessed
+/// pixel mask and the chunk index of every data file. XDS runs every job
+/// step in a new process; the next step maps the index instead of doing all
+/// of that work again. The index is only used while size, modification time
+/// and inode of the master file match, a data file is checked the same way
+/// before its chunk index is used.
+class SidecarIndex {
+public:
+    struct FileIdentity {
+        uint64_t size;
+        int64_t modificationSeconds;
+        int64_t modificationNanoseconds;
+        uint64_t inode;
+        uint64_t device;
+
+        /// Returns false if the file cannot be accessed
+        static bool read(const std::string& filename, FileIdentity& identity);
+        bool operator==(const FileIdentity& other) const;
+    };
+
+    struct Header {
+        int32_t dimx;
+        int32_t dimy;
+        int32_t datasize;
+        int32_t nframesPerDataset;
+        uint64_t numberOfFrames;
+        float xpixelSize;
+        float ypixelSize;
+        uint32_t masterFileOnly;
+    };
+
+    struct DataFile {
+        /// empty if the dataset is stored in the master file itself
+        std::string filename;
+        /// path of the dataset within the data file
+        std::string path;
+        FileIdentity identity;
+        std::vector<Dataset::ChunkLocation> chunks;
+    };
+    /// by path of the dataset in the master file
+    typedef std::map<std::string, DataFile> DataFiles;
+
+    /// Maps the index. Throws std::runtime_error if it cannot be read or has
+    /// been written for a different version of the master file.
+    SidecarIndex(const std::string& indexFilename,
+                 const std::string& masterFilename);
+    SidecarIndex(const SidecarIndex&) = delete;
+    SidecarIndex& operator=(const SidecarIndex&) = delete;
+
+    const Header& header() const;
+    /// The preprocessed pixel mask (dimx * dimy values) within the mapping
+    std::shared_ptr<const int32_t> mask() const;
+    /// Finds the data file of the dataset at path in the master file
+    bool findDataFile(const std::string& path, DataFile& dataFile) const;
+    /// Whether the data file has not changed since the index was written
+    static bool isUnchanged(const DataFile& dataFile);
+
+    /// Replaces the index of masterFilename atomically. Throws
+    /// std::runtime_error if it cannot be written.
+    static void write(const std::string& indexFilename,
+                      const std::string& masterFilename,
+                      const Header& header,
+                      const int32_t* mask,
+                      const DataFiles& dataFiles);
+
+    /// The name of the index of masterFilename within directory, or next to
+    /// the master file if directory is empty
+    static std::string indexFilename(const std::string& masterFilename,
+                                     const std::string& directory);
+
+    constexpr static uint32_t FORMAT_VERSION = 1;
+
+private:
+    std::shared_ptr<const char> _mapping;
+    Header _header;
+    const int32_t* _mask;
+    DataFiles _dataFiles;
+};
+
+#endif  // SIDECARINDEX_H
@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: MIT
+
+#include "StagingEngine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+constexpr size_t StagingEngine::COPY_BLOCK_SIZE;
+
+namespace {
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}  // namespace
+
+StagingEngine::StagingEngine(const std::string& directory,
+                             size_t byteBudget,
+                             size_t filesAhead,
+                             const DataFileLocator& locateDataFile)
+      : _byteBudget(byteBudget),
+        _filesAhead(filesAhead),
+        _locateDataFile(locateDataFile),
+        _stagedBytes(0),
+        _cursor(0),
+        _started(false),
+        _busy(false),
+        _stop(false) {
+    // every plugin instance stages into its own directory so that several
+    // XDS jobs can share one staging area
+    std::string pattern = directory + "/neggia-staging-XXXXXX";
+    std::unique_ptr<char[]> name(new char[pattern.size() + 1]);
+    pattern.copy(name.get(), pattern.size());
+    name[pattern.size()] = 0;
+    if (!mkdtemp(name.get()))
+        throw std::runtime_error("cannot create staging directory in " +
+                                 directory);
+    _directory = name.get();
+    _thread = std::thread(&StagingEngine::run, this);
+}
+
+StagingEngine::~StagingEngine() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+    // mappings of staged files that are still open keep their data alive
+    for (const auto& file : _files)
+        unlink(file.second.localPath.c_str());
+    rmdir(_directory.c_str());
+}
+
+void StagingEngine::advance(size_t dataFileNumber) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_started && dataFileNumber <= _cursor)
+            return;
+        _cursor = dataFileNumber;
+        _started = true;
+        _busy = true;
+    }
+    _condition.notify_all();
+}
+
+StagingEngine::LocalCopy StagingEngine::localCopy(
+        const std::string& remotePath) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    StagedFile* file = findStagedFile(remotePath);
+    return file && file->complete ? lease(*file) : LocalCopy();
+}
+
+StagingEngine::LocalCopy StagingEngine::waitForLocalCopy(
+        const std::string& remotePath) const {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        StagedFile* file = findStagedFile(remotePath);
+        if (file && file->complete)
+            return lease(*file);
+        // failed copies are kept without size
+        bool isBeingCopied = file && file->size > 0;
+        if (_stop || (!isBeingCopied && !_busy))
+            return LocalCopy();
+        _condition.wait(lock);
+    }
+}
+
+bool StagingEngine::isStaged(const std::string& localPath) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& file : _files) {
+        if (file.second.localPath == localPath)
+            return true;
+    }
+    return false;
+}
+
+size_t StagingEngine::stagedBytes() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stagedBytes;
+}
+
+StagingEngine::StagedFile* StagingEngine::findStagedFile(
+        const std::string& remotePath) const {
+    for (auto& file : _files) {
+        if (file.second.remotePath == remotePath)
+            return &file.second;
+    }
+    return nullptr;
+}
+
+StagingEngine::LocalCopy StagingEngine::lease(StagedFile& file) const {
+    std::shared_ptr<const void> lease = file.lease.lock();
+    if (!lease) {
+        // wakes the thread up to reuse the space of a consumed copy, the
+        // mutex orders the wake-up after its check for released copies
+        lease = std::shared_ptr<const void>(new char, [this](const void* p) {
+            delete (const char*)p;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _busy = true;
+            }
+            _condition.notify_all();
+        });
+        file.lease = lease;
+    }
+    return LocalCopy{file.localPath, lease};
+}
+
+void StagingEngine::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop) {
+        if (_started) {
+            evictConsumedFiles();
+            releaseUnmappedFiles();
+            if (stageNextFile(lock))
+                continue;
+        }
+        _busy = false;
+        _condition.notify_all();
+        _condition.wait(lock);
+    }
+    _busy = false;
+    _condition.notify_all();
+}
+
+void StagingEngine::evictConsumedFiles() {
+    while (!_files.empty() && _files.begin()->first < _cursor) {
+        const StagedFile& file = _files.begin()->second;
+        // the data stays readable through existing mappings
+        unlink(file.localPath.c_str());
+        if (file.lease.expired())
+            _stagedBytes -= file.size;
+        else
+            _unreleasedFiles.push_back(file);
+        _files.erase(_files.begin());
+    }
+}
+
+void StagingEngine::releaseUnmappedFiles() {
+    for (auto file = _unreleasedFiles.begin();
+         file != _unreleasedFiles.end();)
+    {
+        if (file->lease.expired()) {
+            _stagedBytes -= file->size;
+            file = _unreleasedFiles.erase(file);
+        } else {
+            ++file;
+        }
+    }
+}
+
+bool StagingEngine::stageNextFile(std::unique_lock<std::mutex>& lock) {
+    for (size_t i = _cursor + 1; i <= _cursor + _filesAhead; ++i) {
+        if (_files.count(i) > 0)
+            continue;
+        std::string remotePath = _locateDataFile(i);
+        struct stat fileStatus;
+        if (remotePath.empty() || stat(remotePath.c_str(), &fileStatus) != 0)
+            return false;
+        size_t size = (size_t)fileStatus.st_size;
+        if (_stagedBytes + size > _byteBudget)
+            return false;
+        std::string localPath = _directory + "/" + std::to_string(i) + "_" +
+                                baseName(remotePath);
+        _files[i] = StagedFile{remotePath, localPath, size, false, {}};
+        _stagedBytes += size;
+
+        // only this thread removes files, the entry is still there after
+        // the copy
+        lock.unlock();
+        bool success = copyFile(remotePath, localPath);
+        lock.lock();
+
+        StagedFile& file = _files[i];
+        if (success) {
+            file.complete = true;
+        } else {
+            std::cerr << "NEGGIA WARNING: CANNOT STAGE " << remotePath
+                      << " TO " << localPath << "\n";
+            unlink(localPath.c_str());
+            // keep the failed entry without size so that it is not retried
+            _stagedBytes -= size;
+            file.size = 0;
+        }
+        _condition.notify_all();
+        return true;
+    }
+    return false;
+}
+
+bool StagingEngine::copyFile(const std::string& source,
+                             const std::string& destination) {
+    int in = open(source.c_str(), O_RDONLY);
+    if (in < 0)
+        return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    std::string partial = destination + ".part";
+    int out = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+    std::unique_ptr<char[]> buffer(new char[COPY_BLOCK_SIZE]);
+    bool success = true;
+    while (success) {
+        ssize_t nRead = read(in, buffer.get(), COPY_BLOCK_SIZE);
+        if (nRead == 0)
+            break;
+        if (nRead < 0) {
+            success = errno == EINTR;
+            continue;
+        }
+        for (ssize_t written = 0; success && written < nRead;) {
+            ssize_t n = write(out, buffer.get() + written, nRead - written);
+            if (n < 0)
+                success = errno == EINTR;
+            else
+                written += n;
+        }
+    }
+    close(in);
+    success = close(out) == 0 && success;
+    // the complete file appears atomically under its final name
+    if (success)
+        success = rename(partial.c_str(), destination.c_str()) == 0;
+    if (!success)
+        unlink(partial.c_str());
+    return success;
+}
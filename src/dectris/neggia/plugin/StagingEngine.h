@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef STAGINGENGINE_H
+#define STAGINGENGINE_H
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Copies the data files ahead of the current read position to a fast local
+/// directory (NVMe, tmpfs) on a background thread, using large sequential
+/// reads. Copies that have been consumed are removed again so that the
+/// staged files never exceed the byte budget. The space of a removed copy is
+/// only reused once nobody maps it any more, see LocalCopy.
+class StagingEngine {
+public:
+    /// Returns the filename of data file number i (counting from zero) or
+    /// an empty string if there is no such data file.
+    typedef std::function<std::string(size_t)> DataFileLocator;
+
+    /// A complete local copy. The space it takes counts against the budget
+    /// until lease and all copies of it have been destroyed, so whoever
+    /// maps the copy keeps the lease alongside the mapping. Leases must not
+    /// outlive the engine.
+    struct LocalCopy {
+        /// empty if there is no local copy
+        std::string path;
+        std::shared_ptr<const void> lease;
+    };
+
+    StagingEngine(const std::string& directory,
+                  size_t byteBudget,
+                  size_t filesAhead,
+                  const DataFileLocator& locateDataFile);
+    ~StagingEngine();
+    StagingEngine(const StagingEngine&) = delete;
+    StagingEngine& operator=(const StagingEngine&) = delete;
+
+    /// Tells the engine that data file i is being read. Files before i are
+    /// considered consumed, files i+1 to i+filesAhead get staged.
+    void advance(size_t dataFileNumber);
+    /// The complete local copy of remotePath, if the file has been staged
+    LocalCopy localCopy(const std::string& remotePath) const;
+    /// As localCopy(), but waits while remotePath is being copied or the
+    /// engine has yet to decide whether to stage it after advance()
+    LocalCopy waitForLocalCopy(const std::string& remotePath) const;
+    /// False once the local copy at localPath has been consumed
+    bool isStaged(const std::string& localPath) const;
+    /// Bytes taken by local copies, including consumed copies still mapped
+    size_t stagedBytes() const;
+
+    constexpr static size_t COPY_BLOCK_SIZE = 16 << 20;
+
+private:
+    struct StagedFile {
+        std::string remotePath;
+        std::string localPath;
+        size_t size;
+        bool complete;
+        std::weak_ptr<const void> lease;
+    };
+
+    void run();
+    bool stageNextFile(std::unique_lock<std::mutex>& lock);
+    void evictConsumedFiles();
+    void releaseUnmappedFiles();
+    StagedFile* findStagedFile(const std::string& remotePath) const;
+    LocalCopy lease(StagedFile& file) const;
+    static bool copyFile(const std::string& source,
+                         const std::string& destination);
+
+    std::string _directory;
+    const size_t _byteBudget;
+    const size_t _filesAhead;
+    const DataFileLocator _locateDataFile;
+    mutable std::mutex _mutex;
+    mutable std::condition_variable _condition;
+    /// files staged or being staged, by data file number
+    mutable std::map<size_t, StagedFile> _files;
+    /// consumed files that are still mapped through a lease
+    std::vector<StagedFile> _unreleasedFiles;
+    size_t _stagedBytes;
+    size_t _cursor;
+    bool _started;
+    /// true from advance() until the thread has staged all it can
+    mutable bool _busy;
+    bool _stop;
+    std::thread _thread;
+};
+
+#endif  // STAGINGENGINE_H
@@ -6,6 +6,7 @@ constexpr double TestDataset::X_PIXEL_SIZE;
 constexpr double TestDataset::Y_PIXEL_SIZE;
 constexpr size_t TestDataset::WIDTH;
 constexpr size_t TestDataset::HEIGHT;
+constexpr size_t TestDataset::N_FRAMES_PER_DATASET;
 
 void TestDataset::SetUp() {
     for (size_t i = 0; i < HEIGHT * WIDTH; ++i)
@@ -1,9 +1,50 @@
 // SPDX-License-Identifier: MIT
 
+#include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <dectris/neggia/data/H5Group.h>
+#include <dectris/neggia/data/H5MetadataCache.h>
+#include <dectris/neggia/data/H5Superblock.h>
 #include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/FrameRange.h>
 #include <dectris/neggia/user/H5File.h>
+#include <dectris/neggia/user/MetadataSnapshot.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <vector>
 #include "DatasetsFixture.h"
 
+namespace {
+
+H5File readIntoMemory(const std::string& path,
+                      H5File::ExternalFileResolver resolveExternalFile =
+                              H5File::ExternalFileResolver()) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+        throw std::out_of_range("cannot open " + path);
+    auto buffer = std::make_shared<std::vector<char>>(
+            std::istreambuf_iterator<char>(stream),
+            std::istreambuf_iterator<char>());
+    return H5File(buffer->data(), buffer->size(), buffer, resolveExternalFile);
+}
+
+/// Returns the offset of the data layout message of the dataset at path
+size_t findDataLayoutMsg(const H5File& h5File, const std::string& path) {
+    H5File file;
+    H5ObjectHeader objectHeader;
+    H5HeaderMessage msg;
+    if (!h5File.tryResolve(path, file, objectHeader) ||
+        !objectHeader.findMessage(H5DataLayoutMsg::TYPE_ID, msg))
+    {
+        throw std::out_of_range("no dataset at " + path);
+    }
+    return msg.object.offset();
+}
+
+}  // namespace
+
 TEST_F(TestDatasetArtificialSmall001, KeepsFileOpen) {
     Dataset xp(H5File(getPathToSourceFile()),
                "/entry/instrument/detector/x_pixel_size");
@@ -47,11 +88,130 @@ TEST_F(TestDatasetArtificialSmall001, MasterFile) {
     }
 }
 
+TEST_F(TestDatasetArtificialSmall001, CachesResolvedPaths) {
+    H5File h5File(getPathToSourceFile());
+    const H5MetadataCache* cache = h5File.metadataCache();
+    Dataset xp(h5File, "/entry/instrument/detector/x_pixel_size");
+    // /entry, /entry/instrument and /entry/instrument/detector
+    ASSERT_EQ(cache->numberOfGroups(), 3);
+    ASSERT_EQ(cache->numberOfResolvedPaths(), 1);
+    // the root group and the three above are indexed by name. This relies
+    // on the test file having superblock version 0, where groups are stored
+    // as symbol tables; with version 2 or 3 no group would be indexed.
+    ASSERT_EQ(H5Superblock(h5File.fileAddress()).version(), 0);
+    ASSERT_EQ(cache->numberOfSymbolTableIndexes(), 4);
+    Dataset yp(h5File, "/entry/instrument/detector/y_pixel_size");
+    Dataset xpAgain(h5File, "/entry/instrument/detector/x_pixel_size");
+    ASSERT_EQ(cache->numberOfGroups(), 3);
+    ASSERT_EQ(cache->numberOfResolvedPaths(), 2);
+    ASSERT_EQ(cache->numberOfSymbolTableIndexes(), 4);
+    float val;
+    xpAgain.read(&val);
+    ASSERT_EQ(val, X_PIXEL_SIZE);
+    yp.read(&val);
+    ASSERT_EQ(val, Y_PIXEL_SIZE);
+    Dataset dataset(h5File, getTargetDataset(0));
+    Dataset datasetAgain(h5File, getTargetDataset(0));
+    DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+    datasetAgain.read(dataArrayCompare, {0, 0, 0});
+    ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ListGroup) {
+    H5File h5File(getPathToSourceFile());
+    auto dataLinks = h5File.listGroup("/entry/data");
+    ASSERT_EQ(dataLinks.size(), getNumberOfDatasets());
+    for (size_t i = 0; i < dataLinks.size(); ++i) {
+        ASSERT_EQ("/entry/data/" + dataLinks[i].name, getTargetDataset(i));
+        ASSERT_EQ(dataLinks[i].linkType, H5LinkMsg::EXTERNAL);
+    }
+    auto entryLinks = h5File.listGroup("/entry");
+    auto link = std::find_if(entryLinks.begin(), entryLinks.end(),
+                             [](const H5GroupLink& link) {
+                                 return link.name == "link_to_detector_group";
+                             });
+    ASSERT_NE(link, entryLinks.end());
+    ASSERT_EQ(link->linkType, H5LinkMsg::SOFT);
+    ASSERT_EQ(link->targetPath, "/entry/instrument/detector");
+    ASSERT_THROW(h5File.listGroup("/entry/missing"), std::out_of_range);
+}
+
 TEST_F(TestDatasetArtificialSmall001, FollowLinkToGroup) {
     Dataset(H5File(getPathToSourceFile()),
             "/entry/link_to_detector_group/x_pixel_size");
 }
 
+TEST_F(TestDatasetArtificialSmall001, TryOpen) {
+    H5File h5File(getPathToSourceFile());
+    Dataset dataset;
+    ASSERT_FALSE(Dataset::tryOpen(h5File, "/entry/missing", dataset));
+    ASSERT_FALSE(Dataset::tryOpen(
+            h5File, "/entry/instrument/detector/missing", dataset));
+    ASSERT_THROW(Dataset(h5File, "/entry/missing"), std::out_of_range);
+    ASSERT_TRUE(Dataset::tryOpen(h5File, getTargetDataset(0), dataset));
+    ASSERT_EQ(dataset.dim(),
+              std::vector<size_t>({N_FRAMES_PER_DATASET, HEIGHT, WIDTH}));
+    ASSERT_EQ(h5File.metadataCache()->numberOfResolvedPaths(), 1);
+}
+
+TEST_F(TestDatasetArtificialSmall001, MetadataSnapshot) {
+    H5File h5File(getPathToSourceFile());
+    MetadataSnapshot snapshot(h5File, "/entry/instrument/detector");
+    MetadataSnapshot::Value value;
+    ASSERT_TRUE(snapshot.find("/entry/instrument/detector/x_pixel_size",
+                              value));
+    ASSERT_EQ(value.type, MetadataSnapshot::Value::FLOAT);
+    ASSERT_EQ(value.floatingPoint, X_PIXEL_SIZE);
+    ASSERT_TRUE(snapshot.find("/entry/instrument/detector/y_pixel_size",
+                              value));
+    ASSERT_EQ(value.floatingPoint, Y_PIXEL_SIZE);
+    ASSERT_TRUE(snapshot.find(
+            "/entry/instrument/detector/detectorSpecific/nimages", value));
+    ASSERT_EQ(value.type, MetadataSnapshot::Value::UNSIGNED_INTEGER);
+    ASSERT_EQ(value.unsignedInteger, getNumberOfImages());
+    // arrays are not part of the snapshot
+    ASSERT_FALSE(snapshot.find(
+            "/entry/instrument/detector/detectorSpecific/pixel_mask", value));
+    ASSERT_EQ(MetadataSnapshot(h5File, "/entry/missing").size(), 0);
+}
+
+TEST_F(TestDatasetArtificialSmall001, MetadataSnapshotSkipsUnreadableDatasets) {
+    const std::string detector = "/entry/instrument/detector";
+    std::ifstream stream(getPathToSourceFile(), std::ios::binary);
+    std::vector<char> image((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+    std::shared_ptr<const void> owner(image.data(), [](const void*) {});
+    {
+        H5File h5File(image.data(), image.size(), owner);
+        // contiguous data that has not been written has no address
+        size_t offset = findDataLayoutMsg(h5File, detector + "/x_pixel_size");
+        ASSERT_EQ(image[offset + 1], 1);
+        memset(&image[offset + 2], 0xff, 8);
+        // layout class 3 (virtual) and an unknown layout message version
+        offset = findDataLayoutMsg(h5File, detector + "/y_pixel_size");
+        image[offset + 1] = 3;
+        offset = findDataLayoutMsg(h5File,
+                                   detector + "/detectorSpecific/ntrigger");
+        image[offset] = 5;
+    }
+    H5File h5File(image.data(), image.size(), owner);
+    MetadataSnapshot snapshot(h5File, detector);
+    MetadataSnapshot::Value value;
+    ASSERT_FALSE(snapshot.find(detector + "/x_pixel_size", value));
+    ASSERT_FALSE(snapshot.find(detector + "/y_pixel_size", value));
+    ASSERT_FALSE(
+            snapshot.find(detector + "/detectorSpecific/ntrigger", value));
+    ASSERT_TRUE(snapshot.find(detector + "/detectorSpecific/nimages", value));
+    ASSERT_EQ(value.unsignedInteger, getNumberOfImages());
+
+    Dataset unwritten(h5File, detector + "/x_pixel_size");
+    ASSERT_FALSE(unwritten.hasChunk({}));
+    float pixelSize;
+    ASSERT_THROW(unwritten.read(&pixelSize), std::runtime_error);
+    ASSERT_THROW(Dataset(h5File, detector + "/y_pixel_size"),
+                 std::runtime_error);
+}
+
 TEST_F(TestDatasetArtificialSmall001, DataFile) {
     for (size_t datasetid = 0; datasetid < getNumberOfDatasets(); ++datasetid) {
         Dataset dataset(H5File(getPathToSourceFile()),
@@ -65,6 +225,265 @@ TEST_F(TestDatasetArtificialSmall001, DataFile) {
     }
 }
 
+TEST_F(TestDatasetArtificialSmall001, DropConsumedPages) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    dataset.setPageCachePolicy(Dataset::DROP_CONSUMED_PAGES);
+    ASSERT_EQ(dataset.pageCachePolicy(), Dataset::DROP_CONSUMED_PAGES);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+            DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+            dataset.read(dataArrayCompare, {i, 0, 0});
+            ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)),
+                      0);
+        }
+    }
+}
+
+TEST_F(TestDatasetArtificialSmall001, ChunkIndex) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    ASSERT_FALSE(dataset.hasChunkIndex());
+    dataset.indexChunks();
+    ASSERT_TRUE(dataset.hasChunkIndex());
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        dataset.prefetch({i, 0, 0});
+        dataset.read(dataArrayCompare, {i, 0, 0});
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadFrames) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    std::vector<DATA_TYPE> frames(N_FRAMES_PER_DATASET * HEIGHT * WIDTH);
+    for (size_t numberOfThreads = 0; numberOfThreads < 3; ++numberOfThreads) {
+        dataset.readFrames(0, N_FRAMES_PER_DATASET, frames.data(),
+                           numberOfThreads);
+        for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+            ASSERT_EQ(memcmp(frames.data() + i * HEIGHT * WIDTH, dataArray,
+                             sizeof(dataArray)),
+                      0);
+        }
+    }
+    dataset.readFrames(1, 2, frames.data());
+    ASSERT_EQ(memcmp(frames.data(), dataArray, sizeof(dataArray)), 0);
+    ASSERT_THROW(dataset.readFrames(N_FRAMES_PER_DATASET - 1, 2, frames.data()),
+                 std::out_of_range);
+
+    // the calling thread decodes the frames while the queue is busy
+    ReadQueue queue(1, 2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    queue.submit([released] { released.wait(); }, [](std::exception_ptr) {});
+    std::fill(frames.begin(), frames.end(), 0);
+    dataset.readFrames(0, N_FRAMES_PER_DATASET, frames.data(), 2, queue);
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        ASSERT_EQ(memcmp(frames.data() + i * HEIGHT * WIDTH, dataArray,
+                         sizeof(dataArray)),
+                  0);
+    }
+    release.set_value();
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadAsync) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    ReadQueue queue(2, 3);
+    ASSERT_EQ(queue.maxInFlight(), 3u);
+    std::vector<DATA_TYPE> frames(N_FRAMES_PER_DATASET * HEIGHT * WIDTH);
+    std::vector<std::future<void>> reads;
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        reads.push_back(dataset.readAsync(frames.data() + i * HEIGHT * WIDTH,
+                                          {i, 0, 0}, queue));
+    }
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        reads[i].get();
+        ASSERT_EQ(memcmp(frames.data() + i * HEIGHT * WIDTH, dataArray,
+                         sizeof(dataArray)),
+                  0);
+    }
+    std::promise<std::exception_ptr> completed;
+    dataset.readAsync(frames.data(), {N_FRAMES_PER_DATASET, 0, 0},
+                      [&](std::exception_ptr exception) {
+                          completed.set_value(exception);
+                      },
+                      queue);
+    ASSERT_TRUE(completed.get_future().get() != nullptr);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadAsyncCancel) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    ReadQueue queue(1, N_FRAMES_PER_DATASET + 2);
+    // keeps the only thread of the queue busy until the reads are cancelled
+    std::promise<void> started, release;
+    std::shared_future<void> released = release.get_future().share();
+    queue.submit(
+            [&started, released] {
+                started.set_value();
+                released.wait();
+            },
+            [](std::exception_ptr) {});
+    started.get_future().wait();
+    std::vector<DATA_TYPE> frames(N_FRAMES_PER_DATASET * HEIGHT * WIDTH);
+    std::vector<std::future<void>> reads;
+    ReadQueue::Owner owner = queue.newOwner();
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        reads.push_back(dataset.readAsync(frames.data() + i * HEIGHT * WIDTH,
+                                          {i, 0, 0}, queue, owner));
+    }
+    // the read of another owner is not cancelled
+    DATA_TYPE frame[HEIGHT * WIDTH];
+    auto otherRead =
+            dataset.readAsync(frame, {0, 0, 0}, queue, queue.newOwner());
+    ASSERT_EQ(queue.inFlight(), N_FRAMES_PER_DATASET + 2);
+    queue.cancel(owner);
+    ASSERT_EQ(queue.inFlight(), 2u);
+    for (auto& read : reads)
+        ASSERT_THROW(read.get(), ReadCancelled);
+    release.set_value();
+    otherRead.get();
+    ASSERT_EQ(memcmp(frame, dataArray, sizeof(dataArray)), 0);
+    dataset.readAsync(frames.data(), {0, 0, 0}, queue, owner).get();
+    ASSERT_EQ(memcmp(frames.data(), dataArray, sizeof(dataArray)), 0);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadAsyncFromQueueThread) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    DATA_TYPE frame[HEIGHT * WIDTH];
+    std::promise<std::future<void>> submitted;
+    ReadQueue queue(1, 1);
+    // the queue is full while the read submitting the next one runs
+    queue.submit(
+            [&] {
+                submitted.set_value(dataset.readAsync(frame, {0, 0, 0}, queue));
+            },
+            [](std::exception_ptr) {});
+    auto read = submitted.get_future();
+    ASSERT_EQ(read.wait_for(std::chrono::seconds(10)),
+              std::future_status::ready);
+    read.get().get();
+    ASSERT_EQ(memcmp(frame, dataArray, sizeof(dataArray)), 0);
+}
+
+TEST_F(TestDatasetArtificialSmall001, FrameRange) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    for (size_t lookAhead : {1, 2, 8}) {
+        FrameRange range(dataset, lookAhead);
+        ASSERT_EQ(range.size(), N_FRAMES_PER_DATASET);
+        size_t number = 0;
+        for (const auto& frame : range) {
+            ASSERT_EQ(frame.number(), number++);
+            ASSERT_EQ(frame.size(), sizeof(dataArray));
+            ASSERT_EQ(memcmp(frame.data(), dataArray, sizeof(dataArray)), 0);
+        }
+        ASSERT_EQ(number, N_FRAMES_PER_DATASET);
+    }
+    size_t number = 0;
+    for (const auto& frame : frames(H5File(getPathToSourceFile()))) {
+        ASSERT_EQ(frame.as<DATA_TYPE>()[1], dataArray[1]);
+        ++number;
+    }
+    ASSERT_EQ(number, N_FRAMES_PER_DATASET);
+    Dataset pixelSize(H5File(getPathToSourceFile()),
+                      "/entry/instrument/detector/x_pixel_size");
+    ASSERT_THROW(frames(pixelSize), std::runtime_error);
+}
+
+TEST_F(TestDatasetArtificialSmall001, HasChunk) {
+    Dataset dataset(H5File(getPathToSourceFile()), getTargetDataset(0));
+    ASSERT_EQ(dataset.maxDim().size(), dataset.dim().size());
+    ASSERT_TRUE(dataset.maxDim()[0] >= N_FRAMES_PER_DATASET);
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i)
+        ASSERT_TRUE(dataset.hasChunk({i, 0, 0}));
+    ASSERT_FALSE(dataset.hasChunk({N_FRAMES_PER_DATASET, 0, 0}));
+    ASSERT_FALSE(dataset.hasChunk({0, HEIGHT, 0}));
+    dataset.indexChunks();
+    ASSERT_TRUE(dataset.hasChunk({N_FRAMES_PER_DATASET - 1, 0, 0}));
+    ASSERT_FALSE(dataset.hasChunk({N_FRAMES_PER_DATASET, 0, 0}));
+}
+
+TEST_F(TestDatasetArtificialSmall001, ChunksLinkedAfterMapping) {
+    // a writer links chunks and B-tree nodes it has appended to the file
+    // since it was mapped, they lie beyond the end of the mapping
+    std::string sourceDir = H5File(getPathToSourceFile()).fileDir();
+    std::ifstream stream(sourceDir + "/test_data_000001.h5", std::ios::binary);
+    std::vector<char> image((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+    std::shared_ptr<const void> owner(image.data(), [](const void*) {});
+    auto openMasterFile = [&]() {
+        return readIntoMemory(getPathToSourceFile(), [&](const std::string&) {
+            return H5File(image.data(), image.size(), owner);
+        });
+    };
+    const uint64_t endOfFile = image.size();
+    const size_t lastChunk = N_FRAMES_PER_DATASET - 1;
+    size_t layout = findDataLayoutMsg(openMasterFile(), getTargetDataset(0));
+    uint64_t bTree;
+    memcpy(&bTree, &image[layout + 3], sizeof(bTree));
+    // the chunks are the children of the root node, the key of a chunk is
+    // its size, filter mask and offset followed by its address
+    ASSERT_EQ(image[bTree + 5], 0);
+    const size_t keySize = 8 + 4 * 8;
+    uint16_t entries;
+    memcpy(&entries, &image[bTree + 6], sizeof(entries));
+    for (size_t i = 0; i < entries; ++i) {
+        size_t key = bTree + 24 + i * (keySize + 8);
+        uint64_t frame;
+        memcpy(&frame, &image[key + 8], sizeof(frame));
+        if (frame == lastChunk)
+            memcpy(&image[key + keySize], &endOfFile, sizeof(endOfFile));
+    }
+    {
+        Dataset dataset(openMasterFile(), getTargetDataset(0));
+        ASSERT_TRUE(dataset.hasChunk({0, 0, 0}));
+        ASSERT_FALSE(dataset.hasChunk({lastChunk, 0, 0}));
+        DATA_TYPE frame[HEIGHT * WIDTH];
+        ASSERT_THROW(dataset.read(frame, {lastChunk, 0, 0}),
+                     std::runtime_error);
+        dataset.indexChunks();
+        ASSERT_TRUE(dataset.hasChunk({lastChunk - 1, 0, 0}));
+        ASSERT_FALSE(dataset.hasChunk({lastChunk, 0, 0}));
+    }
+    memcpy(&image[layout + 3], &endOfFile, sizeof(endOfFile));
+    Dataset dataset(openMasterFile(), getTargetDataset(0));
+    ASSERT_FALSE(dataset.hasChunk({0, 0, 0}));
+    dataset.indexChunks();
+    ASSERT_FALSE(dataset.hasChunk({0, 0, 0}));
+}
+
+TEST_F(TestDatasetArtificialSmall001, InMemoryFile) {
+    std::string sourceDir = H5File(getPathToSourceFile()).fileDir();
+    std::vector<std::string> resolvedFiles;
+    Dataset dataset(
+            readIntoMemory(getPathToSourceFile(),
+                           [&](const std::string& filename) {
+                               resolvedFiles.push_back(filename);
+                               return readIntoMemory(sourceDir + "/" +
+                                                     filename);
+                           }),
+            getTargetDataset(0));
+    ASSERT_EQ(resolvedFiles.size(), 1);
+    dataset.setPageCachePolicy(Dataset::DROP_CONSUMED_PAGES);
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        DATA_TYPE dataArrayCompare[HEIGHT * WIDTH];
+        dataset.read(dataArrayCompare, {i, 0, 0});
+        ASSERT_EQ(memcmp(dataArrayCompare, dataArray, sizeof(dataArray)), 0);
+    }
+    ASSERT_THROW(Dataset(readIntoMemory(getPathToSourceFile()),
+                         getTargetDataset(0)),
+                 std::out_of_range);
+}
+
+TEST_F(TestDatasetArtificialSmall001, ReadFromTruncatedMemoryBuffer) {
+    H5File file = readIntoMemory(getPathToSourceFile());
+    std::shared_ptr<const void> owner(file.fileAddress(), [](const void*) {});
+    ASSERT_NO_THROW(H5File(file.fileAddress(), file.fileSize(), owner));
+    ASSERT_THROW(H5File(file.fileAddress(), file.fileSize() - 1, owner),
+                 std::out_of_range);
+    ASSERT_THROW(H5File(file.fileAddress(), 8, owner), std::out_of_range);
+    ASSERT_THROW(file.openExternal(""), std::out_of_range);
+    ASSERT_THROW(H5File(getPathToSourceFile()).openExternal(""),
+                 std::out_of_range);
+}
+
 TEST_F(TestDatasetArtificialLarge001, LargeDataFile) {
     for (size_t datasetid = 0; datasetid < getNumberOfDatasets(); ++datasetid) {
         Dataset dataset(H5File(getPathToSourceFile()),
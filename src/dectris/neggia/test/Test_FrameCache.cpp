@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/plugin/FrameCache.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr size_t NUMBER_OF_PIXELS = 4;
+constexpr size_t FRAME_BYTES = NUMBER_OF_PIXELS * sizeof(int32_t);
+
+void fill(int32_t* frame, int32_t value) {
+    for (size_t i = 0; i < NUMBER_OF_PIXELS; ++i)
+        frame[i] = value;
+}
+
+}  // namespace
+
+TEST(TestFrameCache, DecodesOnce) {
+    FrameCache cache(2 * FRAME_BYTES);
+    int decodes = 0;
+    auto decode = [&](int32_t* frame) {
+        ++decodes;
+        fill(frame, 7);
+    };
+    auto frame = cache.get(1, NUMBER_OF_PIXELS, decode);
+    ASSERT_EQ(cache.get(1, NUMBER_OF_PIXELS, decode), frame);
+    ASSERT_EQ(frame.get()[NUMBER_OF_PIXELS - 1], 7);
+    ASSERT_EQ(decodes, 1);
+    // the least recently used frame makes room for the third one
+    cache.get(2, NUMBER_OF_PIXELS, decode);
+    cache.get(1, NUMBER_OF_PIXELS, decode);
+    cache.get(3, NUMBER_OF_PIXELS, decode);
+    auto statistics = cache.statistics();
+    ASSERT_EQ(statistics.hits, 2);
+    ASSERT_EQ(statistics.misses, 3);
+    ASSERT_EQ(statistics.evictions, 1);
+    ASSERT_EQ(statistics.bytes, 2 * FRAME_BYTES);
+}
+
+TEST(TestFrameCache, FailedDecodeIsNotCached) {
+    FrameCache cache(FRAME_BYTES);
+    std::atomic<bool> fail(false);
+    auto failingDecode = [&](int32_t*) {
+        while (!fail)
+            std::this_thread::yield();
+        throw std::runtime_error("cannot decode");
+    };
+    std::thread decoder([&]() {
+        EXPECT_THROW(cache.get(1, NUMBER_OF_PIXELS, failingDecode),
+                     std::runtime_error);
+    });
+    // a second reader of the frame waits for the decode and gets its error
+    while (cache.statistics().misses == 0)
+        std::this_thread::yield();
+    std::thread waiter([&]() {
+        EXPECT_THROW(cache.get(1, NUMBER_OF_PIXELS,
+                               [](int32_t* frame) { fill(frame, 1); }),
+                     std::runtime_error);
+    });
+    while (cache.statistics().waits == 0)
+        std::this_thread::yield();
+    fail = true;
+    decoder.join();
+    waiter.join();
+    ASSERT_EQ(cache.statistics().bytes, 0);
+
+    // the frame is decoded again, and frames that follow can be cached
+    auto frame = cache.get(1, NUMBER_OF_PIXELS,
+                           [](int32_t* frame) { fill(frame, 2); });
+    ASSERT_EQ(frame.get()[0], 2);
+    cache.get(2, NUMBER_OF_PIXELS, [](int32_t* frame) { fill(frame, 3); });
+    auto statistics = cache.statistics();
+    ASSERT_EQ(statistics.misses, 3);
+    ASSERT_EQ(statistics.evictions, 1);
+    ASSERT_EQ(statistics.bytes, FRAME_BYTES);
+}
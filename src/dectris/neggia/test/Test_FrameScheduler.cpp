@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/user/FrameScheduler.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+FrameScheduler::Reader readAs(int32_t value) {
+    return [value](void* frame) { *(int32_t*)frame = value; };
+}
+
+}  // namespace
+
+TEST(TestFrameScheduler, SharesReads) {
+    FrameScheduler scheduler(sizeof(int32_t), 1);
+    std::atomic<bool> release(false);
+    std::atomic<int> reads(0);
+    auto blockingRead = [&](void* frame) {
+        ++reads;
+        while (!release)
+            std::this_thread::yield();
+        *(int32_t*)frame = 3;
+    };
+    std::vector<std::thread> consumers;
+    std::vector<int32_t> frames(4, 0);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        consumers.emplace_back([&, i]() {
+            scheduler.read(0, 3, sizeof(int32_t), &frames[i], blockingRead);
+        });
+    }
+    while (scheduler.statistics().requests < frames.size())
+        std::this_thread::yield();
+    release = true;
+    for (auto& consumer : consumers)
+        consumer.join();
+    ASSERT_EQ(frames, std::vector<int32_t>(4, 3));
+    ASSERT_EQ(reads, 1);
+
+    // the frame is kept, the next one takes its place
+    int32_t frame;
+    scheduler.read(0, 3, sizeof(frame), &frame, readAs(-1));
+    ASSERT_EQ(frame, 3);
+    scheduler.read(0, 4, sizeof(frame), &frame, readAs(4));
+    scheduler.read(0, 3, sizeof(frame), &frame, readAs(5));
+    ASSERT_EQ(frame, 5);
+    auto statistics = scheduler.statistics();
+    ASSERT_EQ(statistics.requests, 7);
+    ASSERT_EQ(statistics.reads, 3);
+    ASSERT_EQ(statistics.hits, 1);
+}
+
+TEST(TestFrameScheduler, ReadsWaitingFramesInOneSweep) {
+    FrameScheduler scheduler(0, 1);
+    std::atomic<bool> release(false);
+    std::mutex mutex;
+    std::vector<std::pair<size_t, size_t>> order;
+    auto recordRead = [&](size_t file, size_t frame) {
+        return [&, file, frame](void*) {
+            while (!release)
+                std::this_thread::yield();
+            std::lock_guard<std::mutex> lock(mutex);
+            order.emplace_back(file, frame);
+        };
+    };
+    std::vector<std::pair<size_t, size_t>> requests = {
+            {0, 5}, {0, 9}, {0, 2}, {1, 0}, {0, 7}};
+    std::vector<std::thread> consumers;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto request = requests[i];
+        consumers.emplace_back([&, request]() {
+            int32_t frame;
+            scheduler.read(request.first, request.second, sizeof(frame),
+                           &frame, recordRead(request.first, request.second));
+        });
+        // frame 5 is read first, the others wait for the thread
+        while (scheduler.statistics().requests < i + 1)
+            std::this_thread::yield();
+    }
+    release = true;
+    for (auto& consumer : consumers)
+        consumer.join();
+    std::vector<std::pair<size_t, size_t>> expected = {
+            {0, 5}, {0, 7}, {0, 9}, {1, 0}, {0, 2}};
+    ASSERT_EQ(order, expected);
+}
+
+TEST(TestFrameScheduler, FailedReadIsNotKept) {
+    FrameScheduler scheduler(1024);
+    int32_t frame;
+    ASSERT_THROW(scheduler.read(0, 0, sizeof(frame), &frame,
+                                [](void*) {
+                                    throw std::runtime_error("cannot read");
+                                }),
+                 std::runtime_error);
+    scheduler.read(0, 0, sizeof(frame), &frame, readAs(1));
+    ASSERT_EQ(frame, 1);
+    ASSERT_EQ(scheduler.statistics().reads, 2);
+}
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+#include <dectris/neggia/data/H5BTreeVersion2.h>
+#include <dectris/neggia/data/JenkinsLookup3Checksum.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// A name index (B-tree type 5) of links named like the frames of a large
+/// collection. frame_071971 and frame_072191 have the same Jenkins hash.
+/// Instead of a fractal heap ID, every record holds the number of its name.
+class NameIndex {
+public:
+    NameIndex() : _data(4096, 0) {
+        for (int i = 0; i < 20; ++i)
+            _names.push_back("frame_07" + std::to_string(1960 + i));
+        _names.push_back("frame_072191");
+        // the order of the records: by hash, names with equal hashes by name
+        std::sort(_names.begin(), _names.end(),
+                  [](const std::string& a, const std::string& b) {
+                      uint32_t hashA = JenkinsLookup3Checksum(a);
+                      uint32_t hashB = JenkinsLookup3Checksum(b);
+                      return hashA != hashB ? hashA < hashB : a < b;
+                  });
+    }
+
+    /// The tree as a single leaf
+    const char* writeLeaf() {
+        writeHeader(0, LEAF_ADDRESS, _names.size());
+        writeNode(LEAF_ADDRESS, "BTLF", 0, _names.size());
+        return _data.data();
+    }
+
+    /// A root node holding only the record rootRecord, with the records
+    /// before and after it in two leaves
+    const char* writeTwoLevels(size_t rootRecord) {
+        writeHeader(1, ROOT_ADDRESS, 1);
+        size_t offset = writeNode(ROOT_ADDRESS, "BTIN", rootRecord, 1);
+        writeNode(LEAF_ADDRESS, "BTLF", 0, rootRecord);
+        writeNode(SECOND_LEAF_ADDRESS, "BTLF", rootRecord + 1,
+                  _names.size() - rootRecord - 1);
+        // child pointers: address and one byte for the number of records
+        write(offset, (uint64_t)LEAF_ADDRESS);
+        _data[offset + 8] = (char)rootRecord;
+        write(offset + 9, (uint64_t)SECOND_LEAF_ADDRESS);
+        _data[offset + 17] = (char)(_names.size() - rootRecord - 1);
+        return _data.data();
+    }
+
+    const std::vector<std::string>& names() const { return _names; }
+
+    size_t recordOf(const std::string& name) const {
+        return std::find(_names.begin(), _names.end(), name) - _names.begin();
+    }
+
+    std::string nameAt(size_t recordAddress) const {
+        return _names[(uint8_t)_data[recordAddress + 4]];
+    }
+
+    /// Looks up name like the path resolvers do
+    bool find(const H5BTreeVersion2& tree,
+              const std::string& name,
+              std::string& foundName) const {
+        size_t recordAddress;
+        try {
+            recordAddress = tree.getLinkAddressByName(
+                    name, [&](size_t address) {
+                        return name.compare(nameAt(address));
+                    });
+        } catch (const std::out_of_range&) {
+            return false;
+        }
+        foundName = nameAt(recordAddress);
+        return true;
+    }
+
+private:
+    constexpr static size_t NODE_SIZE = 512;
+    constexpr static size_t RECORD_SIZE = 11;
+    constexpr static size_t ROOT_ADDRESS = 512;
+    constexpr static size_t LEAF_ADDRESS = 1024;
+    constexpr static size_t SECOND_LEAF_ADDRESS = 1536;
+
+    template <class T>
+    void write(size_t offset, T value) {
+        memcpy(&_data[offset], &value, sizeof(value));
+    }
+
+    void writeHeader(uint16_t depth, uint64_t rootAddress, uint16_t nRecords) {
+        memcpy(&_data[0], "BTHD", 4);
+        _data[4] = 0;
+        _data[5] = 5;
+        write(6, (uint32_t)NODE_SIZE);
+        write(10, (uint16_t)RECORD_SIZE);
+        write(12, depth);
+        write(16, rootAddress);
+        write(24, nRecords);
+        write(26, (uint64_t)_names.size());
+    }
+
+    /// Returns the offset following the records
+    size_t writeNode(size_t address,
+                     const char* signature,
+                     size_t firstRecord,
+                     size_t nRecords) {
+        memcpy(&_data[address], signature, 4);
+        _data[address + 4] = 0;
+        _data[address + 5] = 5;
+        size_t offset = address + 6;
+        for (size_t i = firstRecord; i < firstRecord + nRecords; ++i) {
+            write(offset, JenkinsLookup3Checksum(_names[i]));
+            _data[offset + 4] = (char)i;
+            offset += RECORD_SIZE;
+        }
+        return offset;
+    }
+
+    std::vector<char> _data;
+    std::vector<std::string> _names;
+};
+
+}  // namespace
+
+TEST(TestH5BTreeVersion2, NamesWithEqualHashes) {
+    ASSERT_EQ(JenkinsLookup3Checksum("frame_071971"),
+              JenkinsLookup3Checksum("frame_072191"));
+    NameIndex index;
+    H5BTreeVersion2 tree(index.writeLeaf(), 0);
+    ASSERT_EQ(tree.getNumberOfRecords(), index.names().size());
+    for (const auto& name : index.names()) {
+        std::string foundName;
+        ASSERT_TRUE(index.find(tree, name, foundName)) << name;
+        ASSERT_EQ(foundName, name);
+    }
+    std::string foundName;
+    ASSERT_FALSE(index.find(tree, "frame_072192", foundName));
+}
+
+TEST(TestH5BTreeVersion2, NamesWithEqualHashesInDifferentNodes) {
+    NameIndex index;
+    // one of the two names is in the root, the other one in a leaf below
+    for (const char* rootName : {"frame_071971", "frame_072191"}) {
+        H5BTreeVersion2 tree(index.writeTwoLevels(index.recordOf(rootName)),
+                             0);
+        ASSERT_EQ(tree.getNumberOfRecords(), index.names().size());
+        for (const auto& name : index.names()) {
+            std::string foundName;
+            ASSERT_TRUE(index.find(tree, name, foundName)) << name;
+            ASSERT_EQ(foundName, name);
+        }
+        std::vector<std::string> names;
+        for (size_t address : tree.getRecordAddresses())
+            names.push_back(index.nameAt(address));
+        ASSERT_EQ(names, index.names());
+    }
+}
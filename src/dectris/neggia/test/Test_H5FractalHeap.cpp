@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+#include <dectris/neggia/data/H5FractalHeap.h>
+#include <dectris/neggia/data/H5MetadataCache.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+
+/// A fractal heap header with a direct root block and a v2 B-tree of huge
+/// objects, followed by the blocks and objects it refers to
+class HeapFixture {
+public:
+    constexpr static size_t HEAP_ADDRESS = 0;
+    constexpr static size_t ROOT_BLOCK_ADDRESS = 512;
+    constexpr static size_t HUGE_OBJECTS_BTREE_ADDRESS = 1024;
+    constexpr static size_t HUGE_OBJECTS_LEAF_ADDRESS = 1536;
+    constexpr static size_t HUGE_OBJECT_ADDRESS = 2048;
+    constexpr static size_t HEAP_ID_ADDRESS = 3072;
+
+    explicit HeapFixture(uint16_t heapIdLength) : _data(4096, 0) {
+        memcpy(&_data[HEAP_ADDRESS], "FRHP", 4);
+        write(HEAP_ADDRESS + 5, heapIdLength);
+        write(HEAP_ADDRESS + 22, (uint64_t)HUGE_OBJECTS_BTREE_ADDRESS);
+        write(HEAP_ADDRESS + 110, (uint16_t)4);
+        write(HEAP_ADDRESS + 112, (uint64_t)512);
+        write(HEAP_ADDRESS + 120, (uint64_t)65536);
+        write(HEAP_ADDRESS + 128, (uint16_t)32);
+        write(HEAP_ADDRESS + 132, (uint64_t)ROOT_BLOCK_ADDRESS);
+        memcpy(&_data[ROOT_BLOCK_ADDRESS], "FHDB", 4);
+
+        // huge objects by ID: records of address, length and ID
+        memcpy(&_data[HUGE_OBJECTS_BTREE_ADDRESS], "BTHD", 4);
+        _data[HUGE_OBJECTS_BTREE_ADDRESS + 5] = 1;
+        write(HUGE_OBJECTS_BTREE_ADDRESS + 6, (uint32_t)512);
+        write(HUGE_OBJECTS_BTREE_ADDRESS + 10, (uint16_t)24);
+        write(HUGE_OBJECTS_BTREE_ADDRESS + 16,
+              (uint64_t)HUGE_OBJECTS_LEAF_ADDRESS);
+        write(HUGE_OBJECTS_BTREE_ADDRESS + 24, (uint16_t)2);
+        write(HUGE_OBJECTS_BTREE_ADDRESS + 26, (uint64_t)2);
+        memcpy(&_data[HUGE_OBJECTS_LEAF_ADDRESS], "BTLF", 4);
+        _data[HUGE_OBJECTS_LEAF_ADDRESS + 5] = 1;
+        for (uint64_t id = 1; id <= 2; ++id) {
+            size_t record = HUGE_OBJECTS_LEAF_ADDRESS + 6 + (id - 1) * 24;
+            write(record, (uint64_t)HUGE_OBJECT_ADDRESS + 100 * id);
+            write(record + 8, (uint64_t)100);
+            write(record + 16, id);
+        }
+    }
+
+    const char* fileAddress() const { return _data.data(); }
+
+    /// Writes a heap ID of the given type, followed by bytes, and returns it
+    H5Object heapId(H5FractalHeap::HeapIdType type,
+                    const std::vector<uint8_t>& bytes) {
+        _data[HEAP_ID_ADDRESS] = (char)(type << 4);
+        memcpy(&_data[HEAP_ID_ADDRESS + 1], bytes.data(), bytes.size());
+        return H5Object(fileAddress(), HEAP_ID_ADDRESS);
+    }
+
+    template <class T>
+    void write(size_t offset, T value) {
+        memcpy(&_data[offset], &value, sizeof(value));
+    }
+
+private:
+    std::vector<char> _data;
+};
+
+constexpr size_t HeapFixture::ROOT_BLOCK_ADDRESS;
+constexpr size_t HeapFixture::HUGE_OBJECT_ADDRESS;
+constexpr size_t HeapFixture::HEAP_ID_ADDRESS;
+
+}  // namespace
+
+TEST(TestH5FractalHeap, ManagedObject) {
+    HeapFixture fixture(7);
+    H5FractalHeap heap(fixture.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    // 4 byte offset within the heap, 3 byte length
+    auto object = heap.getHeapObjectById(
+            fixture.heapId(H5FractalHeap::MANAGED, {40, 0, 0, 0, 8, 0}));
+    ASSERT_EQ(object.offset(), HeapFixture::ROOT_BLOCK_ADDRESS + 40);
+}
+
+TEST(TestH5FractalHeap, TinyObject) {
+    // the object follows the first byte of short IDs, which holds its length
+    HeapFixture shortIds(7);
+    H5FractalHeap heap(shortIds.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    auto object = heap.getHeapObjectById(
+            shortIds.heapId(H5FractalHeap::TINY, {'a', 'b', 'c'}));
+    ASSERT_EQ(object.offset(), HeapFixture::HEAP_ID_ADDRESS + 1);
+    ASSERT_EQ(std::string(object.address(), 3), "abc");
+
+    // IDs longer than 17 bytes take a second length byte
+    HeapFixture longIds(24);
+    H5FractalHeap longIdHeap(longIds.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    object = longIdHeap.getHeapObjectById(
+            longIds.heapId(H5FractalHeap::TINY, {3, 'a', 'b', 'c'}));
+    ASSERT_EQ(object.offset(), HeapFixture::HEAP_ID_ADDRESS + 2);
+    ASSERT_EQ(std::string(object.address(), 3), "abc");
+}
+
+TEST(TestH5FractalHeap, HugeObject) {
+    // short IDs are the key of the object in the B-tree of huge objects
+    HeapFixture shortIds(7);
+    H5FractalHeap heap(shortIds.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    for (uint8_t id = 1; id <= 2; ++id) {
+        auto object = heap.getHeapObjectById(
+                shortIds.heapId(H5FractalHeap::HUGE_OBJECT, {id, 0, 0, 0}));
+        ASSERT_EQ(object.offset(), HeapFixture::HUGE_OBJECT_ADDRESS + 100 * id);
+    }
+    ASSERT_THROW(heap.getHeapObjectById(shortIds.heapId(
+                         H5FractalHeap::HUGE_OBJECT, {3, 0, 0, 0})),
+                 std::out_of_range);
+
+    // long IDs hold the address and length of the object
+    HeapFixture longIds(17);
+    H5FractalHeap longIdHeap(longIds.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    auto object = longIdHeap.getHeapObjectById(longIds.heapId(
+            H5FractalHeap::HUGE_OBJECT,
+            {0x00, 0x0a, 0, 0, 0, 0, 0, 0, 100, 0, 0, 0, 0, 0, 0, 0}));
+    ASSERT_EQ(object.offset(), 0x0a00);
+}
+
+TEST(TestH5FractalHeap, KeptOpenByMetadataCache) {
+    HeapFixture fixture(7);
+    H5MetadataCache cache;
+    H5Object heap(fixture.fileAddress(), HeapFixture::HEAP_ADDRESS);
+    auto fractalHeap = cache.fractalHeap(heap);
+    ASSERT_EQ(cache.fractalHeap(heap), fractalHeap);
+    ASSERT_EQ(cache.numberOfFractalHeaps(), 1);
+}
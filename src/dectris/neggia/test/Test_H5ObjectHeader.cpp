@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: MIT
 
+#include <dectris/neggia/data/H5LinkMsg.h>
 #include <dectris/neggia/data/H5ObjectHeader.h>
 #include <dectris/neggia/data/JenkinsLookup3Checksum.h>
 #include <gtest/gtest.h>
+#include <thread>
+#include <vector>
 
 TEST(TestH5ObjectHeaderV1, CanBeParsed) {
     // see "Version 1 Object Header"
@@ -153,4 +156,33 @@ TEST(TestH5ObjectHeaderV2, CanBeParsed) {
         EXPECT_EQ(msg.headerMessage(i).type, messageTypes[i]);
         EXPECT_EQ(msg.headerMessage(i).object.offset(), messageOffsets[i]);
     }
+    ASSERT_EQ(msg.messagesOfType(0xc).size(), 1);
+    EXPECT_EQ(msg.messagesOfType(0xc)[0].object.offset(), 77);
+    EXPECT_TRUE(msg.messagesOfType(0x1).empty());
+    H5HeaderMessage linkMessage;
+    ASSERT_TRUE(msg.findMessage(H5LinkMsg::TYPE_ID, linkMessage));
+    EXPECT_TRUE(H5LinkMsg::hasLinkName(linkMessage.object, "data"));
+    EXPECT_FALSE(H5LinkMsg::hasLinkName(linkMessage.object, "dat"));
+    size_t visitedMessages = 0;
+    msg.forEachMessage([&visitedMessages](const H5HeaderMessage&) {
+        return ++visitedMessages < 3;
+    });
+    EXPECT_EQ(visitedMessages, 3);
+
+    // copies made after the index has been built share it
+    const auto copy = msg;
+    EXPECT_EQ(&copy.messagesOfType(H5LinkMsg::TYPE_ID),
+              &msg.messagesOfType(H5LinkMsg::TYPE_ID));
+    const auto unindexed = H5ObjectHeader((const char*)data, 0);
+    std::vector<std::thread> threads;
+    std::vector<uint16_t> numbersOfMessages(4);
+    for (auto& numberOfMessages : numbersOfMessages) {
+        threads.emplace_back([&unindexed, &numberOfMessages] {
+            numberOfMessages = unindexed.numberOfMessages();
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    for (auto numberOfMessages : numbersOfMessages)
+        EXPECT_EQ(numberOfMessages, 6);
 }
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: MIT
+
+#include <hdf5.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <dectris/neggia/user/Dataset.h>
+#include <dectris/neggia/user/H5File.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// Files written by libhdf5 with the latest file format, which indexes
+/// chunks with layout message version 4
+
+namespace {
+
+constexpr size_t NY = 3;
+constexpr size_t NX = 5;
+
+uint16_t pixel(size_t frame, size_t i) {
+    return (uint16_t)(frame * 7 + i);
+}
+
+std::vector<uint16_t> frameData(size_t frame) {
+    std::vector<uint16_t> data(NY * NX);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = pixel(frame, i);
+    return data;
+}
+
+class TestLatestFormat : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char name[] = "/tmp/neggia-test-XXXXXX";
+        int fd = mkstemp(name);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = name;
+    }
+    void TearDown() override {
+        if (file >= 0)
+            H5Fclose(file);
+        unlink(path.c_str());
+    }
+
+    void createFile() {
+        hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+        H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+        file = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+        H5Pclose(fapl);
+        ASSERT_GE(file, 0);
+    }
+
+    void closeFile() {
+        H5Fclose(file);
+        file = -1;
+    }
+
+    /// Creates a dataset of frames of NY x NX pixels, each a chunk of its own
+    hid_t createFrames(const char* name,
+                       hsize_t frames,
+                       hsize_t maxFrames,
+                       hid_t dcpl = H5P_DEFAULT) {
+        hsize_t dims[3] = {frames, NY, NX};
+        hsize_t maxDims[3] = {maxFrames, NY, NX};
+        hsize_t chunk[3] = {1, NY, NX};
+        hid_t space = H5Screate_simple(3, dims, maxDims);
+        hid_t plist = dcpl == H5P_DEFAULT ? H5Pcreate(H5P_DATASET_CREATE)
+                                          : H5Pcopy(dcpl);
+        H5Pset_chunk(plist, 3, chunk);
+        hid_t dataset = H5Dcreate2(file, name, H5T_STD_U16LE, space,
+                                   H5P_DEFAULT, plist, H5P_DEFAULT);
+        H5Pclose(plist);
+        H5Sclose(space);
+        return dataset;
+    }
+
+    static void writeFrame(hid_t dataset, hsize_t frame) {
+        hsize_t start[3] = {frame, 0, 0};
+        hsize_t count[3] = {1, NY, NX};
+        hid_t fileSpace = H5Dget_space(dataset);
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, nullptr, count,
+                            nullptr);
+        hid_t memorySpace = H5Screate_simple(3, count, nullptr);
+        H5Dwrite(dataset, H5T_NATIVE_USHORT, memorySpace, fileSpace,
+                 H5P_DEFAULT, frameData(frame).data());
+        H5Sclose(memorySpace);
+        H5Sclose(fileSpace);
+    }
+
+    static void appendFrame(hid_t dataset, hsize_t frame) {
+        hsize_t dims[3] = {frame + 1, NY, NX};
+        H5Dset_extent(dataset, dims);
+        writeFrame(dataset, frame);
+        H5Dflush(dataset);
+    }
+
+    static void checkFrames(const Dataset& dataset,
+                            size_t first,
+                            size_t count) {
+        std::vector<uint16_t> data(NY * NX);
+        for (size_t frame = first; frame < first + count; ++frame) {
+            ASSERT_TRUE(dataset.hasChunk({frame, 0, 0})) << frame;
+            dataset.read(data.data(), {frame, 0, 0});
+            ASSERT_EQ(data, frameData(frame)) << frame;
+        }
+    }
+
+    /// Raw data of the chunk at chunkOffset, without decoding it
+    std::vector<char> rawChunk(const std::string& name,
+                               const std::vector<size_t>& chunkOffset) const {
+        H5File h5File(path);
+        H5File resolvedFile;
+        H5ObjectHeader objectHeader;
+        H5HeaderMessage msg;
+        if (!h5File.tryResolve(name, resolvedFile, objectHeader) ||
+            !objectHeader.findMessage(H5DataLayoutMsg::TYPE_ID, msg))
+        {
+            throw std::out_of_range("no dataset at " + name);
+        }
+        H5DataLayoutMsg layout(msg.object, Dataset(h5File, name).maxDim());
+        auto raw = layout.getRawData(chunkOffset, h5File.fileSize());
+        return std::vector<char>(raw.data, raw.data + raw.size);
+    }
+
+    std::string path;
+    hid_t file = -1;
+};
+
+}  // namespace
+
+TEST_F(TestLatestFormat, SingleChunk) {
+    createFile();
+    hid_t dataset = createFrames("/data", 1, 1);
+    writeFrame(dataset, 0);
+    H5Dclose(dataset);
+    closeFile();
+    checkFrames(Dataset(H5File(path), "/data"), 0, 1);
+}
+
+TEST_F(TestLatestFormat, ImplicitIndex) {
+    createFile();
+    // chunks allocated on creation are located without an index
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_EARLY);
+    hid_t dataset = createFrames("/data", 5, 5, dcpl);
+    H5Pclose(dcpl);
+    for (hsize_t frame = 0; frame < 5; ++frame)
+        writeFrame(dataset, frame);
+    H5Dclose(dataset);
+    closeFile();
+    checkFrames(Dataset(H5File(path), "/data"), 0, 5);
+}
+
+TEST_F(TestLatestFormat, FixedArray) {
+    // more chunks than fit into a page of the array
+    const size_t frames = 1100;
+    createFile();
+    hid_t dataset = createFrames("/data", frames, frames);
+    ASSERT_GE(H5Fstart_swmr_write(file), 0);
+    for (hsize_t frame = 0; frame < 1024; ++frame)
+        writeFrame(dataset, frame);
+    H5Dflush(dataset);
+    {
+        Dataset written(H5File(path, H5File::ACCEPT_SWMR_WRITER), "/data");
+        checkFrames(written, 0, 1024);
+        // the second page has not been written
+        ASSERT_FALSE(written.hasChunk({1050, 0, 0}));
+    }
+    writeFrame(dataset, 1050);
+    H5Dclose(dataset);
+    closeFile();
+    Dataset written(H5File(path), "/data");
+    checkFrames(written, 1050, 1);
+    ASSERT_FALSE(written.hasChunk({1049, 0, 0}));
+    written.indexChunks();
+    checkFrames(written, 1000, 24);
+    checkFrames(written, 1050, 1);
+}
+
+TEST_F(TestLatestFormat, ExtensibleArrayWhileSwmrWriterAppends) {
+    // beyond the data blocks of the index block
+    const size_t frames = 300;
+    createFile();
+    hid_t dataset = createFrames("/data", 0, H5S_UNLIMITED);
+    ASSERT_GE(H5Fstart_swmr_write(file), 0);
+    for (hsize_t frame = 0; frame < 100; ++frame)
+        appendFrame(dataset, frame);
+    // only read while the writer keeps the file readable if asked for
+    ASSERT_THROW(Dataset(H5File(path), "/data"), std::out_of_range);
+    {
+        Dataset appended(H5File(path, H5File::ACCEPT_SWMR_WRITER), "/data");
+        ASSERT_EQ(appended.dim(), std::vector<size_t>({100, NY, NX}));
+        ASSERT_EQ(appended.maxDim()[0], Dataset::UNLIMITED);
+        checkFrames(appended, 0, 100);
+        ASSERT_FALSE(appended.hasChunk({100, 0, 0}));
+    }
+    for (hsize_t frame = 100; frame < frames; ++frame)
+        appendFrame(dataset, frame);
+    {
+        Dataset appended(H5File(path, H5File::ACCEPT_SWMR_WRITER), "/data");
+        checkFrames(appended, 0, frames);
+        appended.indexChunks();
+        std::vector<uint16_t> data(frames * NY * NX);
+        appended.readFrames(0, frames, data.data());
+        for (size_t frame = 0; frame < frames; ++frame) {
+            ASSERT_TRUE(std::equal(data.begin() + frame * NY * NX,
+                                   data.begin() + (frame + 1) * NY * NX,
+                                   frameData(frame).begin()))
+                    << frame;
+        }
+    }
+    H5Dclose(dataset);
+    closeFile();
+    checkFrames(Dataset(H5File(path), "/data"), 0, frames);
+}
+
+TEST_F(TestLatestFormat, PagedExtensibleArray) {
+    // data blocks are paged from element 131060 on
+    const size_t frames = 140000;
+    createFile();
+    hsize_t dims[3] = {frames, 1, 1};
+    hsize_t maxDims[3] = {H5S_UNLIMITED, 1, 1};
+    hsize_t chunk[3] = {1, 1, 1};
+    hid_t space = H5Screate_simple(3, dims, maxDims);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 3, chunk);
+    hid_t dataset = H5Dcreate2(file, "/data", H5T_STD_U32LE, space,
+                               H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    std::vector<uint32_t> data(frames);
+    for (size_t frame = 0; frame < frames; ++frame)
+        data[frame] = (uint32_t)frame;
+    H5Dwrite(dataset, H5T_NATIVE_UINT32, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+             data.data());
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    closeFile();
+    Dataset written(H5File(path), "/data");
+    for (size_t frame : {0, 3, 4, 243, 244, 131059, 131060, 132083, 132084,
+                         139999})
+    {
+        uint32_t value;
+        written.read(&value, {frame, 0, 0});
+        ASSERT_EQ(value, frame);
+    }
+}
+
+TEST_F(TestLatestFormat, FilteredChunks) {
+    createFile();
+    // the checksum makes every chunk four bytes larger
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_fletcher32(dcpl);
+    hid_t single = createFrames("/single", 1, 1, dcpl);
+    writeFrame(single, 0);
+    H5Dclose(single);
+    hid_t appended = createFrames("/appended", 0, H5S_UNLIMITED, dcpl);
+    for (hsize_t frame = 0; frame < 30; ++frame)
+        appendFrame(appended, frame);
+    H5Dclose(appended);
+    H5Pclose(dcpl);
+    closeFile();
+
+    std::vector<std::pair<std::string, size_t>> chunks = {
+            {"/single", 0}, {"/appended", 0}, {"/appended", 29}};
+    for (const auto& chunk : chunks) {
+        size_t frame = chunk.second;
+        auto raw = rawChunk(chunk.first, {frame, 0, 0});
+        ASSERT_EQ(raw.size(), NY * NX * sizeof(uint16_t) + 4);
+        ASSERT_EQ(memcmp(raw.data(), frameData(frame).data(), raw.size() - 4),
+                  0);
+    }
+}
+
+TEST_F(TestLatestFormat, UnlimitedDimensionIsNotTheFirst) {
+    createFile();
+    // the extensible array numbers chunks along the unlimited dimension
+    // first
+    hsize_t dims[2] = {2, 6};
+    hsize_t maxDims[2] = {2, H5S_UNLIMITED};
+    hsize_t chunk[2] = {1, 2};
+    hid_t space = H5Screate_simple(2, dims, maxDims);
+    hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(dcpl, 2, chunk);
+    hid_t dataset = H5Dcreate2(file, "/data", H5T_STD_U16LE, space,
+                               H5P_DEFAULT, dcpl, H5P_DEFAULT);
+    std::vector<uint16_t> data(12);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (uint16_t)i;
+    H5Dwrite(dataset, H5T_NATIVE_USHORT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+             data.data());
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Dclose(dataset);
+    closeFile();
+
+    for (size_t row = 0; row < 2; ++row) {
+        for (size_t column = 0; column < 6; column += 2) {
+            auto raw = rawChunk("/data", {row, column});
+            ASSERT_EQ(raw.size(), 2 * sizeof(uint16_t));
+            const uint16_t* values = (const uint16_t*)raw.data();
+            ASSERT_EQ(values[0], row * 6 + column);
+            ASSERT_EQ(values[1], row * 6 + column + 1);
+        }
+    }
+}
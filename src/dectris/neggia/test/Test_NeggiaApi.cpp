@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/api/neggia.h>
+#include <string.h>
+#include <vector>
+#include "DatasetsFixture.h"
+
+namespace {
+
+neggia_dataset* openDataset(const std::string& filename,
+                            const std::string& path) {
+    neggia_file* file;
+    if (neggia_file_open(filename.c_str(), &file) != NEGGIA_OK)
+        return nullptr;
+    neggia_dataset* dataset;
+    neggia_status status = neggia_dataset_open(file, path.c_str(), &dataset);
+    // the dataset keeps the file open
+    neggia_file_close(file);
+    return status == NEGGIA_OK ? dataset : nullptr;
+}
+
+}  // namespace
+
+TEST(TestNeggiaApi, Version) {
+    ASSERT_EQ(neggia_api_version(), NEGGIA_API_VERSION);
+    ASSERT_GT(strlen(neggia_version()), 0u);
+}
+
+TEST(TestNeggiaApi, ReportsErrors) {
+    neggia_file* file = (neggia_file*)1;
+    ASSERT_EQ(neggia_file_open("/does/not/exist.h5", &file),
+              NEGGIA_ERROR_NOT_FOUND);
+    ASSERT_EQ(file, nullptr);
+    ASSERT_GT(strlen(neggia_last_error()), 0u);
+    ASSERT_EQ(neggia_file_open(nullptr, &file),
+              NEGGIA_ERROR_INVALID_ARGUMENT);
+    size_t rank;
+    ASSERT_EQ(neggia_dataset_rank(nullptr, &rank),
+              NEGGIA_ERROR_INVALID_ARGUMENT);
+}
+
+TEST_F(TestDatasetArtificialSmall001, NeggiaApiReadsScalar) {
+    neggia_file* file;
+    ASSERT_EQ(neggia_file_open(getPathToSourceFile().c_str(), &file),
+              NEGGIA_OK);
+    neggia_dataset* dataset;
+    ASSERT_EQ(neggia_dataset_open(file, "/entry/does_not_exist", &dataset),
+              NEGGIA_ERROR_NOT_FOUND);
+    ASSERT_EQ(dataset, nullptr);
+    ASSERT_EQ(neggia_dataset_open(file,
+                                  "/entry/instrument/detector/x_pixel_size",
+                                  &dataset),
+              NEGGIA_OK);
+    neggia_type_class typeClass;
+    size_t elementSize, rank, size, frameSize;
+    ASSERT_EQ(neggia_dataset_type(dataset, &typeClass, &elementSize),
+              NEGGIA_OK);
+    ASSERT_EQ(typeClass, NEGGIA_TYPE_FLOAT);
+    ASSERT_EQ(elementSize, sizeof(float));
+    ASSERT_EQ(neggia_dataset_rank(dataset, &rank), NEGGIA_OK);
+    ASSERT_EQ(rank, 0u);
+    ASSERT_EQ(neggia_dataset_size(dataset, &size, &frameSize), NEGGIA_OK);
+    ASSERT_EQ(size, sizeof(float));
+    ASSERT_EQ(frameSize, sizeof(float));
+    float value;
+    ASSERT_EQ(neggia_dataset_read(dataset, &value, sizeof(value) + 1),
+              NEGGIA_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(neggia_dataset_read(dataset, &value, sizeof(value)), NEGGIA_OK);
+    ASSERT_EQ(value, X_PIXEL_SIZE);
+    ASSERT_EQ(neggia_dataset_read_frames(dataset, 0, 1, &value, sizeof(value),
+                                         0),
+              NEGGIA_ERROR_UNSUPPORTED);
+    neggia_dataset_close(dataset);
+    neggia_file_close(file);
+}
+
+TEST_F(TestDatasetArtificialSmall001, NeggiaApiReadsFrames) {
+    neggia_dataset* dataset =
+            openDataset(getPathToSourceFile(), getTargetDataset(0));
+    ASSERT_NE(dataset, nullptr);
+    neggia_dataset* pixelMask = openDataset(
+            getPathToSourceFile(),
+            "/entry/instrument/detector/detectorSpecific/pixel_mask");
+    ASSERT_NE(pixelMask, nullptr);
+
+    neggia_type_class typeClass;
+    size_t elementSize;
+    ASSERT_EQ(neggia_dataset_type(dataset, &typeClass, &elementSize),
+              NEGGIA_OK);
+    ASSERT_EQ(typeClass, NEGGIA_TYPE_UINT);
+    ASSERT_EQ(elementSize, sizeof(DATA_TYPE));
+    size_t dims[3];
+    ASSERT_EQ(neggia_dataset_dims(dataset, dims, 2),
+              NEGGIA_ERROR_INVALID_ARGUMENT);
+    ASSERT_EQ(neggia_dataset_dims(dataset, dims, 3), NEGGIA_OK);
+    ASSERT_EQ(dims[0], N_FRAMES_PER_DATASET);
+    ASSERT_EQ(dims[1], HEIGHT);
+    ASSERT_EQ(dims[2], WIDTH);
+    size_t size, frameSize;
+    ASSERT_EQ(neggia_dataset_size(dataset, &size, &frameSize), NEGGIA_OK);
+    ASSERT_EQ(frameSize, sizeof(dataArray));
+    ASSERT_EQ(size, N_FRAMES_PER_DATASET * sizeof(dataArray));
+
+    std::vector<DATA_TYPE> frames(N_FRAMES_PER_DATASET * HEIGHT * WIDTH);
+    ASSERT_EQ(neggia_dataset_read(dataset, frames.data(), size), NEGGIA_OK);
+    for (size_t i = 0; i < N_FRAMES_PER_DATASET; ++i) {
+        ASSERT_EQ(memcmp(frames.data() + i * HEIGHT * WIDTH, dataArray,
+                         sizeof(dataArray)),
+                  0);
+    }
+    memset(frames.data(), 0, size);
+    ASSERT_EQ(neggia_dataset_read_frames(dataset, 1, 2, frames.data(),
+                                         2 * frameSize, 2),
+              NEGGIA_OK);
+    ASSERT_EQ(memcmp(frames.data() + HEIGHT * WIDTH, dataArray,
+                     sizeof(dataArray)),
+              0);
+    ASSERT_EQ(neggia_dataset_read_frames(dataset, N_FRAMES_PER_DATASET - 1, 2,
+                                         frames.data(), 2 * frameSize, 0),
+              NEGGIA_ERROR_OUT_OF_RANGE);
+
+    std::vector<uint32_t> mask(HEIGHT * WIDTH);
+    ASSERT_EQ(neggia_dataset_read(pixelMask, mask.data(),
+                                  mask.size() * sizeof(uint32_t)),
+              NEGGIA_OK);
+    ASSERT_EQ(memcmp(mask.data(), pixelMaskData, sizeof(pixelMaskData)), 0);
+    neggia_dataset_close(pixelMask);
+    neggia_dataset_close(dataset);
+}
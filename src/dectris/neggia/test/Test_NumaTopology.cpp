@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dectris/neggia/plugin/NodeLocalMask.h>
+#include <dectris/neggia/plugin/NumaTopology.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// A sysfs node directory describing two nodes, the CPUs of this machine
+/// split between them
+class FakeSysfs {
+public:
+    FakeSysfs() {
+        char name[] = "/tmp/neggia-test-XXXXXX";
+        if (!mkdtemp(name))
+            throw std::runtime_error("cannot create temporary directory");
+        _path = std::string(name) + "/";
+        int numberOfCpus = std::max<int>(std::thread::hardware_concurrency(),
+                                         2);
+        write("online", "0-1");
+        write("node0/cpulist", "0-" + std::to_string(numberOfCpus / 2 - 1));
+        write("node1/cpulist", std::to_string(numberOfCpus / 2) + "-" +
+                                       std::to_string(numberOfCpus - 1));
+    }
+    ~FakeSysfs() {
+        for (const auto& file : _files)
+            unlink(file.c_str());
+        rmdir((_path + "node0").c_str());
+        rmdir((_path + "node1").c_str());
+        rmdir(_path.c_str());
+    }
+    const std::string& path() const { return _path; }
+
+private:
+    void write(const std::string& name, const std::string& content) {
+        size_t slash = name.find('/');
+        if (slash != std::string::npos)
+            mkdir((_path + name.substr(0, slash)).c_str(), 0700);
+        std::ofstream(_path + name) << content << "\n";
+        _files.push_back(_path + name);
+    }
+
+    std::string _path;
+    std::vector<std::string> _files;
+};
+
+std::shared_ptr<const int32_t> makeMask(size_t size) {
+    std::shared_ptr<int32_t> mask(new int32_t[size],
+                                  std::default_delete<int32_t[]>());
+    for (size_t i = 0; i < size; ++i)
+        mask.get()[i] = i % 3 == 0 ? 0 : -(int32_t)(i % 3);
+    return mask;
+}
+
+}  // namespace
+
+TEST(TestNumaTopology, ReadsNodesFromSysfs) {
+    FakeSysfs sysfs;
+    ASSERT_EQ(NumaTopology(true, sysfs.path()).numberOfNodes(), 2);
+    ASSERT_EQ(NumaTopology(false, sysfs.path()).numberOfNodes(), 1);
+    ASSERT_EQ(NumaTopology(true, sysfs.path() + "missing/").numberOfNodes(),
+              1);
+}
+
+TEST(TestNumaTopology, SingleNodeUsesMask) {
+    NumaTopology topology(false);
+    auto mask = makeMask(1000);
+    NodeLocalMask nodeLocalMask(topology, mask, 1000);
+    ASSERT_EQ(nodeLocalMask.get(), mask.get());
+}
+
+TEST(TestNumaTopology, NodeLocalMaskEqualsMask) {
+    FakeSysfs sysfs;
+    NumaTopology topology(true, sysfs.path());
+    auto mask = makeMask(1000);
+    NodeLocalMask nodeLocalMask(topology, mask, 1000);
+    std::vector<const int32_t*> nodeCopies(topology.numberOfNodes());
+    for (size_t node = 0; node < topology.numberOfNodes(); ++node) {
+        // threads of the same node share the copy made by the first one
+        std::vector<std::thread> threads;
+        std::vector<const int32_t*> copies(4);
+        for (auto& copy : copies) {
+            threads.emplace_back([&, node] {
+                topology.bindCurrentThread(node);
+                if (topology.currentNode() == node)
+                    copy = nodeLocalMask.get();
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        for (const int32_t* copy : copies) {
+            if (!copy)
+                continue;
+            if (!nodeCopies[node])
+                nodeCopies[node] = copy;
+            ASSERT_EQ(copy, nodeCopies[node]);
+            ASSERT_NE(copy, mask.get());
+            ASSERT_TRUE(std::equal(mask.get(), mask.get() + 1000, copy));
+        }
+    }
+    ASSERT_NE(nodeCopies[0], nodeCopies[1]);
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#include <dectris/neggia/data/H5Path.h>
+#include <dectris/neggia/data/H5Superblock.h>
+#include <dectris/neggia/user/H5File.h>
+#include <stdexcept>
+#include <vector>
+#include "DatasetsFixture.h"
+
+TEST(TestH5Path, CanonicalForm) {
+    H5Path path("//entry//data/");
+    ASSERT_TRUE(path.isAbsolute());
+    ASSERT_EQ(std::string(path), "/entry/data");
+    std::vector<std::string> items;
+    for (auto item : path)
+        items.push_back(item.toString());
+    ASSERT_EQ(items, (std::vector<std::string>{"entry", "data"}));
+    H5Path tail(path, path.begin() + 1);
+    ASSERT_FALSE(tail.isAbsolute());
+    ASSERT_EQ(std::string(tail), "data");
+    ASSERT_EQ(std::string(H5Path(path, path.end())), "");
+    ASSERT_EQ(std::string(H5Path("/") + H5Path("entry")), "/entry");
+    ASSERT_EQ(std::string(tail + H5Path("data_000001/")), "data/data_000001");
+    ASSERT_EQ(std::string(H5Path("") + tail), "data");
+}
+
+TEST_F(TestDatasetArtificialSmall001, CachedResolvesMatchUncached) {
+    H5File h5File(getPathToSourceFile());
+    H5Superblock uncachedRoot(h5File.fileAddress());
+    H5Superblock root(h5File.fileAddress(), h5File.metadataCache());
+    H5Path pixelSize("/entry/instrument/detector/x_pixel_size");
+    H5Path dataset(getTargetDataset(0));
+    // the second resolve of each path comes from the cache
+    for (int pass = 0; pass < 2; ++pass) {
+        ResolvedPath expected = uncachedRoot.resolve(pixelSize);
+        ResolvedPath resolved = root.resolve(pixelSize);
+        ASSERT_FALSE(resolved.externalFile);
+        ASSERT_EQ(resolved.objectHeader.offset(),
+                  expected.objectHeader.offset());
+
+        expected = uncachedRoot.resolve(dataset);
+        resolved = root.resolve(dataset);
+        ASSERT_TRUE(resolved.externalFile);
+        ASSERT_EQ(resolved.externalFile.filename.toString(),
+                  expected.externalFile.filename.toString());
+        ASSERT_EQ(std::string(resolved.externalFile.h5Path),
+                  std::string(expected.externalFile.h5Path));
+    }
+    ASSERT_THROW(root.resolve(H5Path("/entry/missing")), std::out_of_range);
+    ASSERT_THROW(uncachedRoot.resolve(H5Path("/entry/missing")),
+                 std::out_of_range);
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: MIT
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <dectris/neggia/plugin/SharedFrameCache.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace {
+
+constexpr size_t NUMBER_OF_PIXELS = 16;
+constexpr size_t BUDGET = 64 * NUMBER_OF_PIXELS * sizeof(int32_t);
+
+/// A file standing in for the master file, the segment is named after it
+class MasterFile {
+public:
+    MasterFile() {
+        char name[] = "/tmp/neggia-test-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd < 0)
+            throw std::runtime_error("cannot create temporary file");
+        close(fd);
+        _path = name;
+    }
+    ~MasterFile() { unlink(_path.c_str()); }
+    const std::string& path() const { return _path; }
+
+private:
+    std::string _path;
+};
+
+SharedFrameCache::Decoder decodeAs(int32_t value, int* decodes = nullptr) {
+    return [value, decodes](int32_t* frame) {
+        if (decodes)
+            ++*decodes;
+        for (size_t i = 0; i < NUMBER_OF_PIXELS; ++i)
+            frame[i] = value;
+    };
+}
+
+bool isFrame(const int32_t* frame, int32_t value) {
+    for (size_t i = 0; i < NUMBER_OF_PIXELS; ++i) {
+        if (frame[i] != value)
+            return false;
+    }
+    return true;
+}
+
+bool segmentExists(const std::string& name) {
+    return std::ifstream("/dev/shm" + name).good();
+}
+
+/// Forks a process that attaches to the segment, stores frame 0 and dies
+/// while decoding frame 1. Returns once it has been killed.
+void crashWhileDecoding(const std::string& masterFile) {
+    int ready[2];
+    ASSERT_EQ(pipe(ready), 0);
+    pid_t child = fork();
+    if (child == 0) {
+        SharedFrameCache cache(masterFile, NUMBER_OF_PIXELS, BUDGET);
+        int32_t frame[NUMBER_OF_PIXELS];
+        cache.read(0, frame, decodeAs(10));
+        cache.read(1, frame, [&](int32_t*) {
+            if (write(ready[1], "x", 1) != 1)
+                _exit(1);
+            pause();
+        });
+        _exit(0);
+    }
+    close(ready[1]);
+    char message;
+    ASSERT_EQ(read(ready[0], &message, 1), 1);
+    close(ready[0]);
+    ASSERT_EQ(kill(child, SIGKILL), 0);
+    int status;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFSIGNALED(status));
+}
+
+}  // namespace
+
+TEST(TestSharedFrameCache, ServesFramesFromSegment) {
+    MasterFile masterFile;
+    // every instance attaches like a process of its own
+    SharedFrameCache first(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+    SharedFrameCache second(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+    ASSERT_EQ(first.name(), second.name());
+    int32_t frame[NUMBER_OF_PIXELS];
+    int decodes = 0;
+    first.read(3, frame, decodeAs(3, &decodes));
+    second.read(3, frame, decodeAs(-1, &decodes));
+    ASSERT_TRUE(isFrame(frame, 3));
+    ASSERT_EQ(decodes, 1);
+    ASSERT_EQ(second.statistics().hits, 1);
+    ASSERT_EQ(second.statistics().misses, 0);
+}
+
+TEST(TestSharedFrameCache, LastProcessRemovesSegment) {
+    MasterFile masterFile;
+    std::string name;
+    {
+        SharedFrameCache first(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+        name = first.name();
+        {
+            SharedFrameCache second(masterFile.path(), NUMBER_OF_PIXELS,
+                                    BUDGET);
+        }
+        ASSERT_TRUE(segmentExists(name));
+        // a process attaching after another one has detached shares the
+        // frames of the ones still attached
+        int32_t frame[NUMBER_OF_PIXELS];
+        first.read(0, frame, decodeAs(5));
+        SharedFrameCache third(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+        third.read(0, frame, decodeAs(-1));
+        ASSERT_TRUE(isFrame(frame, 5));
+    }
+    ASSERT_FALSE(segmentExists(name));
+}
+
+TEST(TestSharedFrameCache, RecoversAfterCrashOnAttach) {
+    MasterFile masterFile;
+    ASSERT_NO_FATAL_FAILURE(crashWhileDecoding(masterFile.path()));
+    // no process is attached, the claim of the crashed one is dropped
+    SharedFrameCache cache(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+    ASSERT_TRUE(segmentExists(cache.name()));
+    int32_t frame[NUMBER_OF_PIXELS];
+    int decodes = 0;
+    cache.read(0, frame, decodeAs(-1, &decodes));
+    ASSERT_TRUE(isFrame(frame, 10));
+    ASSERT_EQ(decodes, 0);
+    auto start = std::chrono::steady_clock::now();
+    cache.read(1, frame, decodeAs(11, &decodes));
+    ASSERT_TRUE(isFrame(frame, 11));
+    ASSERT_EQ(decodes, 1);
+    ASSERT_EQ(cache.statistics().waits, 0);
+    ASSERT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(1));
+}
+
+TEST(TestSharedFrameCache, FreesSlotOfCrashedWriter) {
+    MasterFile masterFile;
+    SharedFrameCache cache(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+    ASSERT_NO_FATAL_FAILURE(crashWhileDecoding(masterFile.path()));
+    // the crashed process still holds its claim on frame 1
+    int32_t frame[NUMBER_OF_PIXELS];
+    int decodes = 0;
+    cache.read(0, frame, decodeAs(-1, &decodes));
+    ASSERT_TRUE(isFrame(frame, 10));
+    auto start = std::chrono::steady_clock::now();
+    cache.read(1, frame, decodeAs(11, &decodes));
+    ASSERT_TRUE(isFrame(frame, 11));
+    ASSERT_EQ(decodes, 1);
+    ASSERT_EQ(cache.statistics().waits, 1);
+    ASSERT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(1));
+    // the frame has been stored in the segment by this process
+    SharedFrameCache other(masterFile.path(), NUMBER_OF_PIXELS, BUDGET);
+    other.read(1, frame, decodeAs(-1, &decodes));
+    ASSERT_TRUE(isFrame(frame, 11));
+    ASSERT_EQ(decodes, 1);
+}
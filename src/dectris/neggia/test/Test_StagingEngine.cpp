@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dectris/neggia/plugin/DataFilePool.h>
+#include <dectris/neggia/plugin/StagingEngine.h>
+#include <dectris/neggia/user/H5File.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include "DatasetsFixture.h"
+
+namespace {
+
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        char name[] = "/tmp/neggia-test-XXXXXX";
+        if (!mkdtemp(name))
+            throw std::runtime_error("cannot create temporary directory");
+        _path = name;
+    }
+    ~TemporaryDirectory() {
+        // the staging engines remove their own directories
+        for (const auto& file : _files)
+            unlink(file.c_str());
+        rmdir(_path.c_str());
+    }
+    const std::string& path() const { return _path; }
+    std::string copy(const std::string& source, const std::string& name) {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(_path + "/" + name, std::ios::binary);
+        out << in.rdbuf();
+        _files.push_back(_path + "/" + name);
+        return _files.back();
+    }
+
+private:
+    std::string _path;
+    std::vector<std::string> _files;
+};
+
+size_t fileSize(const std::string& path) {
+    struct stat fileStatus;
+    if (stat(path.c_str(), &fileStatus) != 0)
+        return 0;
+    return (size_t)fileStatus.st_size;
+}
+
+bool isMapped(const std::string& path) {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.find(path) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+/// Nothing is staged under an empty name, so this returns once the engine
+/// has done all it can after advance()
+void waitUntilIdle(const StagingEngine& staging) {
+    staging.waitForLocalCopy(std::string());
+}
+
+/// Released copies are given back by the thread of the engine
+bool waitForStagedBytes(const StagingEngine& staging, size_t stagedBytes) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (staging.stagedBytes() != stagedBytes) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST_F(TestDatasetArtificialSmall001, StagingCopiesFilesAhead) {
+    TemporaryDirectory remote, local;
+    std::string dataFile = H5File(getPathToSourceFile()).fileDir() +
+                           "/test_data_000001.h5";
+    std::vector<std::string> dataFiles{"", remote.copy(dataFile, "a.h5"),
+                                       remote.copy(dataFile, "b.h5")};
+    StagingEngine staging(local.path(), size_t(1) << 30, 2, [&](size_t i) {
+        return i < dataFiles.size() ? dataFiles[i] : std::string();
+    });
+    ASSERT_TRUE(staging.localCopy(dataFiles[1]).path.empty());
+    staging.advance(0);
+    auto copy = staging.waitForLocalCopy(dataFiles[1]);
+    ASSERT_FALSE(copy.path.empty());
+    ASSERT_TRUE(staging.isStaged(copy.path));
+    ASSERT_FALSE(staging.waitForLocalCopy(dataFiles[2]).path.empty());
+    ASSERT_EQ(staging.stagedBytes(), 2 * fileSize(dataFile));
+
+    std::ifstream original(dataFile, std::ios::binary);
+    std::ifstream staged(copy.path, std::ios::binary);
+    ASSERT_TRUE(std::equal(std::istreambuf_iterator<char>(original),
+                           std::istreambuf_iterator<char>(),
+                           std::istreambuf_iterator<char>(staged)));
+}
+
+TEST_F(TestDatasetArtificialSmall001, StagingRespectsBudget) {
+    TemporaryDirectory remote, local;
+    std::string dataFile = H5File(getPathToSourceFile()).fileDir() +
+                           "/test_data_000001.h5";
+    std::vector<std::string> dataFiles{"", remote.copy(dataFile, "a.h5"),
+                                       remote.copy(dataFile, "b.h5"),
+                                       remote.copy(dataFile, "c.h5")};
+    size_t size = fileSize(dataFile);
+    StagingEngine staging(local.path(), size + size / 2, 2, [&](size_t i) {
+        return i < dataFiles.size() ? dataFiles[i] : std::string();
+    });
+    staging.advance(0);
+    auto first = staging.waitForLocalCopy(dataFiles[1]);
+    ASSERT_FALSE(first.path.empty());
+    ASSERT_TRUE(staging.waitForLocalCopy(dataFiles[2]).path.empty());
+    ASSERT_EQ(staging.stagedBytes(), size);
+
+    // the consumed copy is still leased, its space is not free yet
+    staging.advance(2);
+    ASSERT_TRUE(staging.waitForLocalCopy(dataFiles[3]).path.empty());
+    ASSERT_FALSE(staging.isStaged(first.path));
+    ASSERT_EQ(staging.stagedBytes(), size);
+
+    first = StagingEngine::LocalCopy();
+    auto third = staging.waitForLocalCopy(dataFiles[3]);
+    ASSERT_FALSE(third.path.empty());
+    ASSERT_EQ(staging.stagedBytes(), size);
+}
+
+TEST_F(TestDatasetArtificialSmall001, DataFilePoolReadsStagedCopy) {
+    TemporaryDirectory local;
+    H5File masterFile(getPathToSourceFile());
+    std::string dataFile = masterFile.fileDir() + "/test_data_000001.h5";
+    StagingEngine staging(local.path(), size_t(1) << 30, 1, [&](size_t i) {
+        return i == 1 ? dataFile : std::string();
+    });
+    DataFilePool pool(masterFile, Dataset::KEEP_PAGES, &staging);
+    std::string path = getTargetDataset(0);
+
+    // the warm-up waits for the copy instead of mapping the original
+    staging.advance(0);
+    pool.warmUp(path);
+    std::string localPath = staging.waitForLocalCopy(dataFile).path;
+    ASSERT_FALSE(localPath.empty());
+    auto dataset = pool.open(path);
+    ASSERT_TRUE(isMapped(localPath));
+    DATA_TYPE frame[HEIGHT * WIDTH];
+    dataset->read(frame, {0, 0, 0});
+    ASSERT_EQ(memcmp(frame, dataArray, sizeof(frame)), 0);
+
+    // once consumed, the copy is closed and its space given back
+    staging.advance(2);
+    waitUntilIdle(staging);
+    ASSERT_FALSE(staging.isStaged(localPath));
+    auto reopened = pool.open(path);
+    ASSERT_NE(reopened, dataset);
+    ASSERT_EQ(staging.stagedBytes(), fileSize(dataFile));
+    dataset.reset();
+    ASSERT_TRUE(waitForStagedBytes(staging, 0));
+    ASSERT_FALSE(isMapped(localPath));
+    reopened->read(frame, {0, 0, 0});
+    ASSERT_EQ(memcmp(frame, dataArray, sizeof(frame)), 0);
+}
@@ -1,9 +1,18 @@
 // SPDX-License-Identifier: MIT
 
-#include <dectris/neggia/user/H5File.h>
+#include <dirent.h>
 #include <dlfcn.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <array>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "DatasetsFixture.h"
 
 typedef void (*plugin_open_file)(const char*,
@@ -26,8 +35,109 @@ typedef void (*plugin_get_data)(int* frame_number,
                                 int info_array[1024],
                                 int* error_flag);
 
+typedef void (*plugin_get_data_batch)(int* first_frame_number,
+                                      int* number_of_frames,
+                                      int* nx,
+                                      int* ny,
+                                      int data_array[],
+                                      int info_array[1024],
+                                      int* error_flag);
+
+typedef void (*plugin_get_frame_cache_statistics)(uint64_t* hits,
+                                                  uint64_t* misses,
+                                                  int* error_flag);
+
 typedef void (*plugin_close_file)(int* error_flag);
 
+namespace {
+
+/// Sets an environment variable read by plugin_open until destroyed
+class ScopedEnvironment {
+public:
+    ScopedEnvironment(const std::string& name, const std::string& value)
+          : _name(name) {
+        setenv(name.c_str(), value.c_str(), 1);
+    }
+    ~ScopedEnvironment() { unsetenv(_name.c_str()); }
+
+private:
+    std::string _name;
+};
+
+/// A directory below /tmp, removed with its contents when destroyed
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        char name[] = "/tmp/neggia-test-XXXXXX";
+        if (!mkdtemp(name))
+            throw std::runtime_error("cannot create temporary directory");
+        _path = name;
+    }
+    ~TemporaryDirectory() {
+        if (system(("rm -r " + _path).c_str()) != 0)
+            std::cerr << "cannot remove " << _path << "\n";
+    }
+    const std::string& path() const { return _path; }
+    /// The names of the files in the directory
+    std::vector<std::string> files() const {
+        std::vector<std::string> names;
+        DIR* directory = opendir(_path.c_str());
+        while (dirent* entry = directory ? readdir(directory) : nullptr) {
+            if (entry->d_name[0] != '.')
+                names.push_back(entry->d_name);
+        }
+        if (directory)
+            closedir(directory);
+        return names;
+    }
+
+private:
+    std::string _path;
+};
+
+bool isMapped(const std::string& path) {
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.find(path) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+ino_t inodeOf(const std::string& path) {
+    struct stat fileStatus;
+    if (stat(path.c_str(), &fileStatus) != 0)
+        return 0;
+    return fileStatus.st_ino;
+}
+
+/// Starts neggia-served on socketPath, with masterFile kept open unless it
+/// is empty, and waits for the socket
+pid_t startFrameServer(const std::string& socketPath,
+                       const std::string& masterFile) {
+    pid_t server = fork();
+    if (server == 0) {
+        execl(PATH_TO_NEGGIA_SERVED, "neggia-served", socketPath.c_str(),
+              masterFile.empty() ? (char*)NULL : masterFile.c_str(),
+              (char*)NULL);
+        _exit(127);
+    }
+    for (int i = 0; i < 500 && access(socketPath.c_str(), F_OK) != 0; ++i)
+        usleep(10000);
+    return server;
+}
+
+void stopFrameServer(pid_t server) {
+    int status;
+    ASSERT_EQ(kill(server, SIGTERM), 0);
+    ASSERT_EQ(waitpid(server, &status, 0), server);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
+
+}  // namespace
+
 class TestXdsPlugin : public TestDatasetArtificialSmall001 {
 public:
     void SetUp() {
@@ -42,6 +152,20 @@ public:
         memset(info_array, 0, sizeof(info_array));
     }
     void TearDown() { dlclose(pluginHandle); }
+
+    /// Opens the file at path, or the test file if path is empty
+    void openFile(const std::string& path = std::string());
+    /// Calls plugin_get_header, storing the header in the members below
+    void readHeader();
+    /// Checks the header against the test file
+    void checkHeader();
+    /// Reads every frame and compares it to the test data with the pixel
+    /// mask applied
+    void checkFrames();
+    /// Opens the test file, checks the header, reads every frame passes
+    /// times and closes the file
+    void readTestFile(int passes = 1);
+
     void* pluginHandle;
     plugin_open_file open_file;
     plugin_get_header get_header;
@@ -49,6 +173,8 @@ public:
     plugin_close_file close_file;
     int error_flag;
     int info_array[1024];
+    int nx, ny, nbytes, number_of_frames;
+    float qx, qy;
     constexpr static int DECTRIS_VENDOR = 1;
     using PIXEL_MASK_CORRECTED_ARRAY = std::array<int, WIDTH * HEIGHT>;
     PIXEL_MASK_CORRECTED_ARRAY applyPixelMaskCorrections(
@@ -72,6 +198,49 @@ TestXdsPlugin::applyPixelMaskCorrections(
     return returnValue;
 }
 
+void TestXdsPlugin::openFile(const std::string& path) {
+    open_file((path.empty() ? getPathToSourceFile() : path).c_str(),
+              info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+}
+
+void TestXdsPlugin::readHeader() {
+    get_header(&nx, &ny, &nbytes, &qx, &qy, &number_of_frames, info_array,
+               &error_flag);
+}
+
+void TestXdsPlugin::checkHeader() {
+    ASSERT_EQ(error_flag, 0);
+    ASSERT_EQ(nx, WIDTH);
+    ASSERT_EQ(ny, HEIGHT);
+    ASSERT_EQ(qx, X_PIXEL_SIZE);
+    ASSERT_EQ(qy, Y_PIXEL_SIZE);
+    ASSERT_EQ(number_of_frames, getNumberOfImages() * getNumberOfTriggers());
+}
+
+void TestXdsPlugin::checkFrames() {
+    auto expectedArray = applyPixelMaskCorrections(this->dataArray);
+    std::vector<int> dataArrayCompare(nx * ny);
+    for (int i = 0; i < number_of_frames; ++i) {
+        int frameNumber = i + 1;
+        get_data(&frameNumber, &nx, &ny, dataArrayCompare.data(), info_array,
+                 &error_flag);
+        ASSERT_EQ(error_flag, 0) << "frame " << frameNumber;
+        for (size_t j = 0; j < WIDTH * HEIGHT; ++j)
+            ASSERT_EQ(dataArrayCompare[j], expectedArray[j]);
+    }
+}
+
+void TestXdsPlugin::readTestFile(int passes) {
+    ASSERT_NO_FATAL_FAILURE(openFile());
+    readHeader();
+    ASSERT_NO_FATAL_FAILURE(checkHeader());
+    for (int pass = 0; pass < passes; ++pass)
+        ASSERT_NO_FATAL_FAILURE(checkFrames());
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+}
+
 TEST_F(TestXdsPlugin, TestHasOpenMethod) {
     ASSERT_NE(dlsym(pluginHandle, "plugin_open"), nullptr);
 }
@@ -95,6 +264,18 @@ TEST_F(TestXdsPlugin, TestOpenAndCloseFile) {
     ASSERT_EQ(error_flag, 0);
 }
 
+TEST_F(TestXdsPlugin, TestOpenSecondFile) {
+    openFile();
+    open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, -4);
+    // the file that is open already is not affected
+    readHeader();
+    checkHeader();
+    checkFrames();
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+}
+
 TEST_F(TestXdsPlugin, TestInfoArray) {
     open_file(getPathToSourceFile().c_str(), info_array, &error_flag);
     ASSERT_EQ(info_array[0], DECTRIS_VENDOR);
@@ -150,6 +331,197 @@ TEST_F(TestXdsPlugin, TestGetData) {
     close_file(&error_flag);
 }
 
+TEST_F(TestXdsPlugin, TestGetDataBatch) {
+    auto get_data_batch = (plugin_get_data_batch)dlsym(pluginHandle,
+                                                       "plugin_get_data_batch");
+    ASSERT_NE(get_data_batch, nullptr);
+    openFile();
+    readHeader();
+    checkHeader();
+    auto expectedArray = applyPixelMaskCorrections(this->dataArray);
+    std::vector<int> frames(number_of_frames * nx * ny);
+    int firstFrameNumber = 1;
+    get_data_batch(&firstFrameNumber, &number_of_frames, &nx, &ny,
+                   frames.data(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    for (size_t j = 0; j < frames.size(); ++j)
+        ASSERT_EQ(frames[j], expectedArray[j % (WIDTH * HEIGHT)]);
+    // beyond the last frame
+    firstFrameNumber = 2;
+    get_data_batch(&firstFrameNumber, &number_of_frames, &nx, &ny,
+                   frames.data(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, -2);
+    // frames of another size than the detector's
+    firstFrameNumber = 1;
+    int wrongNx = nx + 1;
+    get_data_batch(&firstFrameNumber, &number_of_frames, &wrongNx, &ny,
+                   frames.data(), info_array, &error_flag);
+    ASSERT_EQ(error_flag, -4);
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestSidecarIndex) {
+    TemporaryDirectory directory;
+    ScopedEnvironment index("NEGGIA_INDEX", directory.path());
+    // the first pass writes the index
+    readTestFile();
+    auto files = directory.files();
+    ASSERT_EQ(files.size(), 1);
+    std::string indexFile = directory.path() + "/" + files[0];
+    ino_t inode = inodeOf(indexFile);
+
+    // the second one maps it instead of reading the header
+    openFile();
+    ASSERT_TRUE(isMapped(indexFile));
+    readHeader();
+    checkHeader();
+    checkFrames();
+    close_file(&error_flag);
+    ASSERT_EQ(error_flag, 0);
+    // an index that is up to date is not written again
+    ASSERT_EQ(inodeOf(indexFile), inode);
+}
+
+TEST_F(TestXdsPlugin, TestLiveModeWaitsForDataFile) {
+    TemporaryDirectory directory;
+    // the plugin is loaded at runtime, this test does not link the reader
+    std::string sourceFile = getPathToSourceFile();
+    std::string sourceDir = sourceFile.substr(0, sourceFile.rfind('/'));
+    ASSERT_EQ(system(("cp " + sourceFile + " " + directory.path()).c_str()),
+              0);
+    ScopedEnvironment live("NEGGIA_LIVE_TIMEOUT", "10");
+    openFile(directory.path() + "/test_master.h5");
+    // the data file is completed while the plugin waits for the header
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        std::string copy = "cp " + sourceDir + "/test_data_000001.h5 " +
+                           directory.path();
+        if (system(copy.c_str()) != 0)
+            std::cerr << "cannot copy the data file\n";
+    });
+    readHeader();
+    writer.join();
+    checkHeader();
+    checkFrames();
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestLiveModeReadsDataFileStillOpen) {
+    TemporaryDirectory directory;
+    std::string sourceFile = getPathToSourceFile();
+    std::string sourceDir = sourceFile.substr(0, sourceFile.rfind('/'));
+    ASSERT_EQ(system(("cp " + sourceFile + " " + directory.path()).c_str()),
+              0);
+    // the writer keeps the data file open while the frames are read
+    std::ifstream source(sourceDir + "/test_data_000001.h5", std::ios::binary);
+    std::ofstream dataFile(directory.path() + "/test_data_000001.h5",
+                           std::ios::binary);
+    dataFile << source.rdbuf();
+    dataFile.flush();
+    ScopedEnvironment live("NEGGIA_LIVE_TIMEOUT", "10");
+    auto start = std::chrono::steady_clock::now();
+    openFile(directory.path() + "/test_master.h5");
+    readHeader();
+    checkHeader();
+    checkFrames();
+    close_file(&error_flag);
+    ASSERT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(5));
+}
+
+TEST_F(TestXdsPlugin, TestLiveTimeoutTooLarge) {
+    // more than a week, ignored instead of overflowing the deadline
+    ScopedEnvironment live("NEGGIA_LIVE_TIMEOUT", "18446744073709551616");
+    readTestFile();
+}
+
+TEST_F(TestXdsPlugin, TestFrameCache) {
+    auto get_frame_cache_statistics = (plugin_get_frame_cache_statistics)dlsym(
+            pluginHandle, "plugin_get_frame_cache_statistics");
+    ASSERT_NE(get_frame_cache_statistics, nullptr);
+    ScopedEnvironment frameCache("NEGGIA_FRAME_CACHE", "1M");
+    openFile();
+    readHeader();
+    checkHeader();
+    // the second pass is served from the cache
+    checkFrames();
+    checkFrames();
+    uint64_t hits, misses;
+    get_frame_cache_statistics(&hits, &misses, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    ASSERT_EQ(hits, (uint64_t)number_of_frames);
+    ASSERT_EQ(misses, (uint64_t)number_of_frames);
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestFrameCacheTooLarge) {
+    auto get_frame_cache_statistics = (plugin_get_frame_cache_statistics)dlsym(
+            pluginHandle, "plugin_get_frame_cache_statistics");
+    ASSERT_NE(get_frame_cache_statistics, nullptr);
+    // more than fits into a size_t, ignored instead of wrapping around
+    ScopedEnvironment frameCache("NEGGIA_FRAME_CACHE", "16777217T");
+    openFile();
+    readHeader();
+    checkFrames();
+    checkFrames();
+    uint64_t hits, misses;
+    get_frame_cache_statistics(&hits, &misses, &error_flag);
+    ASSERT_EQ(error_flag, 0);
+    ASSERT_EQ(hits, 0u);
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestSharedFrameCache) {
+    ScopedEnvironment sharedFrameCache("NEGGIA_SHARED_FRAME_CACHE", "1M");
+    // the second pass copies the frames from the segment
+    readTestFile(2);
+}
+
+TEST_F(TestXdsPlugin, TestFrameServer) {
+    TemporaryDirectory directory;
+    std::string socketPath = directory.path() + "/socket";
+    pid_t server = startFrameServer(socketPath, getPathToSourceFile());
+    ScopedEnvironment frameServer("NEGGIA_SERVER", socketPath);
+    openFile();
+    readHeader();
+    checkHeader();
+    checkFrames();
+    ASSERT_NO_FATAL_FAILURE(stopFrameServer(server));
+    // the frames came from the server, there is no local fallback
+    int frameNumber = 1;
+    std::vector<int> dataArrayCompare(nx * ny);
+    get_data(&frameNumber, &nx, &ny, dataArrayCompare.data(), info_array,
+             &error_flag);
+    ASSERT_NE(error_flag, 0);
+    close_file(&error_flag);
+}
+
+TEST_F(TestXdsPlugin, TestFrameServerOpensFilesOnDemand) {
+    TemporaryDirectory directory;
+    std::string socketPath = directory.path() + "/socket";
+    std::string sourceFile = getPathToSourceFile();
+    std::string copy = directory.path() + "/copy";
+    ASSERT_EQ(system(("cp -r " + sourceFile.substr(0, sourceFile.rfind('/')) +
+                      " " + copy)
+                             .c_str()),
+              0);
+    pid_t server = startFrameServer(socketPath, std::string());
+    ScopedEnvironment frameServer("NEGGIA_SERVER", socketPath);
+    // both files are served by the same server
+    for (const std::string& path :
+         {sourceFile,
+          copy + sourceFile.substr(sourceFile.rfind('/')),
+          sourceFile})
+    {
+        openFile(path);
+        readHeader();
+        ASSERT_NO_FATAL_FAILURE(checkHeader());
+        ASSERT_NO_FATAL_FAILURE(checkFrames());
+        close_file(&error_flag);
+    }
+    ASSERT_NO_FATAL_FAILURE(stopFrameServer(server));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     ::testing::GTEST_FLAG(catch_exceptions) = false;
@@ -14,34 +14,76 @@
 #include <dectris/neggia/data/H5Superblock.h>
 #include <dectris/neggia/data/constants.h>
 #include <string.h>
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <sstream>
 
+constexpr size_t Dataset::UNLIMITED;
+
+namespace {
+
+/// The frames of a readFrames call, shared with the reads it submits. A
+/// read that starts after all frames have been decoded returns at once.
+struct FrameBatch {
+    std::vector<H5DataLayoutMsg::ConstDataPointer> chunks;
+    std::atomic<size_t> nextFrame{0};
+    std::mutex mutex;
+    std::condition_variable frameDecoded;
+    size_t decoded = 0;
+    std::exception_ptr error;
+};
+
+}  // namespace
+
 Dataset::Dataset()
-      : _filterId(-1), _dataSize(0), _dataTypeId(-1), _isSigned(false) {}
+      : _filterId(-1),
+        _dataSize(0),
+        _dataTypeId(-1),
+        _isSigned(false),
+        _pageCachePolicy(KEEP_PAGES) {}
 
 Dataset::Dataset(const H5File& h5File, const std::string& path)
       : _h5File(h5File),
         _filterId(-1),
         _dataSize(0),
         _dataTypeId(-1),
-        _isSigned(false) {
-    H5Superblock root(_h5File.fileAddress());
+        _isSigned(false),
+        _pageCachePolicy(KEEP_PAGES) {
+    bool found;
     try {
-        auto resolvedPath = root.resolve(path);
-        while (resolvedPath.externalFile) {
-            auto targetFile = resolvedPath.externalFile->filename;
-            if (targetFile[0] != '/')
-                targetFile = _h5File.fileDir() + "/" + targetFile;
-            _h5File = H5File(targetFile);
-            root = H5Superblock(_h5File.fileAddress());
-            resolvedPath = root.resolve(resolvedPath.externalFile->h5Path);
-        }
-        _dataSymbolObjectHeader = resolvedPath.objectHeader;
-    } catch (std::exception& exc) {
-        std::cerr << "exception during path resolve: " << exc.what() << "\n";
+        found = h5File.tryResolve(path, _h5File, _dataSymbolObjectHeader);
+    } catch (const std::exception& exc) {
         throw std::out_of_range(exc.what());
     }
+    if (!found)
+        throw std::out_of_range("could not find " + path);
+    parseDataSymbolTable();
+}
+
+bool Dataset::tryOpen(const H5File& h5File,
+                      const std::string& path,
+                      Dataset& dataset) {
+    Dataset opened;
+    if (!h5File.tryResolve(path, opened._h5File,
+                           opened._dataSymbolObjectHeader))
+    {
+        return false;
+    }
+    opened.parseDataSymbolTable();
+    dataset = opened;
+    return true;
+}
+
+Dataset::Dataset(const H5File& h5File, const H5ObjectHeader& objectHeader)
+      : _h5File(h5File),
+        _dataSymbolObjectHeader(objectHeader),
+        _filterId(-1),
+        _dataSize(0),
+        _dataTypeId(-1),
+        _isSigned(false),
+        _pageCachePolicy(KEEP_PAGES) {
     parseDataSymbolTable();
 }
 
@@ -63,6 +105,10 @@ std::vector<size_t> Dataset::dim() const {
     return _dim;
 }
 
+std::vector<size_t> Dataset::maxDim() const {
+    return _maxDim;
+}
+
 bool Dataset::isChunked() const {
     return _dataLayoutMsg.isChunked();
 }
@@ -71,6 +117,14 @@ std::vector<size_t> Dataset::chunkShape() const {
     return _dataLayoutMsg.chunkShape();
 }
 
+Dataset::PageCachePolicy Dataset::pageCachePolicy() const {
+    return _pageCachePolicy;
+}
+
+void Dataset::setPageCachePolicy(PageCachePolicy policy) {
+    _pageCachePolicy = policy;
+}
+
 void Dataset::readRawData(ConstDataPointer rawData,
                           void* outData,
                           size_t outDataSize) const {
@@ -108,8 +162,180 @@ size_t Dataset::chunkDataSize() const {
     return s;
 }
 
+Dataset::ConstDataPointer Dataset::getRawData(
+        const std::vector<size_t>& chunkOffset) const {
+    if (!_chunkIndex.empty() && !chunkOffset.empty()) {
+        size_t chunkNumber = chunkOffset[0];
+        bool isFrameOffset = true;
+        for (size_t i = 1; i < chunkOffset.size(); ++i)
+            isFrameOffset = isFrameOffset && chunkOffset[i] == 0;
+        if (isFrameOffset && chunkNumber < _chunkIndex.size() &&
+            _chunkIndex[chunkNumber].data)
+        {
+            return _chunkIndex[chunkNumber];
+        }
+    }
+    return _dataLayoutMsg.getRawData(chunkOffset, _h5File.fileSize());
+}
+
+bool Dataset::isChunkedByFrame() const {
+    if (!isChunked() || _dim.empty())
+        return false;
+    auto shape = chunkShape();
+    if (shape.size() != _dim.size() || shape[0] != 1)
+        return false;
+    for (size_t i = 1; i < shape.size(); ++i) {
+        if (shape[i] != _dim[i])
+            return false;
+    }
+    return true;
+}
+
+void Dataset::indexChunks() {
+    if (isChunkedByFrame())
+        _chunkIndex = _dataLayoutMsg.getChunkIndex(_h5File.fileSize());
+}
+
+bool Dataset::hasChunkIndex() const {
+    return !_chunkIndex.empty();
+}
+
+std::vector<Dataset::ChunkLocation> Dataset::chunkLocations() const {
+    std::vector<ChunkLocation> chunks;
+    chunks.reserve(_chunkIndex.size());
+    for (const auto& chunk : _chunkIndex) {
+        if (!chunk.data) {
+            chunks.push_back(ChunkLocation{0, 0});
+            continue;
+        }
+        chunks.push_back(ChunkLocation{
+                (uint64_t)(chunk.data - _h5File.fileAddress()), chunk.size});
+    }
+    return chunks;
+}
+
+void Dataset::setChunkLocations(const std::vector<ChunkLocation>& chunks) {
+    std::vector<ConstDataPointer> chunkIndex;
+    chunkIndex.reserve(chunks.size());
+    for (const auto& chunk : chunks) {
+        if (chunk.size == 0) {
+            chunkIndex.push_back(ConstDataPointer{nullptr, 0});
+            continue;
+        }
+        if (chunk.offset > _h5File.fileSize() ||
+            chunk.size > _h5File.fileSize() - chunk.offset)
+        {
+            throw std::out_of_range("chunk outside of file");
+        }
+        chunkIndex.push_back(ConstDataPointer{
+                _h5File.fileAddress() + chunk.offset, (size_t)chunk.size});
+    }
+    _chunkIndex.swap(chunkIndex);
+}
+
+bool Dataset::hasChunk(const std::vector<size_t>& chunkOffset) const {
+    if (chunkOffset.size() != _dim.size())
+        return false;
+    for (size_t i = 0; i < _dim.size(); ++i) {
+        if (chunkOffset[i] >= _dim[i])
+            return false;
+    }
+    ConstDataPointer rawData;
+    try {
+        rawData = getRawData(chunkOffset);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    const char* fileEnd = _h5File.fileAddress() + _h5File.fileSize();
+    return rawData.data && rawData.data <= fileEnd &&
+           rawData.size <= (size_t)(fileEnd - rawData.data);
+}
+
+void Dataset::prefetch(const std::vector<size_t>& chunkOffset) const {
+    auto rawData = getRawData(chunkOffset);
+    _h5File.prefetchPages(rawData.data, rawData.size);
+}
+
 void Dataset::read(void* data, const std::vector<size_t>& chunkOffset) const {
-    auto rawData = _dataLayoutMsg.getRawData(chunkOffset);
+    decodeRawData(getRawData(chunkOffset), data);
+}
+
+std::future<void> Dataset::readAsync(void* data,
+                                     const std::vector<size_t>& chunkOffset,
+                                     ReadQueue& queue,
+                                     ReadQueue::Owner owner) const {
+    auto promise = std::make_shared<std::promise<void>>();
+    std::future<void> future = promise->get_future();
+    readAsync(data, chunkOffset,
+              [promise](std::exception_ptr exception) {
+                  if (exception)
+                      promise->set_exception(exception);
+                  else
+                      promise->set_value();
+              },
+              queue, owner);
+    return future;
+}
+
+void Dataset::readAsync(void* data,
+                        const std::vector<size_t>& chunkOffset,
+                        ReadQueue::Callback callback,
+                        ReadQueue& queue,
+                        ReadQueue::Owner owner) const {
+    queue.submit([this, data, chunkOffset] { read(data, chunkOffset); },
+                 std::move(callback), owner);
+}
+
+void Dataset::readFrames(size_t first,
+                         size_t count,
+                         void* data,
+                         size_t numberOfThreads,
+                         ReadQueue& queue) const {
+    if (!isChunkedByFrame())
+        throw std::runtime_error("dataset is not chunked by frame");
+    if (first > _dim[0] || count > _dim[0] - first)
+        throw std::out_of_range("frames out of range");
+    auto batch = std::make_shared<FrameBatch>();
+    batch->chunks.reserve(count);
+    std::vector<size_t> chunkOffset(_dim.size(), 0);
+    for (size_t i = 0; i < count; ++i) {
+        chunkOffset[0] = first + i;
+        batch->chunks.push_back(getRawData(chunkOffset));
+        _h5File.prefetchPages(batch->chunks.back().data,
+                              batch->chunks.back().size);
+    }
+    if (numberOfThreads == 0)
+        numberOfThreads = queue.numberOfThreads() + 1;
+    numberOfThreads = std::min(numberOfThreads, count);
+    size_t frameSize = chunkDataSize();
+    auto decodeFrames = [this, batch, data, frameSize]() {
+        size_t count = batch->chunks.size();
+        for (size_t i = batch->nextFrame++; i < count; i = batch->nextFrame++) {
+            std::exception_ptr error;
+            try {
+                decodeRawData(batch->chunks[i], (char*)data + i * frameSize);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if (error && !batch->error)
+                batch->error = error;
+            ++batch->decoded;
+            batch->frameDecoded.notify_all();
+        }
+    };
+    // the calling thread decodes as well, so that the frames are decoded
+    // even if none of the reads submitted gets a thread of the queue
+    for (size_t i = 1; i < numberOfThreads; ++i)
+        queue.submit(decodeFrames, [](std::exception_ptr) {});
+    decodeFrames();
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->frameDecoded.wait(lock, [&] { return batch->decoded == count; });
+    if (batch->error)
+        std::rethrow_exception(batch->error);
+}
+
+void Dataset::decodeRawData(ConstDataPointer rawData, void* data) const {
     size_t s = chunkDataSize();
     switch (_filterId) {
         case -1:
@@ -124,42 +350,44 @@ void Dataset::read(void* data, const std::vector<size_t>& chunkOffset) const {
         default:
             throw std::runtime_error("Unknown filter");
     }
+    if (_pageCachePolicy == DROP_CONSUMED_PAGES && isChunked())
+        _h5File.dropPages(rawData.data, rawData.size);
 }
 
 void Dataset::parseDataSymbolTable() {
-    for (int i = 0; i < _dataSymbolObjectHeader.numberOfMessages(); ++i) {
-        H5HeaderMessage msg(_dataSymbolObjectHeader.headerMessage(i));
-        switch (msg.type) {
-            case H5DataspaceMsg::TYPE_ID: {
-                H5DataspaceMsg dataspaceMsg(msg.object);
-                _dim.clear();
-                for (size_t i = 0; i < dataspaceMsg.rank(); ++i) {
-                    _dim.push_back(dataspaceMsg.dim(i));
-                }
-                break;
-            }
-            case H5DataLayoutMsg::TYPE_ID: {
-                _dataLayoutMsg = H5DataLayoutMsg(msg.object);
-                break;
-            }
-            case H5FilterMsg::TYPE_ID: {
-                H5FilterMsg filterMsg(msg.object);
-                // We accept at most on filter
-                assert(filterMsg.nFilters() <= 1);
-                if (filterMsg.nFilters() == 1)
-                    _filterId = filterMsg.filterId(0);
-                _filterCdValues = filterMsg.clientData(0);
-                break;
-            }
-            case H5DatatypeMsg::TYPE_ID: {
-                H5DatatypeMsg datatypeMsg(msg.object);
-                _dataSize = datatypeMsg.dataSize();
-                _dataTypeId = datatypeMsg.typeId();
-                _isSigned = datatypeMsg.isSigned();
-                break;
-            }
+    H5HeaderMessage msg;
+    if (_dataSymbolObjectHeader.findMessage(H5DataspaceMsg::TYPE_ID, msg)) {
+        H5DataspaceMsg dataspaceMsg(msg.object);
+        _dim.clear();
+        _maxDim.clear();
+        for (size_t i = 0; i < dataspaceMsg.rank(); ++i) {
+            _dim.push_back(dataspaceMsg.dim(i));
+            _maxDim.push_back(dataspaceMsg.maxDims() ? dataspaceMsg.maxDim(i)
+                                                     : dataspaceMsg.dim(i));
         }
     }
-    assert(_dataTypeId >= 0);
+    if (_dataSymbolObjectHeader.findMessage(H5DataLayoutMsg::TYPE_ID, msg)) {
+        _dataLayoutMsg = H5DataLayoutMsg(msg.object, _maxDim);
+    }
+    if (_dataSymbolObjectHeader.findMessage(H5FilterMsg::TYPE_ID, msg)) {
+        H5FilterMsg filterMsg(msg.object);
+        // We accept at most on filter
+        assert(filterMsg.nFilters() <= 1);
+        if (filterMsg.nFilters() == 1)
+            _filterId = filterMsg.filterId(0);
+        _filterCdValues = filterMsg.clientData(0);
+    }
+    if (_dataSymbolObjectHeader.findMessage(H5DatatypeMsg::TYPE_ID, msg)) {
+        H5DatatypeMsg datatypeMsg(msg.object);
+        _dataSize = datatypeMsg.dataSize();
+        _dataTypeId = datatypeMsg.typeId();
+        _isSigned = datatypeMsg.isSigned();
+    }
+    // fixed-point, floating-point or string
+    if (_dataTypeId != 0 && _dataTypeId != 1 && _dataTypeId != 3) {
+        throw std::runtime_error("datatype class " +
+                                 std::to_string(_dataTypeId) +
+                                 " not supported");
+    }
     assert(_dataSize > 0);
 }
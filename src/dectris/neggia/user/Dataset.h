@@ -4,36 +4,121 @@
 #define DATASET_H
 
 #include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 #include "H5File.h"
+#include "ReadQueue.h"
 
 class H5LinkMsg;
 class H5LinkInfoMsg;
 
 class Dataset {
 public:
+    enum PageCachePolicy {
+        /// leave chunk pages in the page cache (multi-pass access)
+        KEEP_PAGES,
+        /// release the pages of a chunk as soon as it has been decoded
+        /// (single-pass streaming through large datasets)
+        DROP_CONSUMED_PAGES
+    };
+
+    /// Where a chunk is stored within the file of the dataset, {0, 0} for
+    /// chunks that have not been written
+    struct ChunkLocation {
+        uint64_t offset;
+        uint64_t size;
+    };
+
     Dataset();
+    /// Throws std::out_of_range if there is no dataset at path
     Dataset(const H5File& h5File, const std::string& path);
+    /// Opens the dataset with the given object header in h5File
+    Dataset(const H5File& h5File, const H5ObjectHeader& objectHeader);
     ~Dataset();
 
+    /// Opens the dataset at path into dataset. Returns false without
+    /// throwing if the path does not exist, e.g. for optional datasets.
+    static bool tryOpen(const H5File& h5File,
+                        const std::string& path,
+                        Dataset& dataset);
+
     unsigned int dataTypeId() const;
     size_t dataSize() const;
     bool isSigned() const;
     std::vector<size_t> dim() const;
+    /// The dimensions the dataset may grow to, UNLIMITED for dimensions
+    /// without limit. Equal to dim() if the dataset cannot grow.
+    std::vector<size_t> maxDim() const;
     bool isChunked() const;
     std::vector<size_t> chunkShape() const;
+    /// True if every chunk is a single frame along the first dimension
+    bool isChunkedByFrame() const;
+    PageCachePolicy pageCachePolicy() const;
+    void setPageCachePolicy(PageCachePolicy policy);
+
+    constexpr static size_t UNLIMITED = (size_t)-1;
 
     // chunkOffset is ignored for contigous or raw datasets
     void read(void* data,
               const std::vector<size_t>& chunkOffset =
                       std::vector<size_t>()) const;
 
+    // Reads like read() on a thread of queue and returns at once, or blocks
+    // while queue already has its maximum of reads in flight. The future
+    // throws what read() threw, or ReadCancelled if queue.cancel(owner) was
+    // called before the read started. The dataset and data have to stay
+    // valid until the read has completed.
+    std::future<void> readAsync(
+            void* data,
+            const std::vector<size_t>& chunkOffset,
+            ReadQueue& queue = ReadQueue::shared(),
+            ReadQueue::Owner owner = ReadQueue::NO_OWNER) const;
+    // As above, calling callback on the thread of queue that read the chunk
+    void readAsync(void* data,
+                   const std::vector<size_t>& chunkOffset,
+                   ReadQueue::Callback callback,
+                   ReadQueue& queue = ReadQueue::shared(),
+                   ReadQueue::Owner owner = ReadQueue::NO_OWNER) const;
+
+    // Reads count frames starting at frame first into data, one after the
+    // other. Only applies to datasets whose chunks are single frames along
+    // the first dimension. All chunks are located and their reads started
+    // before they are decoded in parallel on the calling thread and threads
+    // of queue, on up to numberOfThreads threads, the calling thread and
+    // all threads of queue if 0. Throws std::out_of_range if the frames are
+    // not within the dataset.
+    void readFrames(size_t first,
+                    size_t count,
+                    void* data,
+                    size_t numberOfThreads = 0,
+                    ReadQueue& queue = ReadQueue::shared()) const;
+
+    // Reads the locations of all chunks once so that read() does not need to
+    // walk the chunk b-tree for every frame. Only applies to datasets whose
+    // chunks are single frames along the first dimension.
+    void indexChunks();
+    bool hasChunkIndex() const;
+    // The chunk index as offsets into the file, e.g. to store it elsewhere
+    std::vector<ChunkLocation> chunkLocations() const;
+    // Restores a chunk index returned by chunkLocations() for the same file
+    // instead of building it. Throws std::out_of_range if a chunk does not
+    // lie within the file.
+    void setChunkLocations(const std::vector<ChunkLocation>& chunks);
+    // Returns false if the chunk at chunkOffset lies outside of the current
+    // dimensions or has not been written to the file as it was mapped, e.g.
+    // while a writer is still appending frames to the file
+    bool hasChunk(const std::vector<size_t>& chunkOffset) const;
+    // Starts reading the raw chunk at chunkOffset into the page cache
+    void prefetch(const std::vector<size_t>& chunkOffset) const;
+
 private:
     typedef H5DataLayoutMsg::ConstDataPointer ConstDataPointer;
 
     void parseDataSymbolTable();
+    ConstDataPointer getRawData(const std::vector<size_t>& chunkOffset) const;
+    void decodeRawData(ConstDataPointer rawData, void* data) const;
     void readRawData(ConstDataPointer rawData,
                      void* outData,
                      size_t outDataSize) const;
@@ -46,12 +131,15 @@ private:
     H5File _h5File;
     H5ObjectHeader _dataSymbolObjectHeader;
     H5DataLayoutMsg _dataLayoutMsg;
+    std::vector<ConstDataPointer> _chunkIndex;
     std::vector<size_t> _dim;
+    std::vector<size_t> _maxDim;
     int _filterId;
     std::vector<int32_t> _filterCdValues;
     size_t _dataSize;
     int _dataTypeId;
     bool _isSigned;
+    PageCachePolicy _pageCachePolicy;
 };
 
 #endif  // DATASET_H
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameRange.h"
+#include <ctype.h>
+#include <dectris/neggia/data/H5Group.h>
+#include <algorithm>
+#include <stdexcept>
+
+constexpr size_t FrameRange::DEFAULT_LOOK_AHEAD;
+
+namespace {
+
+bool isDataLink(const std::string& name) {
+    return name.size() == 11 && name.compare(0, 5, "data_") == 0 &&
+           std::all_of(name.begin() + 5, name.end(), ::isdigit);
+}
+
+size_t getFrameSize(const Dataset& dataset) {
+    auto dim = dataset.dim();
+    size_t size = dataset.dataSize();
+    for (size_t i = 1; i < dim.size(); ++i)
+        size *= dim[i];
+    return size;
+}
+
+}  // namespace
+
+std::vector<Dataset> openDataFiles(const H5File& masterFile) {
+    std::vector<std::string> names;
+    for (const auto& link : masterFile.listGroup("/entry/data")) {
+        if (isDataLink(link.name))
+            names.push_back(link.name);
+    }
+    // data_000001, data_000002, ...
+    std::sort(names.begin(), names.end());
+    std::vector<Dataset> datasets;
+    for (const auto& name : names)
+        datasets.emplace_back(masterFile, "/entry/data/" + name);
+    if (datasets.empty())
+        datasets.emplace_back(masterFile, "/entry/data/data");
+    return datasets;
+}
+
+FrameRange::FrameRange(const Dataset& dataset,
+                       size_t lookAhead,
+                       ReadQueue& queue)
+      : _queue(&queue) {
+    setDatasets(std::vector<Dataset>(1, dataset), lookAhead);
+}
+
+FrameRange::FrameRange(const H5File& masterFile,
+                       size_t lookAhead,
+                       ReadQueue& queue)
+      : _queue(&queue) {
+    setDatasets(openDataFiles(masterFile), lookAhead);
+}
+
+FrameRange::~FrameRange() {
+    waitForReads();
+}
+
+FrameRange::iterator FrameRange::begin() {
+    // a second pass starts over
+    waitForReads();
+    for (size_t number = 0; number < _slots.size(); ++number)
+        submit(number);
+    return iterator(this, 0);
+}
+
+FrameRange::iterator FrameRange::end() {
+    return iterator(this, size());
+}
+
+size_t FrameRange::size() const {
+    return _firstFrames.back();
+}
+
+void FrameRange::setDatasets(std::vector<Dataset> datasets,
+                             size_t lookAhead) {
+    _firstFrames.assign(1, 0);
+    size_t bufferSize = 0;
+    for (auto& dataset : datasets) {
+        if (!dataset.isChunkedByFrame())
+            throw std::runtime_error("dataset is not chunked by frame");
+        dataset.indexChunks();
+        _firstFrames.push_back(_firstFrames.back() + dataset.dim()[0]);
+        bufferSize = std::max(bufferSize, getFrameSize(dataset));
+    }
+    _datasets.swap(datasets);
+    _slots.resize(std::max<size_t>(std::min(lookAhead, size()), 1));
+    for (auto& slot : _slots)
+        slot.buffer.resize(bufferSize);
+}
+
+void FrameRange::submit(size_t number) {
+    if (number >= size())
+        return;
+    size_t index = std::upper_bound(_firstFrames.begin(), _firstFrames.end(),
+                                    number) -
+                   _firstFrames.begin() - 1;
+    const Dataset& dataset = _datasets[index];
+    std::vector<size_t> chunkOffset(dataset.dim().size(), 0);
+    chunkOffset[0] = number - _firstFrames[index];
+    Slot& slot = _slots[number % _slots.size()];
+    slot.frame._number = number;
+    slot.frame._data = slot.buffer.data();
+    slot.frame._size = getFrameSize(dataset);
+    slot.read = dataset.readAsync(slot.buffer.data(), chunkOffset, *_queue)
+                        .share();
+}
+
+const FrameRange::Frame& FrameRange::wait(size_t number) {
+    Slot& slot = _slots[number % _slots.size()];
+    if (slot.read.valid())
+        slot.read.get();
+    return slot.frame;
+}
+
+void FrameRange::advance(size_t number) {
+    Slot& slot = _slots[number % _slots.size()];
+    // the frame may not have been looked at, its buffer is free once it has
+    // been read
+    if (slot.read.valid())
+        slot.read.wait();
+    slot.read = std::shared_future<void>();
+    submit(number + _slots.size());
+}
+
+void FrameRange::waitForReads() {
+    for (auto& slot : _slots) {
+        if (slot.read.valid())
+            slot.read.wait();
+        slot.read = std::shared_future<void>();
+    }
+}
+
+FrameRange frames(const Dataset& dataset, size_t lookAhead) {
+    return FrameRange(dataset, lookAhead);
+}
+
+FrameRange frames(const H5File& masterFile, size_t lookAhead) {
+    return FrameRange(masterFile, lookAhead);
+}
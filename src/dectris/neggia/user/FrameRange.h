@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMERANGE_H
+#define FRAMERANGE_H
+#include <stddef.h>
+#include <future>
+#include <iterator>
+#include <vector>
+#include "Dataset.h"
+#include "H5File.h"
+#include "ReadQueue.h"
+
+/// The frames of one or more datasets chunked by frame, read ahead of the
+/// frame being looked at so that reading and decoding overlap with whatever
+/// the caller does with the frames:
+///
+///     for (const auto& frame : frames(dataset))
+///         sum(frame.as<uint16_t>(), frame.size() / sizeof(uint16_t));
+///
+/// Up to lookAhead frames are read at a time, into buffers that are reused
+/// for the frames that follow. A frame stays valid until the iterator moves
+/// past it. Frames are read in order, from the first frame to the last, in
+/// one pass.
+class FrameRange {
+public:
+    class Frame {
+    public:
+        /// Number of the frame within the range, counting from 0
+        size_t number() const { return _number; }
+        const char* data() const { return _data; }
+        /// Size of the frame in bytes
+        size_t size() const { return _size; }
+        template <class T>
+        const T* as() const {
+            return (const T*)_data;
+        }
+
+    private:
+        friend class FrameRange;
+        size_t _number;
+        const char* _data;
+        size_t _size;
+    };
+
+    class iterator : public std::iterator<std::input_iterator_tag,
+                                          Frame,
+                                          std::ptrdiff_t,
+                                          const Frame*,
+                                          const Frame&> {
+    public:
+        iterator(FrameRange* range, size_t number)
+              : _range(range), _number(number) {}
+        /// Waits for the frame and throws what reading it threw
+        const Frame& operator*() const { return _range->wait(_number); }
+        const Frame* operator->() const { return &**this; }
+        iterator& operator++() {
+            _range->advance(_number++);
+            return *this;
+        }
+        bool operator==(const iterator& other) const {
+            return _number == other._number;
+        }
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        FrameRange* _range;
+        size_t _number;
+    };
+
+    /// Throws std::runtime_error if dataset is not chunked by frame
+    FrameRange(const Dataset& dataset,
+               size_t lookAhead = DEFAULT_LOOK_AHEAD,
+               ReadQueue& queue = ReadQueue::shared());
+    /// The frames of all data files of an Eiger master file, i.e. of the
+    /// datasets /entry/data/data_000001 onwards, or of /entry/data/data.
+    /// Throws std::out_of_range if a data file cannot be opened.
+    FrameRange(const H5File& masterFile,
+               size_t lookAhead = DEFAULT_LOOK_AHEAD,
+               ReadQueue& queue = ReadQueue::shared());
+    /// Waits for the reads that are still in flight
+    ~FrameRange();
+    FrameRange(FrameRange&&) = default;
+    FrameRange(const FrameRange&) = delete;
+    FrameRange& operator=(const FrameRange&) = delete;
+
+    /// Starts reading the first frames
+    iterator begin();
+    iterator end();
+    /// Number of frames
+    size_t size() const;
+
+    constexpr static size_t DEFAULT_LOOK_AHEAD = 8;
+
+private:
+    struct Slot {
+        std::vector<char> buffer;
+        std::shared_future<void> read;
+        Frame frame;
+    };
+
+    void setDatasets(std::vector<Dataset> datasets, size_t lookAhead);
+    void submit(size_t number);
+    const Frame& wait(size_t number);
+    void advance(size_t number);
+    void waitForReads();
+
+    std::vector<Dataset> _datasets;
+    /// number of the first frame of every dataset, followed by size()
+    std::vector<size_t> _firstFrames;
+    std::vector<Slot> _slots;
+    ReadQueue* _queue;
+};
+
+/// The datasets of all data files of an Eiger master file, in the order of
+/// their frames: /entry/data/data_000001 onwards, or /entry/data/data.
+/// Throws std::out_of_range if a data file cannot be opened.
+std::vector<Dataset> openDataFiles(const H5File& masterFile);
+
+/// for (const auto& frame : frames(dataset)) ...
+FrameRange frames(const Dataset& dataset,
+                  size_t lookAhead = FrameRange::DEFAULT_LOOK_AHEAD);
+/// for (const auto& frame : frames(masterFile)) ...
+FrameRange frames(const H5File& masterFile,
+                  size_t lookAhead = FrameRange::DEFAULT_LOOK_AHEAD);
+
+#endif  // FRAMERANGE_H
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: MIT
+
+#include "FrameScheduler.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+size_t getNumberOfThreads(size_t numberOfThreads) {
+    if (numberOfThreads > 0)
+        return numberOfThreads;
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+}  // namespace
+
+FrameScheduler::FrameScheduler(size_t cacheBudget, size_t numberOfThreads)
+      : _cacheBudget(cacheBudget),
+        _position(Key{0, 0}),
+        _cachedBytes(0),
+        _statistics(Statistics()),
+        _stop(false) {
+    numberOfThreads = getNumberOfThreads(numberOfThreads);
+    for (size_t i = 0; i < numberOfThreads; ++i)
+        _threads.emplace_back(&FrameScheduler::run, this);
+}
+
+FrameScheduler::~FrameScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _frameWaiting.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+void FrameScheduler::read(size_t file,
+                          size_t frame,
+                          size_t size,
+                          void* data,
+                          const Reader& reader) {
+    Key key{file, frame};
+    std::shared_ptr<Frame> entry;
+    std::unique_lock<std::mutex> lock(_mutex);
+    ++_statistics.requests;
+    auto found = _frames.find(key);
+    if (found == _frames.end()) {
+        entry = std::make_shared<Frame>();
+        entry->reader = reader;
+        entry->data.resize(size);
+        _frames[key] = entry;
+        _pending.insert(key);
+        _frameWaiting.notify_one();
+    } else {
+        entry = found->second;
+        if (entry->cached) {
+            ++_statistics.hits;
+            _lru.splice(_lru.begin(), _lru, entry->lruPosition);
+        }
+    }
+    _frameRead.wait(lock, [&] { return entry->done; });
+    lock.unlock();
+    // the data of a frame that has been read does not change, and entry
+    // keeps it even if the frame is no longer kept
+    if (entry->error)
+        std::rethrow_exception(entry->error);
+    memcpy(data, entry->data.data(), std::min(size, entry->data.size()));
+}
+
+FrameScheduler::Statistics FrameScheduler::statistics() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _statistics;
+}
+
+void FrameScheduler::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _frameWaiting.wait(lock, [this] { return _stop || !_pending.empty(); });
+        if (_stop)
+            return;
+        auto next = _pending.lower_bound(_position);
+        if (next == _pending.end())
+            next = _pending.begin();
+        Key key = *next;
+        _pending.erase(next);
+        _position = key;
+        std::shared_ptr<Frame> frame = _frames[key];
+        lock.unlock();
+        try {
+            frame->reader(frame->data.data());
+        } catch (...) {
+            frame->error = std::current_exception();
+        }
+        lock.lock();
+        ++_statistics.reads;
+        frame->done = true;
+        frame->reader = Reader();
+        if (frame->error)
+            _frames.erase(key);
+        else
+            cacheLocked(key, frame);
+        _frameRead.notify_all();
+    }
+}
+
+void FrameScheduler::cacheLocked(const Key& key,
+                                 const std::shared_ptr<Frame>& frame) {
+    _lru.push_front(key);
+    frame->lruPosition = _lru.begin();
+    frame->cached = true;
+    _cachedBytes += frame->data.size();
+    while (_cachedBytes > _cacheBudget && !_lru.empty()) {
+        auto evicted = _frames.find(_lru.back());
+        _cachedBytes -= evicted->second->data.size();
+        evicted->second->cached = false;
+        _frames.erase(evicted);
+        _lru.pop_back();
+    }
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+#include <stddef.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+/// Reads single frames for any number of consumers at a time, e.g. the
+/// clients of neggia-served, on a pool of threads of its own:
+///
+/// - consumers asking for the same frame at the same time share one read
+/// - frames that are waiting for a thread are read in ascending order of
+///   file and frame, continuing from the frame read last and wrapping
+///   around at the end, so that consumers at different positions in the
+///   same files are served in one sweep instead of seeking back and forth
+/// - the frames read last are kept up to cacheBudget bytes
+class FrameScheduler {
+public:
+    /// Reads the frame into the buffer passed, which holds size bytes
+    typedef std::function<void(void*)> Reader;
+
+    struct Statistics {
+        /// number of frames asked for
+        size_t requests;
+        /// number of frames read, the other requests shared a read or were
+        /// served from memory
+        size_t reads;
+        /// number of requests served from memory
+        size_t hits;
+    };
+
+    /// One thread per hardware thread if numberOfThreads is 0
+    explicit FrameScheduler(size_t cacheBudget, size_t numberOfThreads = 0);
+    ~FrameScheduler();
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    /// Copies frame of file, size bytes, into data. Unless the frame is
+    /// kept or being read already, reader is called on a thread of the
+    /// scheduler once it is the frame's turn. Blocks until the frame has
+    /// been read and throws what reader threw. file identifies the file
+    /// across calls and must not be reused for another one.
+    void read(size_t file,
+              size_t frame,
+              size_t size,
+              void* data,
+              const Reader& reader);
+    Statistics statistics() const;
+
+private:
+    struct Key {
+        size_t file;
+        size_t frame;
+
+        bool operator<(const Key& other) const {
+            return file != other.file ? file < other.file
+                                      : frame < other.frame;
+        }
+    };
+
+    struct Frame {
+        /// set until the frame has been read
+        Reader reader;
+        std::vector<char> data;
+        std::exception_ptr error;
+        bool done = false;
+        bool cached = false;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    /// Runs on every thread of the scheduler, reads waiting frames
+    void run();
+    void cacheLocked(const Key& key, const std::shared_ptr<Frame>& frame);
+
+    const size_t _cacheBudget;
+    mutable std::mutex _mutex;
+    std::condition_variable _frameWaiting;
+    std::condition_variable _frameRead;
+    std::map<Key, std::shared_ptr<Frame>> _frames;
+    /// frames waiting for a thread
+    std::set<Key> _pending;
+    /// the frame started last
+    Key _position;
+    /// the frames kept, most recently used first
+    std::list<Key> _lru;
+    size_t _cachedBytes;
+    Statistics _statistics;
+    bool _stop;
+    std::vector<std::thread> _threads;
+};
+
+#endif  // FRAMESCHEDULER_H
@@ -1,21 +1,42 @@
 // SPDX-License-Identifier: MIT
 
 #include "H5File.h"
+#include <assert.h>
+#include <dectris/neggia/data/H5Group.h>
+#include <dectris/neggia/data/H5MetadataCache.h>
+#include <dectris/neggia/data/H5Superblock.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <iostream>
+#include <stdexcept>
 
 namespace {
 
 struct UnMap {
     size_t size;
-    void operator()(char* addr) { munmap(addr, size); }
+    int fd;
+    void operator()(char* addr) {
+        munmap(addr, size);
+        close(fd);
+    }
 };
 
-std::shared_ptr<char> mapFile(const std::string& fileName) {
+size_t pageSize() {
+    static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+bool isHdf5File(const char* filePointer, size_t fileSize) {
+    return fileSize >= 12 &&
+           std::string(filePointer, 8) == "\211HDF\r\n\032\n";
+}
+
+std::shared_ptr<char> mapFile(const std::string& fileName,
+                              size_t& fileSize,
+                              int& fileDescriptor) {
 #ifdef DEBUG_PARSING
     std::cerr << "opening file " << fileName << "\n";
 #endif
@@ -27,6 +48,8 @@ std::shared_ptr<char> mapFile(const std::string& fileName) {
     }
     off_t fsize = lseek(fd, 0, SEEK_END);
     lseek(fd, 0, SEEK_SET);
+    // a file that is still being written is mapped as far as it has been
+    // written, what a writer appends later is read from a new mapping
     char* filePointer = (char*)mmap(NULL, fsize, PROT_READ, MAP_SHARED, fd, 0);
     if (filePointer == MAP_FAILED) {
         close(fd);
@@ -34,15 +57,23 @@ std::shared_ptr<char> mapFile(const std::string& fileName) {
                   << std::endl;
         throw std::out_of_range("Cannot map file");
     }
-    close(fd);
+    // the descriptor stays open for as long as the mapping is alive so that
+    // page cache advice can be given for it later on
     UnMap deleter;
     deleter.size = fsize;
+    deleter.fd = fd;
+    fileSize = fsize;
+    fileDescriptor = fd;
     return std::shared_ptr<char>(filePointer, deleter);
 }
 
 }  // namespace
 
-H5File::H5File(const std::string& path) : _fileAddress(mapFile(path)) {
+H5File::H5File(const std::string& path, WriterPolicy writerPolicy)
+      : _path(path),
+        _writerPolicy(writerPolicy),
+        _metadataCache(std::make_shared<H5MetadataCache>()) {
+    _fileAddress = mapFile(path, _fileSize, _fd);
     for (ssize_t i = path.size() - 1; i > 0; i--) {
         if (path[i] == '/') {
             _fileDir = std::string(path, 0, i);
@@ -53,12 +84,136 @@ H5File::H5File(const std::string& path) : _fileAddress(mapFile(path)) {
         _fileDir = ".";
 }
 
+H5File::H5File(const char* address,
+               size_t size,
+               std::shared_ptr<const void> owner,
+               ExternalFileResolver resolveExternalFile)
+      : _fileAddress(owner, const_cast<char*>(address)),
+        _fileSize(size),
+        _resolveExternalFile(resolveExternalFile),
+        _metadataCache(std::make_shared<H5MetadataCache>()) {
+    // everything the file refers to lies before its end of file address
+    if (!isHdf5File(address, size))
+        throw std::out_of_range("not an HDF5 file image");
+    uint64_t endOfFile = H5Superblock(address).endOfFileAddress();
+    if (endOfFile > size) {
+        throw std::out_of_range("file image of " + std::to_string(size) +
+                                " bytes ends before its end of file at " +
+                                std::to_string(endOfFile));
+    }
+}
+
 H5File::~H5File() {}
 
 const char* H5File::fileAddress() const {
     return _fileAddress.get();
 }
 
+size_t H5File::fileSize() const {
+    return _fileSize;
+}
+
 std::string H5File::fileDir() const {
     return _fileDir;
 }
+
+H5MetadataCache* H5File::metadataCache() const {
+    return _metadataCache.get();
+}
+
+H5File::WriterPolicy H5File::writerPolicy() const {
+    return _writerPolicy;
+}
+
+H5File H5File::reopen() const {
+    if (_path.empty())
+        throw std::out_of_range("cannot reopen a file image");
+    return H5File(_path, _writerPolicy);
+}
+
+H5File H5File::openExternal(const std::string& filename) const {
+    if (filename.empty())
+        throw std::out_of_range("external link without a filename");
+    if (_resolveExternalFile)
+        return _resolveExternalFile(filename);
+    if (_fd < 0)
+        throw std::out_of_range("cannot follow external link to " + filename);
+    if (filename[0] == '/')
+        return H5File(filename, _writerPolicy);
+    return H5File(_fileDir + "/" + filename, _writerPolicy);
+}
+
+bool H5File::tryResolve(const std::string& path,
+                        H5File& file,
+                        H5ObjectHeader& objectHeader) const {
+    H5File current(*this);
+    ResolvedPath resolvedPath;
+    if (!H5Superblock(current.fileAddress(), current.metadataCache(),
+                      current.writerPolicy() == ACCEPT_SWMR_WRITER)
+                 .tryResolve(path, resolvedPath))
+    {
+        return false;
+    }
+    while (resolvedPath.externalFile) {
+        current = current.openExternal(
+                resolvedPath.externalFile.filename.toString());
+        H5Path externalPath(resolvedPath.externalFile.h5Path);
+        if (!H5Superblock(current.fileAddress(), current.metadataCache(),
+                          current.writerPolicy() == ACCEPT_SWMR_WRITER)
+                     .tryResolve(externalPath, resolvedPath))
+        {
+            return false;
+        }
+    }
+    file = current;
+    objectHeader = resolvedPath.objectHeader;
+    return true;
+}
+
+std::vector<H5GroupLink> H5File::listGroup(const std::string& path) const {
+    try {
+        H5File file;
+        H5ObjectHeader objectHeader;
+        if (!tryResolve(path, file, objectHeader))
+            throw std::out_of_range("could not find " + path);
+        return H5Group(objectHeader).links();
+    } catch (const std::exception& exc) {
+        throw std::out_of_range(exc.what());
+    }
+}
+
+void H5File::prefetchPages(const char* address, size_t size) const {
+    // page cache advice only applies to mapped files, not to buffers
+    if (_fd < 0 || size == 0)
+        return;
+    assert(address >= fileAddress() &&
+           address + size <= fileAddress() + _fileSize);
+    size_t begin = (size_t)(address - fileAddress());
+    size_t end = begin + size;
+    begin = begin / pageSize() * pageSize();
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(_fd, (off_t)begin, (off_t)(end - begin),
+                  POSIX_FADV_WILLNEED);
+#endif
+    madvise(_fileAddress.get() + begin, end - begin, MADV_WILLNEED);
+}
+
+void H5File::dropPages(const char* address, size_t size) const {
+    if (_fd < 0 || size == 0)
+        return;
+    assert(address >= fileAddress() &&
+           address + size <= fileAddress() + _fileSize);
+    // only whole pages are released, partially covered pages at the borders
+    // may still be needed for neighbouring chunks or metadata
+    size_t begin = (size_t)(address - fileAddress());
+    size_t end = begin + size;
+    begin = (begin + pageSize() - 1) / pageSize() * pageSize();
+    end = end / pageSize() * pageSize();
+    if (end <= begin)
+        return;
+    madvise(_fileAddress.get() + begin, end - begin, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(_fd, (off_t)begin, (off_t)(end - begin),
+                  POSIX_FADV_DONTNEED);
+#endif
+}
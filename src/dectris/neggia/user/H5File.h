@@ -2,20 +2,89 @@
 
 #ifndef H5FILE_H
 #define H5FILE_H
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
+
+class H5MetadataCache;
+class H5ObjectHeader;
+struct H5GroupLink;
 
 class H5File {
 public:
+    /// Returns the file an external link with the given filename refers to.
+    typedef std::function<H5File(const std::string&)> ExternalFileResolver;
+
+    /// Whether a file that a writer still has open is read
+    enum WriterPolicy {
+        /// resolving paths throws std::runtime_error
+        REJECT_WRITER,
+        /// read if the writer keeps the file readable while writing to it
+        /// (single writer, multiple readers), e.g. to process frames
+        /// during acquisition
+        ACCEPT_SWMR_WRITER
+    };
+
     H5File() = default;
-    H5File(const std::string& path);
+    /// Files opened through external links of this file inherit
+    /// writerPolicy.
+    H5File(const std::string& path, WriterPolicy writerPolicy = REJECT_WRITER);
+    /// Reads the HDF5 file image [address, address+size) in place. The
+    /// buffer must remain valid as long as owner is alive; owner is shared
+    /// by all copies of the file and the datasets read from it. External
+    /// links can only be followed if resolveExternalFile is given. Throws
+    /// std::out_of_range if the image is not an HDF5 file or is shorter than
+    /// the end of file address in its superblock.
+    H5File(const char* address,
+           size_t size,
+           std::shared_ptr<const void> owner,
+           ExternalFileResolver resolveExternalFile = ExternalFileResolver());
     ~H5File();
     const char* fileAddress() const;
+    size_t fileSize() const;
     std::string fileDir() const;
+    /// Resolved paths of this file, shared by all copies of the file
+    H5MetadataCache* metadataCache() const;
+    WriterPolicy writerPolicy() const;
+
+    /// Maps the file again, e.g. to see what a writer has appended to it
+    /// since it was opened. Throws std::out_of_range for file images.
+    H5File reopen() const;
+
+    /// Opens the target file of an external link found in this file.
+    /// Throws std::out_of_range if filename is empty.
+    H5File openExternal(const std::string& filename) const;
+
+    /// Resolves path, following external links on the way. Returns false if
+    /// the path does not exist, otherwise sets file to the file the object
+    /// was found in and objectHeader to the object.
+    bool tryResolve(const std::string& path,
+                    H5File& file,
+                    H5ObjectHeader& objectHeader) const;
+
+    /// Lists the links of the group at path, following external links on
+    /// the way. Throws std::out_of_range if the group cannot be found.
+    std::vector<H5GroupLink> listGroup(const std::string& path) const;
+
+    /// Asks the kernel to start reading [address, address+size) into the
+    /// page cache in the background.
+    void prefetchPages(const char* address, size_t size) const;
+
+    /// Releases the pages that lie completely within [address, address+size)
+    /// from the mapping and from the page cache. The data stays readable,
+    /// the next access fetches it from disk again.
+    void dropPages(const char* address, size_t size) const;
 
 private:
+    std::string _path;
     std::shared_ptr<char> _fileAddress;
+    size_t _fileSize = 0;
+    int _fd = -1;
+    WriterPolicy _writerPolicy = REJECT_WRITER;
     std::string _fileDir;
+    ExternalFileResolver _resolveExternalFile;
+    std::shared_ptr<H5MetadataCache> _metadataCache;
 };
 
 #endif  // H5FILE_H
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+
+#include "MetadataSnapshot.h"
+#include <dectris/neggia/data/H5DataLayoutMsg.h>
+#include <dectris/neggia/data/H5DatatypeMsg.h>
+#include <dectris/neggia/data/H5Group.h>
+#include <dectris/neggia/data/H5MetadataCache.h>
+#include <dectris/neggia/data/H5Path.h>
+#include <string.h>
+#include <stdexcept>
+#include <vector>
+#include "Dataset.h"
+
+namespace {
+
+template <class Type>
+Type readScalar(const Dataset& dataset) {
+    Type value;
+    dataset.read(&value);
+    return value;
+}
+
+bool readInteger(const Dataset& dataset, MetadataSnapshot::Value& value) {
+    if (dataset.isSigned()) {
+        value.type = MetadataSnapshot::Value::SIGNED_INTEGER;
+        switch (dataset.dataSize()) {
+            case sizeof(int8_t):
+                value.signedInteger = readScalar<int8_t>(dataset);
+                return true;
+            case sizeof(int16_t):
+                value.signedInteger = readScalar<int16_t>(dataset);
+                return true;
+            case sizeof(int32_t):
+                value.signedInteger = readScalar<int32_t>(dataset);
+                return true;
+            case sizeof(int64_t):
+                value.signedInteger = readScalar<int64_t>(dataset);
+                return true;
+        }
+        return false;
+    }
+    value.type = MetadataSnapshot::Value::UNSIGNED_INTEGER;
+    switch (dataset.dataSize()) {
+        case sizeof(uint8_t):
+            value.unsignedInteger = readScalar<uint8_t>(dataset);
+            return true;
+        case sizeof(uint16_t):
+            value.unsignedInteger = readScalar<uint16_t>(dataset);
+            return true;
+        case sizeof(uint32_t):
+            value.unsignedInteger = readScalar<uint32_t>(dataset);
+            return true;
+        case sizeof(uint64_t):
+            value.unsignedInteger = readScalar<uint64_t>(dataset);
+            return true;
+    }
+    return false;
+}
+
+bool readFloat(const Dataset& dataset, MetadataSnapshot::Value& value) {
+    value.type = MetadataSnapshot::Value::FLOAT;
+    switch (dataset.dataSize()) {
+        case sizeof(float):
+            value.floatingPoint = readScalar<float>(dataset);
+            return true;
+        case sizeof(double):
+            value.floatingPoint = readScalar<double>(dataset);
+            return true;
+    }
+    return false;
+}
+
+bool readString(const Dataset& dataset, MetadataSnapshot::Value& value) {
+    value.type = MetadataSnapshot::Value::STRING;
+    std::vector<char> buffer(dataset.dataSize());
+    dataset.read(buffer.data());
+    // fixed-length strings are padded with null characters
+    value.string.assign(buffer.data(),
+                        strnlen(buffer.data(), buffer.size()));
+    return true;
+}
+
+}  // namespace
+
+MetadataSnapshot::MetadataSnapshot(const H5File& h5File,
+                                   const std::string& groupPath) {
+    H5File file;
+    H5ObjectHeader group;
+    if (!h5File.tryResolve(groupPath, file, group))
+        return;
+    std::set<size_t> visited;
+    addGroup(file, group, std::string(H5Path(groupPath)), visited);
+}
+
+bool MetadataSnapshot::find(const std::string& path, Value& value) const {
+    auto item = _values.find(std::string(H5Path(path)));
+    if (item == _values.end())
+        return false;
+    value = item->second;
+    return true;
+}
+
+size_t MetadataSnapshot::size() const {
+    return _values.size();
+}
+
+void MetadataSnapshot::addGroup(const H5File& h5File,
+                                const H5ObjectHeader& group,
+                                const std::string& groupPath,
+                                std::set<size_t>& visited) {
+    if (!visited.insert(group.offset()).second)
+        return;
+    for (const auto& link : H5Group(group).links()) {
+        if (link.linkType != H5LinkMsg::HARD)
+            continue;
+        H5ObjectHeader object(h5File.fileAddress(), link.objectHeaderAddress);
+        std::string path = H5MetadataCache::childPath(groupPath, link.name);
+        H5HeaderMessage msg;
+        try {
+            if (object.findMessage(H5DataLayoutMsg::TYPE_ID, msg))
+                addDataset(h5File, object, path);
+            else
+                addGroup(h5File, object, path, visited);
+        } catch (const std::exception&) {
+            // e.g. unsupported layouts or data that has not been written;
+            // such objects cannot be opened as a Dataset either
+        }
+    }
+}
+
+void MetadataSnapshot::addDataset(const H5File& h5File,
+                                  const H5ObjectHeader& objectHeader,
+                                  const std::string& path) {
+    H5HeaderMessage msg;
+    if (!objectHeader.findMessage(H5DatatypeMsg::TYPE_ID, msg))
+        return;
+    // fixed-point, floating-point or string
+    unsigned int typeId = H5DatatypeMsg(msg.object).typeId();
+    if (typeId != 0 && typeId != 1 && typeId != 3)
+        return;
+    Dataset dataset(h5File, objectHeader);
+    if (dataset.isChunked())
+        return;
+    for (auto dim : dataset.dim()) {
+        if (dim != 1)
+            return;
+    }
+    Value value;
+    bool isScalar = false;
+    switch (typeId) {
+        case 0:
+            isScalar = readInteger(dataset, value);
+            break;
+        case 1:
+            isScalar = readFloat(dataset, value);
+            break;
+        case 3:
+            isScalar = readString(dataset, value);
+            break;
+    }
+    if (isScalar)
+        _values.emplace(path, value);
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef METADATASNAPSHOT_H
+#define METADATASNAPSHOT_H
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include "H5File.h"
+
+/// The values of all scalar numbers and strings stored below one group,
+/// e.g. /entry/instrument/detector, read in a single walk over the object
+/// headers of the subtree. Each group and dataset header is visited once;
+/// arrays, chunked datasets, soft or external links and objects that cannot
+/// be read are skipped.
+/// Values are kept in memory and looked up by absolute path.
+
+class MetadataSnapshot {
+public:
+    struct Value {
+        enum Type { SIGNED_INTEGER, UNSIGNED_INTEGER, FLOAT, STRING };
+        Type type = STRING;
+        int64_t signedInteger = 0;
+        uint64_t unsignedInteger = 0;
+        double floatingPoint = 0;
+        std::string string;
+    };
+
+    MetadataSnapshot() = default;
+    /// Reads the subtree of the group at groupPath. The snapshot is empty if
+    /// there is no such group.
+    MetadataSnapshot(const H5File& h5File, const std::string& groupPath);
+
+    /// Returns false if there is no scalar or string dataset at path
+    bool find(const std::string& path, Value& value) const;
+    size_t size() const;
+
+private:
+    void addGroup(const H5File& h5File,
+                  const H5ObjectHeader& group,
+                  const std::string& groupPath,
+                  std::set<size_t>& visited);
+    void addDataset(const H5File& h5File,
+                    const H5ObjectHeader& dataset,
+                    const std::string& path);
+
+    std::map<std::string, Value> _values;
+};
+
+#endif  // METADATASNAPSHOT_H
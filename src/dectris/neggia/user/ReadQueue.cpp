@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: MIT
+
+#include "ReadQueue.h"
+#include <algorithm>
+
+constexpr ReadQueue::Owner ReadQueue::NO_OWNER;
+
+namespace {
+
+/// The queue whose read or callback runs on this thread, if any
+thread_local const ReadQueue* currentQueue = nullptr;
+
+size_t getNumberOfThreads(size_t numberOfThreads) {
+    if (numberOfThreads > 0)
+        return numberOfThreads;
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void complete(const ReadQueue::Callback& callback,
+              std::exception_ptr exception) {
+    // a callback that throws must not take down the thread of the queue
+    try {
+        callback(exception);
+    } catch (...) {
+    }
+}
+
+}  // namespace
+
+ReadQueue::ReadQueue(size_t numberOfThreads, size_t maxInFlight)
+      : _maxInFlight(maxInFlight > 0
+                             ? maxInFlight
+                             : 2 * getNumberOfThreads(numberOfThreads)),
+        _running(0),
+        _lastOwner(NO_OWNER),
+        _stop(false) {
+    numberOfThreads = getNumberOfThreads(numberOfThreads);
+    for (size_t i = 0; i < numberOfThreads; ++i)
+        _threads.emplace_back(&ReadQueue::run, this);
+}
+
+ReadQueue::~ReadQueue() {
+    cancelRequests([](const Request&) { return true; });
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _requestQueued.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+void ReadQueue::submit(std::function<void()> read,
+                       Callback callback,
+                       Owner owner) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (currentQueue != this) {
+            _requestCompleted.wait(lock, [&] {
+                return _requests.size() + _running < _maxInFlight;
+            });
+        }
+        _requests.push_back(
+                Request{std::move(read), std::move(callback), owner});
+    }
+    _requestQueued.notify_one();
+}
+
+ReadQueue::Owner ReadQueue::newOwner() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return ++_lastOwner;
+}
+
+void ReadQueue::cancel(Owner owner) {
+    if (owner == NO_OWNER)
+        return;
+    cancelRequests(
+            [owner](const Request& request) { return request.owner == owner; });
+}
+
+void ReadQueue::cancelRequests(
+        const std::function<bool(const Request&)>& isCancelled) {
+    std::deque<Request> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::deque<Request> kept;
+        for (auto& request : _requests) {
+            if (isCancelled(request))
+                cancelled.push_back(std::move(request));
+            else
+                kept.push_back(std::move(request));
+        }
+        _requests.swap(kept);
+    }
+    _requestCompleted.notify_all();
+    auto exception = std::make_exception_ptr(ReadCancelled());
+    for (const auto& request : cancelled)
+        complete(request.callback, exception);
+}
+
+size_t ReadQueue::inFlight() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _requests.size() + _running;
+}
+
+size_t ReadQueue::maxInFlight() const {
+    return _maxInFlight;
+}
+
+size_t ReadQueue::numberOfThreads() const {
+    return _threads.size();
+}
+
+ReadQueue& ReadQueue::shared() {
+    static ReadQueue queue;
+    return queue;
+}
+
+void ReadQueue::run() {
+    currentQueue = this;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _requestQueued.wait(lock, [&] { return _stop || !_requests.empty(); });
+        if (_stop)
+            return;
+        Request request = std::move(_requests.front());
+        _requests.pop_front();
+        ++_running;
+        lock.unlock();
+        std::exception_ptr exception;
+        try {
+            request.read();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        // the slot is free before the callback runs, so that the callback
+        // can submit the next read without waiting for itself
+        lock.lock();
+        --_running;
+        lock.unlock();
+        _requestCompleted.notify_all();
+        complete(request.callback, exception);
+        lock.lock();
+    }
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef READQUEUE_H
+#define READQUEUE_H
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/// The exception of reads that have been cancelled before they started
+class ReadCancelled : public std::runtime_error {
+public:
+    ReadCancelled() : std::runtime_error("read cancelled") {}
+};
+
+/// Runs reads on a pool of threads, e.g. for Dataset::readAsync. At most
+/// maxInFlight reads are queued or running at a time; submitting more
+/// blocks until earlier reads have completed.
+class ReadQueue {
+public:
+    /// Called on a thread of the queue once the read has completed, with
+    /// the exception it threw, nullptr if it succeeded
+    typedef std::function<void(std::exception_ptr)> Callback;
+    /// Identifies the reads of one user of the queue, so that they can be
+    /// cancelled without cancelling the reads of others
+    typedef uint64_t Owner;
+    constexpr static Owner NO_OWNER = 0;
+
+    /// One thread per hardware thread if numberOfThreads is 0, twice as many
+    /// reads in flight as threads if maxInFlight is 0
+    explicit ReadQueue(size_t numberOfThreads = 0, size_t maxInFlight = 0);
+    /// Cancels the reads that have not started and waits for the others
+    ~ReadQueue();
+    ReadQueue(const ReadQueue&) = delete;
+    ReadQueue& operator=(const ReadQueue&) = delete;
+
+    /// Never blocks on a thread of the queue, e.g. in a read or a callback
+    /// submitting the next read, as the reads it would wait for may be
+    /// waiting for it. The read then exceeds maxInFlight.
+    void submit(std::function<void()> read,
+                Callback callback,
+                Owner owner = NO_OWNER);
+    /// An owner that has not been returned before
+    Owner newOwner();
+    /// Completes the reads of owner that have not started yet with
+    /// ReadCancelled, calling their callbacks on this thread. Reads of
+    /// other owners and later reads run as usual. Reads without an owner
+    /// are only cancelled when the queue is destroyed.
+    void cancel(Owner owner);
+    /// Number of reads queued or running
+    size_t inFlight() const;
+    size_t maxInFlight() const;
+    size_t numberOfThreads() const;
+
+    /// The queue used by default, created on first use
+    static ReadQueue& shared();
+
+private:
+    struct Request {
+        std::function<void()> read;
+        Callback callback;
+        Owner owner;
+    };
+
+    void run();
+    /// Completes the reads that satisfy isCancelled with ReadCancelled
+    void cancelRequests(
+            const std::function<bool(const Request&)>& isCancelled);
+
+    const size_t _maxInFlight;
+    mutable std::mutex _mutex;
+    std::condition_variable _requestQueued;
+    std::condition_variable _requestCompleted;
+    std::deque<Request> _requests;
+    size_t _running;
+    Owner _lastOwner;
+    bool _stop;
+    std::vector<std::thread> _threads;
+};
+
+#endif  // READQUEUE_H